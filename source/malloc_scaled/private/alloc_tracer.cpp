@@ -0,0 +1,236 @@
+#include "build.h"
+#include "alloc_tracer.h"
+#include "align.h"
+
+#include <cstdlib>
+
+#if PLATFORM_WIN
+#include <win.h>
+#endif
+
+thread_local TAllocTracer::TThreadSlot TAllocTracer::ThreadSlot{};
+std::atomic<uint64> TAllocTracer::NextSession{ 1 };
+
+const char* GetAllocTraceEnv()
+{
+#if PLATFORM_WIN
+	static char PathBuf[ALLOC_TRACE_MAX_PATH_LENGTH];
+
+	DWORD Length = GetEnvironmentVariableA(MALLOC_SCALED_TRACE_ENV, PathBuf, sizeof(PathBuf));
+
+	if (!Length || Length >= sizeof(PathBuf))
+	{
+		return nullptr;
+	}
+
+	return PathBuf;
+#else
+	return getenv(MALLOC_SCALED_TRACE_ENV);
+#endif
+}
+
+TAllocTracer::TAllocTracer() :
+	Enabled(false),
+	Session(0),
+	NextSeq(0),
+	ThreadCount(0),
+	DroppedCount(0),
+	File(nullptr),
+	Buffers(nullptr)
+{
+}
+
+TAllocTracer::~TAllocTracer()
+{
+	if (File)
+	{
+		fclose(File);
+	}
+}
+
+bool TAllocTracer::Start(const char* Path, TCriticalSection& AllocatorGuard)
+{
+	if (!Path || !*Path)
+	{
+		return false;
+	}
+
+	FileGuard.Lock();
+
+	if (File)
+	{
+		FileGuard.Unlock();
+		return false;
+	}
+
+	TSize BuffersSize = AlignToUpper(ALLOC_TRACE_MAX_THREAD_COUNT * sizeof(TThreadBuffer), MAX_ALIGN);
+	TSize RecordsSize = ALLOC_TRACE_MAX_THREAD_COUNT * 2 * ALLOC_TRACE_BUFFER_RECORDS * sizeof(TAllocTraceRecord);
+
+	if (!DataBlock.Allocate(BuffersSize + RecordsSize))
+	{
+		FileGuard.Unlock();
+		return false;
+	}
+
+#if PLATFORM_WIN
+	if (fopen_s(&File, Path, "wb"))
+	{
+		File = nullptr;
+	}
+#else
+	File = fopen(Path, "wb");
+#endif
+
+	//	Unbuffered, the halves are written in one call each and the CRT never allocates for the stream;
+	if (File)
+	{
+		setvbuf(File, nullptr, _IONBF, 0);
+	}
+
+	TAllocTraceHeader Header{ ALLOC_TRACE_MAGIC, ALLOC_TRACE_VERSION, sizeof(TAllocTraceRecord) };
+
+	if (!File || fwrite(&Header, sizeof(Header), 1, File) != 1)
+	{
+		if (File)
+		{
+			fclose(File);
+			File = nullptr;
+		}
+
+		DataBlock.Free();
+		FileGuard.Unlock();
+		return false;
+	}
+
+	//	Buffers are set up when a thread records its first request;
+	Buffers = (TThreadBuffer*)DataBlock.GetBase();
+	TAllocTraceRecord* Records = (TAllocTraceRecord*)((uint8*)Buffers + BuffersSize);
+
+	for (TSize i = 0; i < ALLOC_TRACE_MAX_THREAD_COUNT; ++i)
+	{
+		new (&Buffers[i]) TThreadBuffer{};
+		Buffers[i].Halves[0] = Records + i * 2 * ALLOC_TRACE_BUFFER_RECORDS;
+		Buffers[i].Halves[1] = Buffers[i].Halves[0] + ALLOC_TRACE_BUFFER_RECORDS;
+	}
+
+	AllocatorGuard.Lock();
+
+	Session = NextSession.fetch_add(1, std::memory_order_relaxed);
+	NextSeq = 0;
+	ThreadCount = 0;
+	DroppedCount = 0;
+	StartTime = std::chrono::steady_clock::now();
+	Enabled = true;
+
+	AllocatorGuard.Unlock();
+
+	FileGuard.Unlock();
+
+#ifdef MALLOC_SCALED_DEBUG
+	printf("MALLOC: DBG: ALLOC TRACE START: %s\n", Path);
+#endif
+
+	return true;
+}
+
+void TAllocTracer::Stop(TCriticalSection& AllocatorGuard)
+{
+	AllocatorGuard.Lock();
+	bool WasEnabled = Enabled;
+	Enabled = false;
+	AllocatorGuard.Unlock();
+
+	if (!WasEnabled)
+	{
+		return;
+	}
+
+	FileGuard.Lock();
+
+	//	Full halves their threads have not written yet go first, then the active ones;
+	for (TSize i = 0; i < ThreadCount; ++i)
+	{
+		TThreadBuffer& Buffer = Buffers[i];
+		TSize Full = Buffer.Active ^ 1;
+
+		if (Buffer.Pending[Full])
+		{
+			WriteHalf(Buffer, Full, ALLOC_TRACE_BUFFER_RECORDS);
+		}
+
+		WriteHalf(Buffer, Buffer.Active, Buffer.Count);
+	}
+
+	fclose(File);
+	File = nullptr;
+
+#ifdef MALLOC_SCALED_DEBUG
+	printf("MALLOC: DBG: ALLOC TRACE STOP: Records: %llu, Threads: %llu, Dropped: %llu\n", NextSeq, (uint64)ThreadCount, (uint64)DroppedCount);
+#endif
+
+	Buffers = nullptr;
+	DataBlock.Free();
+
+	FileGuard.Unlock();
+}
+
+void TAllocTracer::FlushPending()
+{
+	FileGuard.Lock();
+
+	//	The trace may have been stopped, or restarted with other buffers, since the half got full;
+	if (File && ThreadSlot.Tracer == this && ThreadSlot.Session == Session && ThreadSlot.Buffer)
+	{
+		TThreadBuffer& Buffer = *ThreadSlot.Buffer;
+
+		for (TSize Half = 0; Half < 2; ++Half)
+		{
+			if (Buffer.Pending[Half])
+			{
+				WriteHalf(Buffer, Half, ALLOC_TRACE_BUFFER_RECORDS);
+			}
+		}
+	}
+
+	FileGuard.Unlock();
+}
+
+TSize TAllocTracer::GetDroppedCount()
+{
+	return DroppedCount;
+}
+
+TAllocTracer::TThreadBuffer* TAllocTracer::GetThreadBuffer()
+{
+	std::thread::id Owner = std::this_thread::get_id();
+	TThreadBuffer* Buffer = nullptr;
+
+	//	A thread recording to several heaps in turn finds the buffer it took before;
+	for (TSize i = 0; i < ThreadCount && !Buffer; ++i)
+	{
+		if (Buffers[i].Owner == Owner)
+		{
+			Buffer = &Buffers[i];
+		}
+	}
+
+	if (!Buffer && ThreadCount < ALLOC_TRACE_MAX_THREAD_COUNT)
+	{
+		Buffer = &Buffers[ThreadCount++];
+		Buffer->Owner = Owner;
+	}
+
+	ThreadSlot = { this, Session, Buffer };
+
+	return Buffer;
+}
+
+void TAllocTracer::WriteHalf(TThreadBuffer& Buffer, TSize Half, TSize Count)
+{
+	if (Count)
+	{
+		fwrite(Buffer.Halves[Half], sizeof(TAllocTraceRecord), Count, File);
+	}
+
+	Buffer.Pending[Half] = false;
+}
@@ -0,0 +1,381 @@
+#include "heap_profiler.h"
+#include "platform_stack_trace.h"
+#include "align.h"
+#include "zero_memory.h"
+
+#include <cstdio>
+
+static const TSize HEAP_PROFILER_LINE_SIZE = 64 + HEAP_PROFILER_MAX_DEPTH * 20; // Bytes;
+
+thread_local THeapProfiler::TThreadSampler THeapProfiler::ThreadSampler{};
+
+THeapProfiler::THeapProfiler() :
+	SampleInterval(0),
+	SampleRate(0.0),
+	SampleCount(0),
+	StackCount(0),
+	DroppedCount(0),
+	SampleFilter(nullptr),
+	Samples(nullptr),
+	Stacks(nullptr),
+	Snapshot(nullptr)
+{
+}
+
+THeapProfiler::~THeapProfiler()
+{
+	Release();
+}
+
+bool THeapProfiler::Init(TSize SampleInterval)
+{
+	if (Samples || !SampleInterval)
+	{
+		return false;
+	}
+
+	TSize FilterSize   = AlignToUpper(HEAP_PROFILER_FILTER_SIZE, MAX_ALIGN);
+	TSize SamplesSize  = AlignToUpper(SampleSlotCount * sizeof(THeapProfileSample), MAX_ALIGN);
+	TSize StacksSize   = StackSlotCount * sizeof(THeapProfileStack);
+	TSize SnapshotSize = HEAP_PROFILER_MAX_STACK_COUNT * sizeof(THeapProfileStack);
+
+	if (!DataBlock.Allocate(FilterSize + SamplesSize + StacksSize + SnapshotSize))
+	{
+		return false;
+	}
+
+	//	Pages never handed out before read as zero, only the tables are cleared, the snapshot is written before it is read;
+	if (!DataBlock.IsUntouched())
+	{
+		ZeroMemoryBlock(DataBlock.GetBase(), FilterSize + SamplesSize + StacksSize);
+	}
+
+	SampleFilter = (uint8*)DataBlock.GetBase();
+	Samples  = (THeapProfileSample*)(SampleFilter + FilterSize);
+	Stacks   = (THeapProfileStack*)((uint8*)Samples + SamplesSize);
+	Snapshot = (THeapProfileStack*)((uint8*)Stacks + StacksSize);
+
+	this->SampleInterval = SampleInterval;
+	SampleRate = 1.0 / (float64)SampleInterval;
+	SampleCount  = 0;
+	StackCount   = 0;
+	DroppedCount = 0;
+
+	TPlatformStackTrace::Init();
+
+#ifdef MALLOC_SCALED_DEBUG
+	printf("MALLOC: DBG: HEAP PROFILER INIT: Sample interval: %llu, Table size: %llu\n", (uint64)SampleInterval, (uint64)DataBlock.GetAllocatedSize());
+#endif
+
+	return true;
+}
+
+void THeapProfiler::Release()
+{
+	if (!Samples)
+	{
+		return;
+	}
+
+	DataBlock.Free();
+
+	SampleInterval = 0;
+	SampleRate     = 0.0;
+	SampleCount    = 0;
+	StackCount     = 0;
+	DroppedCount   = 0;
+	SampleFilter = nullptr;
+	Samples  = nullptr;
+	Stacks   = nullptr;
+	Snapshot = nullptr;
+}
+
+bool THeapProfiler::IsInitialized()
+{
+	return Samples != nullptr;
+}
+
+bool THeapProfiler::NextSample()
+{
+	TThreadSampler& Sampler = ThreadSampler;
+	bool Sampled = Sampler.Random != 0;
+
+	//	The first gap of a thread is drawn instead of sampling its first allocation;
+	if (!Sampled)
+	{
+		Sampler.Random = HEAP_PROFILER_HASH_MUL ^ (uint64)&Sampler;
+	}
+
+	//	xorshift64*, 53 bits of it make a uniform value in (0, 1];
+	Sampler.Random ^= Sampler.Random >> 12;
+	Sampler.Random ^= Sampler.Random << 25;
+	Sampler.Random ^= Sampler.Random >> 27;
+	float64 Uniform = (float64)(((Sampler.Random * 0x2545F4914F6CDD1Dull) >> 11) + 1) * (1.0 / 9007199254740992.0);
+
+	Sampler.GapLeft = -std::log(Uniform);
+
+	return Sampled;
+}
+
+TSize THeapProfiler::FindStack(void** Frames, TSize Depth)
+{
+	uint64 Hash = Depth;
+
+	for (TSize i = 0; i < Depth; ++i)
+	{
+		Hash = (Hash ^ (uint64)Frames[i]) * HEAP_PROFILER_HASH_MUL;
+	}
+
+	TSize Mask = StackSlotCount - 1;
+
+	for (TSize Slot = (Hash >> 32) & Mask; ; Slot = (Slot + 1) & Mask)
+	{
+		THeapProfileStack& Stack = Stacks[Slot];
+
+		if (!Stack.AllocCount)
+		{
+			if (StackCount >= HEAP_PROFILER_MAX_STACK_COUNT)
+			{
+				return StackSlotCount;
+			}
+
+			Stack.Hash = Hash;
+			Stack.Depth = Depth;
+			memcpy(Stack.Frames, Frames, Depth * sizeof(void*));
+			++StackCount;
+
+			return Slot;
+		}
+
+		if (Stack.Hash == Hash && Stack.Depth == Depth && !memcmp(Stack.Frames, Frames, Depth * sizeof(void*)))
+		{
+			return Slot;
+		}
+	}
+}
+
+inline TSize THeapProfiler::GetSampleSlot(void* Addr)
+{
+	return (TSize)((((uint64)Addr >> 4) * HEAP_PROFILER_HASH_MUL) >> 32) & (SampleSlotCount - 1);
+}
+
+TSize THeapProfiler::FindSample(void* Addr)
+{
+	TSize Mask = SampleSlotCount - 1;
+
+	for (TSize Slot = GetSampleSlot(Addr); Samples[Slot].Addr; Slot = (Slot + 1) & Mask)
+	{
+		if (Samples[Slot].Addr == Addr)
+		{
+			return Slot;
+		}
+	}
+
+	return SampleSlotCount;
+}
+
+void THeapProfiler::InsertSample(const THeapProfileSample& Sample)
+{
+	TSize Mask = SampleSlotCount - 1;
+	TSize Slot = GetSampleSlot(Sample.Addr);
+
+	while (Samples[Slot].Addr)
+	{
+		Slot = (Slot + 1) & Mask;
+	}
+
+	Samples[Slot] = Sample;
+	++SampleCount;
+
+	uint8& Filter = SampleFilter[GetFilterSlot(Sample.Addr)];
+
+	if (Filter < std::numeric_limits<uint8>::max())
+	{
+		++Filter;
+	}
+}
+
+void THeapProfiler::RemoveSample(TSize Slot)
+{
+	uint8& Filter = SampleFilter[GetFilterSlot(Samples[Slot].Addr)];
+
+	if (Filter < std::numeric_limits<uint8>::max())
+	{
+		--Filter;
+	}
+
+	//	Linear probing without tombstones: the samples after the hole move back into it
+	//	unless the hole lies before their home slot;
+	TSize Mask = SampleSlotCount - 1;
+	TSize Hole = Slot;
+
+	for (TSize i = (Hole + 1) & Mask; Samples[i].Addr; i = (i + 1) & Mask)
+	{
+		TSize Home = GetSampleSlot(Samples[i].Addr);
+
+		if (((i - Home) & Mask) >= ((i - Hole) & Mask))
+		{
+			Samples[Hole] = Samples[i];
+			Hole = i;
+		}
+	}
+
+	Samples[Hole].Addr = nullptr;
+	--SampleCount;
+}
+
+void THeapProfiler::RecordAlloc(void* Addr, TSize Size)
+{
+	if (!Samples)
+	{
+		return;
+	}
+
+	void* Frames[HEAP_PROFILER_MAX_DEPTH];
+	TSize Depth = TPlatformStackTrace::Capture(Frames, HEAP_PROFILER_MAX_DEPTH, 1);
+	TSize StackSlot = FindStack(Frames, Depth);
+
+	if (StackSlot == StackSlotCount)
+	{
+		++DroppedCount;
+		return;
+	}
+
+	THeapProfileStack& Stack = Stacks[StackSlot];
+	++Stack.AllocCount;
+	Stack.AllocBytes += Size;
+
+	//	A block which is not tracked still counts to the allocations of its stack;
+	if (SampleCount >= HEAP_PROFILER_MAX_SAMPLE_COUNT)
+	{
+		++DroppedCount;
+		return;
+	}
+
+	++Stack.LiveCount;
+	Stack.LiveBytes += Size;
+
+	InsertSample({ Addr, Size, StackSlot });
+
+#ifdef MALLOC_SCALED_DEBUG
+	printf("MALLOC: DBG: HEAP PROFILER SAMPLE: Address: %p, Size: %llu, Depth: %llu\n", Addr, (uint64)Size, (uint64)Depth);
+#endif
+}
+
+void THeapProfiler::RemoveSampledBlock(void* Addr)
+{
+	TSize Slot = FindSample(Addr);
+
+	if (Slot == SampleSlotCount)
+	{
+		return;
+	}
+
+	THeapProfileStack& Stack = Stacks[Samples[Slot].Stack];
+	--Stack.LiveCount;
+	Stack.LiveBytes -= Samples[Slot].Size;
+
+	RemoveSample(Slot);
+}
+
+void THeapProfiler::MoveSampledBlock(void* OldAddr, void* NewAddr, TSize NewSize)
+{
+	TSize Slot = FindSample(OldAddr);
+
+	if (Slot == SampleSlotCount)
+	{
+		return;
+	}
+
+	//	The block keeps the stack it was sampled with;
+	THeapProfileSample Sample = Samples[Slot];
+	THeapProfileStack& Stack = Stacks[Sample.Stack];
+	Stack.LiveBytes = Stack.LiveBytes - Sample.Size + NewSize;
+
+	if (OldAddr == NewAddr)
+	{
+		Samples[Slot].Size = NewSize;
+		return;
+	}
+
+	RemoveSample(Slot);
+	InsertSample({ NewAddr, NewSize, Sample.Stack });
+}
+
+bool THeapProfiler::Dump(TCriticalSection& AllocatorGuard, TMallocWriter Writer, void* Context)
+{
+	if (!Writer)
+	{
+		return false;
+	}
+
+	DumpGuard.Lock();
+
+	TSize Count = 0;
+	TSize Interval = 0;
+
+	AllocatorGuard.Lock();
+
+	if (Samples)
+	{
+		Interval = SampleInterval;
+
+		for (TSize i = 0; i < StackSlotCount; ++i)
+		{
+			if (Stacks[i].AllocCount)
+			{
+				Snapshot[Count++] = Stacks[i];
+			}
+		}
+	}
+
+	AllocatorGuard.Unlock();
+
+	if (!Interval)
+	{
+		DumpGuard.Unlock();
+		return false;
+	}
+
+	THeapProfileStack Total = {};
+
+	for (TSize i = 0; i < Count; ++i)
+	{
+		Total.LiveCount  += Snapshot[i].LiveCount;
+		Total.LiveBytes  += Snapshot[i].LiveBytes;
+		Total.AllocCount += Snapshot[i].AllocCount;
+		Total.AllocBytes += Snapshot[i].AllocBytes;
+	}
+
+	char Line[HEAP_PROFILER_LINE_SIZE];
+	int32 Length = snprintf(Line, sizeof(Line), "heap profile: %zu: %zu [%zu: %zu] @ heap_v2/%zu\n",
+		Total.LiveCount, Total.LiveBytes, Total.AllocCount, Total.AllocBytes, Interval);
+	Writer(Line, Length, Context);
+
+	for (TSize i = 0; i < Count; ++i)
+	{
+		const THeapProfileStack& Stack = Snapshot[i];
+		Length = snprintf(Line, sizeof(Line), "%zu: %zu [%zu: %zu] @", Stack.LiveCount, Stack.LiveBytes, Stack.AllocCount, Stack.AllocBytes);
+
+		for (TSize j = 0; j < Stack.Depth; ++j)
+		{
+			Length += snprintf(Line + Length, sizeof(Line) - Length, " 0x%llx", (uint64)Stack.Frames[j]);
+		}
+
+		Line[Length++] = '\n';
+		Writer(Line, Length, Context);
+	}
+
+	static const char MappedLibraries[] = "\nMAPPED_LIBRARIES:\n";
+	Writer(MappedLibraries, sizeof(MappedLibraries) - 1, Context);
+
+	bool Ok = TPlatformStackTrace::WriteModuleMap(Writer, Context);
+
+#ifdef MALLOC_SCALED_DEBUG
+	printf("MALLOC: DBG: HEAP PROFILE DUMP: Stacks: %llu, Live samples: %llu, Dropped samples: %llu\n", (uint64)Count, (uint64)Total.LiveCount, (uint64)DroppedCount);
+#endif
+
+	DumpGuard.Unlock();
+
+	return Ok;
+}
@@ -0,0 +1,299 @@
+#include "build.h"
+#include "malloc_conf.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+#if PLATFORM_WIN
+#include <win.h>
+#endif
+
+struct TMallocConfKey
+{
+	const char* Name;
+	TSize TMallocConf::* Value;
+};
+
+static const TMallocConfKey MallocConfKeys[] =
+{
+	{ "min_block",       &TMallocConf::MinBaseBlockSize   },
+	{ "max_block",       &TMallocConf::MaxBaseBlockSize   },
+	{ "subindex_count",  &TMallocConf::SubIndexCount      },
+	{ "pool_size",       &TMallocConf::PoolBlockSize      },
+	{ "arena_size",      &TMallocConf::ArenaSize          },
+	{ "arena_page_size", &TMallocConf::ArenaPageSize      },
+	{ "pool_cache_high", &TMallocConf::PoolCacheHighWater },
+	{ "pool_cache_low",  &TMallocConf::PoolCacheLowWater  },
+	{ "pool_cache_max",  &TMallocConf::PoolCacheMaxSize   },
+	{ "soft_limit",      &TMallocConf::SoftLimit          },
+	{ "pool_colors",     &TMallocConf::PoolColorCount     },
+	{ "thread_pools",    &TMallocConf::ThreadPoolCount    },
+	{ "prof_sample",     &TMallocConf::ProfSampleInterval }
+};
+
+static bool IsKey(const char* Begin, const char* End, const char* Key)
+{
+	TSize Length = End - Begin;
+	return strlen(Key) == Length && !strncmp(Begin, Key, Length);
+}
+
+static bool ParseSize(const char* Begin, const char* End, TSize& OutSize)
+{
+	TSize Size = 0;
+	const char* Pos = Begin;
+
+	for (; Pos < End && *Pos >= '0' && *Pos <= '9'; ++Pos)
+	{
+		TSize Digit = *Pos - '0';
+
+		if (Size > (std::numeric_limits<TSize>::max() - Digit) / 10)
+		{
+			return false;
+		}
+
+		Size = Size * 10 + Digit;
+	}
+
+	if (Pos == Begin)
+	{
+		return false;
+	}
+
+	TSize Shift = 0;
+
+	if (Pos < End)
+	{
+		switch (*Pos | 0x20)
+		{
+		case 'k':
+			Shift = 10;
+			break;
+		case 'm':
+			Shift = 20;
+			break;
+		case 'g':
+			Shift = 30;
+			break;
+		default:
+			return false;
+		}
+
+		++Pos;
+	}
+
+	if (Pos != End || Size > (std::numeric_limits<TSize>::max() >> Shift))
+	{
+		return false;
+	}
+
+	OutSize = Size << Shift;
+
+	return true;
+}
+
+static bool ParseBool(const char* Begin, const char* End, bool& OutValue)
+{
+	if (IsKey(Begin, End, "true") || IsKey(Begin, End, "1"))
+	{
+		OutValue = true;
+		return true;
+	}
+
+	if (IsKey(Begin, End, "false") || IsKey(Begin, End, "0"))
+	{
+		OutValue = false;
+		return true;
+	}
+
+	return false;
+}
+
+static bool ParsePrewarm(const char* Begin, const char* End, TMallocConf& InOutConf)
+{
+	TSize PrewarmCount = 0;
+	const char* Pos = Begin;
+
+	while (Pos < End)
+	{
+		const char* EntryEnd = Pos;
+
+		while (EntryEnd < End && *EntryEnd != ';')
+		{
+			++EntryEnd;
+		}
+
+		const char* Separator = Pos;
+
+		while (Separator < EntryEnd && *Separator != 'x')
+		{
+			++Separator;
+		}
+
+		TMallocConfPrewarm Prewarm{};
+
+		if (PrewarmCount == MALLOC_CONF_MAX_PREWARM_COUNT ||
+			!ParseSize(Pos, Separator, Prewarm.Size) ||
+			Separator == EntryEnd ||
+			!ParseSize(Separator + 1, EntryEnd, Prewarm.Count))
+		{
+			return false;
+		}
+
+		InOutConf.Prewarm[PrewarmCount++] = Prewarm;
+		Pos = EntryEnd < End ? EntryEnd + 1 : EntryEnd;
+	}
+
+	InOutConf.PrewarmCount = PrewarmCount;
+
+	return PrewarmCount != 0;
+}
+
+static bool ParseOption(const char* Begin, const char* End, TMallocConf& InOutConf)
+{
+	const char* Separator = Begin;
+
+	while (Separator < End && *Separator != ':' && *Separator != '=')
+	{
+		++Separator;
+	}
+
+	if (Separator == End)
+	{
+		return false;
+	}
+
+	const char* ValueBegin = Separator + 1;
+
+	if (IsKey(Begin, Separator, "stats_print"))
+	{
+		return ParseBool(ValueBegin, End, InOutConf.StatsPrint);
+	}
+
+	if (IsKey(Begin, Separator, "background_thread"))
+	{
+		return ParseBool(ValueBegin, End, InOutConf.BackgroundThread);
+	}
+
+	if (IsKey(Begin, Separator, "pressure_monitor"))
+	{
+		return ParseBool(ValueBegin, End, InOutConf.PressureMonitor);
+	}
+
+	if (IsKey(Begin, Separator, "large_buffers"))
+	{
+		return ParseBool(ValueBegin, End, InOutConf.LargeBuffers);
+	}
+
+	if (IsKey(Begin, Separator, "prewarm"))
+	{
+		return ParsePrewarm(ValueBegin, End, InOutConf);
+	}
+
+	for (const TMallocConfKey& Key : MallocConfKeys)
+	{
+		if (IsKey(Begin, Separator, Key.Name))
+		{
+			return ParseSize(ValueBegin, End, InOutConf.*Key.Value);
+		}
+	}
+
+	return false;
+}
+
+bool ParseMallocConf(const char* ConfStr, TMallocConf& InOutConf)
+{
+	if (!ConfStr)
+	{
+		return true;
+	}
+
+	bool Ok = true;
+	const char* Pos = ConfStr;
+
+	while (*Pos)
+	{
+		const char* OptionEnd = Pos;
+
+		while (*OptionEnd && *OptionEnd != ',')
+		{
+			++OptionEnd;
+		}
+
+		if (OptionEnd != Pos && !ParseOption(Pos, OptionEnd, InOutConf))
+		{
+#ifdef MALLOC_SCALED_DEBUG
+			printf("MALLOC: DBG: %s: skipping invalid option: %.*s\n", MALLOC_SCALED_CONF_ENV, (int32)(OptionEnd - Pos), Pos);
+#endif
+			Ok = false;
+		}
+
+		Pos = *OptionEnd ? OptionEnd + 1 : OptionEnd;
+	}
+
+	return Ok;
+}
+
+const char* GetMallocConfEnv()
+{
+#if PLATFORM_WIN
+	//	The CRT getenv is deprecated by SDL checks, and the allocator may run before the CRT is ready;
+	static char ConfBuf[MALLOC_CONF_MAX_LENGTH];
+
+	DWORD Length = GetEnvironmentVariableA(MALLOC_SCALED_CONF_ENV, ConfBuf, sizeof(ConfBuf));
+
+	if (!Length || Length >= sizeof(ConfBuf))
+	{
+		return nullptr;
+	}
+
+	return ConfBuf;
+#else
+	return getenv(MALLOC_SCALED_CONF_ENV);
+#endif
+}
+
+TSize FormatMallocConf(const TMallocConf& Conf, char* OutBuf, TSize BufSize)
+{
+	TSize Length = 0;
+
+	for (const TMallocConfKey& Key : MallocConfKeys)
+	{
+		if (Length < BufSize)
+		{
+			int32 Written = snprintf(OutBuf + Length, BufSize - Length, "%s:%zu\n", Key.Name, Conf.*Key.Value);
+			Length += Written > 0 ? Written : 0;
+		}
+	}
+
+	if (Length < BufSize)
+	{
+		int32 Written = snprintf(OutBuf + Length, BufSize - Length, "stats_print:%s\n", Conf.StatsPrint ? "true" : "false");
+		Length += Written > 0 ? Written : 0;
+	}
+
+	if (Length < BufSize)
+	{
+		int32 Written = snprintf(OutBuf + Length, BufSize - Length, "background_thread:%s\n", Conf.BackgroundThread ? "true" : "false");
+		Length += Written > 0 ? Written : 0;
+	}
+
+	if (Length < BufSize)
+	{
+		int32 Written = snprintf(OutBuf + Length, BufSize - Length, "pressure_monitor:%s\n", Conf.PressureMonitor ? "true" : "false");
+		Length += Written > 0 ? Written : 0;
+	}
+
+	if (Length < BufSize)
+	{
+		int32 Written = snprintf(OutBuf + Length, BufSize - Length, "large_buffers:%s\n", Conf.LargeBuffers ? "true" : "false");
+		Length += Written > 0 ? Written : 0;
+	}
+
+	for (TSize i = 0; i < Conf.PrewarmCount && Length < BufSize; ++i)
+	{
+		int32 Written = snprintf(OutBuf + Length, BufSize - Length, "%s%zux%zu%s", i ? "" : "prewarm:", Conf.Prewarm[i].Size, Conf.Prewarm[i].Count, i + 1 < Conf.PrewarmCount ? ";" : "\n");
+		Length += Written > 0 ? Written : 0;
+	}
+
+	return Length < BufSize ? Length : (BufSize ? BufSize - 1 : 0);
+}
@@ -5,18 +5,26 @@
 #include "element_build.h"
 #include "search_min_max.h"
 #include "timer.h"
+#include "zero_memory.h"
+#include "stats_writer.h"
 
 static const TSize MALLOC_SCALED_ALLOCATION_ADJUSTMENT   = 3;
 static const TSize MALLOC_SCALED_REALLOCATION_ADJUSTMENT = 4;
 
 TTimeStats Ts;
 
-TSize TMemPoolTable::CalculateNumOfBaseEntries(TSize MinBaseBlockSize, TSize MaxBaseBlockSize)
+thread_local TMallocCounters GThreadMallocCounters{};
+bool GMallocProcessExiting = false;
+thread_local TThreadHeadSlots GThreadHeadSlots{};
+
+template<typename TCONFIG>
+TSize TMemPoolTable<TCONFIG>::CalculateNumOfBaseEntries(TSize MinBaseBlockSize, TSize MaxBaseBlockSize)
 {
 	return (FloorLog2(MaxBaseBlockSize) - FloorLog2(MinBaseBlockSize) + 1);
 }
 
-TSize TMemPoolTable::CalculatePoolBlockSize(TSize BaseIndex, TSize PoolIndex, TSize MinBaseBlockSize, TSize MaxBaseBlockSize, TSize SubIndexCount)
+template<typename TCONFIG>
+TSize TMemPoolTable<TCONFIG>::CalculatePoolBlockSize(TSize BaseIndex, TSize PoolIndex, TSize MinBaseBlockSize, TSize MaxBaseBlockSize, TSize SubIndexCount)
 {
 	TSize MinBaseIndex = Log2_64(MinBaseBlockSize);
 	TSize MaxBaseIndex = Log2_64(MaxBaseBlockSize);
@@ -37,9 +45,10 @@ TSize TMemPoolTable::CalculatePoolBlockSize(TSize BaseIndex, TSize PoolIndex, TS
 	return BlockSize;
 }
 
-bool TMemPoolTable::GetBaseIndex(TSize BlockSize, TSize MinBaseIndex, TSize MaxBaseIndex, TSize& OutBaseIdx)
+template<typename TCONFIG>
+bool TMemPoolTable<TCONFIG>::GetBaseIndex(TSize BlockSize, TSize MinBaseIndex, TSize MaxBaseIndex, TSize& OutBaseIdx)
 {
-	TSize BlockIndex = CeilLog2(BlockSize);
+	TSize BlockIndex = CeilLog2Fast(BlockSize);
 
 	if (BlockIndex < MinBaseIndex)
 	{
@@ -59,37 +68,145 @@ bool TMemPoolTable::GetBaseIndex(TSize BlockSize, TSize MinBaseIndex, TSize MaxB
 	return true;
 }
 
-TSize TMemPoolTable::GetPoolIndex(TSize BlockSize, TSize BaseIndex, TSize MinBaseIndex, TSize SubIndexCountShift)
+template<typename TCONFIG>
+TSize TMemPoolTable<TCONFIG>::GetPoolIndex(TSize BlockSize, TSize BaseIndex, TSize MinBaseIndex, TSize SubIndexCountShift)
 {
 	TSize BlockIndex = MinBaseIndex + BaseIndex;
 	//TSize UpperPoolBlockSize = Pow2_64(BlockIndex);
 	TSize LowerPoolBlockSize = BlockIndex == MinBaseIndex ? 0 : ((TSize)1 << (BlockIndex - 1));
 
-	TSize SpacingShift = BlockIndex == MinBaseIndex ? 5 : (BlockIndex - 1) - SubIndexCountShift;//(LowerPoolBlockSize) >> SubIndexCountShift;
-	TSize PoolIndex = ((BlockSize - LowerPoolBlockSize) >> SpacingShift);
+	//	The smallest base entry spans [0, 2^MinBaseIndex], the others span (2^(BlockIndex - 1), 2^BlockIndex];
+	TSize SpacingShift = BlockIndex == MinBaseIndex ? MinBaseIndex - SubIndexCountShift : (BlockIndex - 1) - SubIndexCountShift;
+	TSize PoolIndex = ((BlockSize - LowerPoolBlockSize - 1) >> SpacingShift);
+
+	return PoolIndex;
+}
 
-	if (PoolIndex == ((TSize)1 << SubIndexCountShift))
+template<typename TCONFIG>
+TMemPool<TCONFIG>* TMemPoolTable<TCONFIG>::GetPool(TSize BlockSize)
+{
+	if (BlockSize <= TCONFIG::DirectLookupMaxSize)
 	{
-		--PoolIndex;
+		return PoolLookup[BlockSize >> MALLOC_SCALED_DIRECT_LOOKUP_SHIFT];
 	}
 
-	return PoolIndex;
+	TSize BaseIndex = 0;
+
+	if (StaticSizeClasses)
+	{
+		if (!GetBaseIndex(BlockSize, TSizeClasses::MinBaseIndex, TSizeClasses::MaxBaseIndex, BaseIndex))
+		{
+			return nullptr;
+		}
+
+		return BaseEntries[BaseIndex].GetPool(GetPoolIndex(BlockSize, BaseIndex, TSizeClasses::MinBaseIndex, TSizeClasses::SubIndexCountShift));
+	}
+
+	if (!GetBaseIndex(BlockSize, MinBaseIndex, MaxBaseIndex, BaseIndex))
+	{
+		return nullptr;
+	}
+
+	TSize PoolIndex = GetPoolIndex(BlockSize, BaseIndex, MinBaseIndex, SubIndexCountShift);
+
+	return BaseEntries[BaseIndex].GetPool(PoolIndex);
+}
+
+template<typename TCONFIG>
+void TMemPoolTable<TCONFIG>::InitPoolLookup()
+{
+	TSize LookupCount = TSizeClasses::LookupCount;
+
+	//	The table was built for the configured size classes, MALLOC_SCALED_CONF or DebugInit may request other ones;
+	StaticSizeClasses = MinBaseIndex == TSizeClasses::MinBaseIndex &&
+		MaxBaseIndex == TSizeClasses::MaxBaseIndex &&
+		SubIndexCountShift == TSizeClasses::SubIndexCountShift;
+
+	if (StaticSizeClasses)
+	{
+		for (TSize i = 0; i < LookupCount; ++i)
+		{
+			uint16 LookupClass = TSizeClasses::LookupClasses[i];
+			PoolLookup[i] = BaseEntries[LookupClass >> 8].GetPool(LookupClass & 0xFF);
+		}
+
+		return;
+	}
+
+	for (TSize i = 0; i < LookupCount; ++i)
+	{
+		//	Block sizes are aligned by MALLOC_SCALED_DEFAULT_ALIGNMENT, so the smallest one is a single step;
+		TSize BlockSize = i ? (i << MALLOC_SCALED_DIRECT_LOOKUP_SHIFT) : MALLOC_SCALED_DEFAULT_ALIGNMENT;
+		TSize BaseIndex = 0;
+
+		if (GetBaseIndex(BlockSize, MinBaseIndex, MaxBaseIndex, BaseIndex))
+		{
+			TSize PoolIndex = GetPoolIndex(BlockSize, BaseIndex, MinBaseIndex, SubIndexCountShift);
+			PoolLookup[i] = BaseEntries[BaseIndex].GetPool(PoolIndex);
+		}
+		else
+		{
+			PoolLookup[i] = nullptr;
+		}
+	}
 }
 
-void TMemPool::Init(TSize BaseIndex, TSize PoolIndex, TSize BlockSize, TSize PoolBlockSize)
+template<typename TCONFIG>
+void TMemPool<TCONFIG>::Init(TSize BaseIndex, TSize PoolIndex, TSize BlockSize, TSize PoolBlockSize, TSize ArenaSize, void* ArenaOwner, TMemPoolCache* PoolCache)
 {
+	this->PoolCache = PoolCache;
 	this->PoolIndex = PoolIndex;
 	this->BaseIndex = BaseIndex;
 	this->BlockSize = BlockSize;
 	this->PoolBlockSize = PoolBlockSize;
 	this->PoolVMBlockSize = AlignToUpper(PoolBlockSize + MemPoolHdrSize, TVMBlock::GetPageSize());
+	this->ArenaSize = ArenaSize;
+	this->ArenaOwner = ArenaOwner;
+
+	//	Size classes start their rotation apart, so the first pools of the classes do not share a color either;
+	NextColor = BaseIndex * TCONFIG::MaxSubIndexCount + PoolIndex;
+
+	//	Big blocks get a pool each sized by the request, they are never provisioned ahead nor purged by groups;
+	if (BlockSize <= PoolBlockSize)
+	{
+		TSize BlockStride = MemBlockHdrSize + MemBlockHdrOffsetSize + BlockSize;
+		TSize PoolBlockCount = (PoolVMBlockSize - MemPoolHdrSize) / BlockStride;
+		SpareLowWater = PoolBlockCount / MALLOC_SCALED_SPARE_POOL_LOW_WATER + 1;
+
+		TSize MinGroupBlockCount = (MALLOC_SCALED_POOL_GROUP_MIN_SIZE + BlockStride - 1) / BlockStride;
+		GroupBlockCount = (PoolBlockCount + MALLOC_SCALED_POOL_GROUP_COUNT - 1) / MALLOC_SCALED_POOL_GROUP_COUNT;
+		GroupBlockCount = GroupBlockCount > MinGroupBlockCount ? GroupBlockCount : MinGroupBlockCount;
+
+		//	Free blocks of a group are counted in 16 bits, pools with bigger groups are not purged by groups;
+		if (GroupBlockCount > 0xFFFF)
+		{
+			GroupBlockCount = 0;
+		}
+
+		GroupStride = GroupBlockCount * BlockStride;
+	}
 
 #ifdef MALLOC_STATS
 	Stats.BlockSize = BlockSize;
 #endif
 }
 
-TMemPoolHdr* TMemPool::AddPool()
+template<typename TCONFIG>
+inline TSize TMemPool<TCONFIG>::GetPoolColor(TSize PoolVMBlockSize)
+{
+	TSize Slack = (PoolVMBlockSize - MemPoolHdrSize) % (MemBlockHdrSize + MemBlockHdrOffsetSize + BlockSize);
+	TSize ColorCount = Slack / MALLOC_SCALED_CACHE_LINE_SIZE + 1;
+
+	if (ColorCount > PoolCache->ColorCount)
+	{
+		ColorCount = PoolCache->ColorCount;
+	}
+
+	return (NextColor++ % ColorCount) * MALLOC_SCALED_CACHE_LINE_SIZE;
+}
+
+template<typename TCONFIG>
+TMemPoolHdr* TMemPool<TCONFIG>::AddPool()
 {
 	if (BlockSize > PoolBlockSize)
 	{
@@ -108,34 +225,67 @@ TMemPoolHdr* TMemPool::AddPool()
 	//TIMER
 	//FUNC_TIME(bool Ok = NewPoolVMBlock.Allocate(PoolVMBlockSize));
 	TVMBlock NewPoolVMBlock;
-	//	printf("MALLOC: DBG: Last vm alloc time: %f ns\n", std::chrono::duration<float64, std::nano>(Ts.GetLastTime()).count());
-	bool Ok = NewPoolVMBlock.Allocate(PoolVMBlockSize);
-	//FUNC_TIME(bool Ok = NewPoolVMBlock.Allocate(PoolVMBlockSize));
-	//printf("MALLOC: DBG: Last vm alloc time: %f ns\n", std::chrono::duration<float64, std::nano>(Ts.GetLastTime()).count());
+	bool Untouched = false;
+	auto SparePoolNode = SparePools.PopBack();
+	auto CachedPoolNode = SparePoolNode ? nullptr : CachedPools.PopBack();
 
-	if (!Ok)
+	if (SparePoolNode)
 	{
+		TMemPoolHdr* SparePool = *SparePoolNode->GetElement();
+		NewPoolVMBlock = move(SparePool->PoolVMBlock);
+		Untouched = SparePool->Untouched;
+
+		--SparePoolCount;
+		++PoolCache->Stats.Provisioned;
+	}
+	else if (CachedPoolNode)
+	{
+		TMemPoolHdr* CachedPool = *CachedPoolNode->GetElement();
+		NewPoolVMBlock = move(CachedPool->PoolVMBlock);
+
+		--CachedPoolCount;
+		--PoolCache->Stats.CachedPoolCount;
+		PoolCache->Stats.CachedSize -= NewPoolVMBlock.GetAllocatedSize();
+		++PoolCache->Stats.Hits;
+	}
+	else
+	{
+		//	printf("MALLOC: DBG: Last vm alloc time: %f ns\n", std::chrono::duration<float64, std::nano>(Ts.GetLastTime()).count());
+		bool Ok = NewPoolVMBlock.Allocate(PoolVMBlockSize, ArenaSize, ArenaOwner);
+		//FUNC_TIME(bool Ok = NewPoolVMBlock.Allocate(PoolVMBlockSize));
+		//printf("MALLOC: DBG: Last vm alloc time: %f ns\n", std::chrono::duration<float64, std::nano>(Ts.GetLastTime()).count());
+
+		if (!Ok)
+		{
 #ifdef MALLOC_SCALED_DEBUG
-		printf("MALLOC: DBG: VM BLOCK: Cannot allocate vm block\n");
+			printf("MALLOC: DBG: VM BLOCK: Cannot allocate vm block\n");
 #endif
-		return nullptr;
+			return nullptr;
+		}
+
+		Untouched = NewPoolVMBlock.IsUntouched();
+		++PoolCache->Stats.Misses;
 	}
 
 	PoolBlockSize = PoolVMBlockSize - MemPoolHdrSize;
 
-	TMemPoolHdr* PoolHdr = (TMemPoolHdr*)NewPoolVMBlock.GetBase();
+	//	The color only takes the slack left behind the last block, the block count stays the same;
+	TSize Color = GetPoolColor(PoolVMBlockSize);
+	TMemPoolHdr* PoolHdr = (TMemPoolHdr*)((uint8*)NewPoolVMBlock.GetBase() + Color);
 	new (PoolHdr) TMemPoolHdr{};
 		
 	PoolHdr->MemPool = this;
 	PoolHdr->PoolVMBlock = move(NewPoolVMBlock);
-	TSize BlockCount = PoolBlockSize / (MemBlockHdrSize + MemBlockHdrOffsetSize + BlockSize);
+	//	A cached pool keeps the contents of its previous blocks;
+	PoolHdr->Untouched = Untouched;
+	TSize BlockCount = (PoolBlockSize - Color) / (MemBlockHdrSize + MemBlockHdrOffsetSize + BlockSize);
 	PoolHdr->TotalBlockCount = BlockCount;
 	PoolHdr->FreeBlockCount = BlockCount;
+	PoolHdr->Bin = POOL_BIN_EMPTY;
 
 	++PoolCount;
 	TotalFreeBlockCount += BlockCount;
-	PoolList.PushBack(PoolHdr);
-	HeadPool = PoolHdr;
+	PoolBins[POOL_BIN_EMPTY].PushBack(PoolHdr);
 
 #ifdef MALLOC_STATS
 	Stats.AllocatedSize += PoolVMBlockSize;
@@ -146,9 +296,10 @@ TMemPoolHdr* TMemPool::AddPool()
 	return PoolHdr;
 }
 
-void TMemPool::DeletePool(TMemPoolHdr* Pool)
+template<typename TCONFIG>
+void TMemPool<TCONFIG>::DeletePool(TMemPoolHdr* Pool, bool Cache)
 {
-	PoolList.Delete(Pool);
+	PoolBins[Pool->Bin].Delete(Pool);
 	--PoolCount;
 	TotalFreeBlockCount -=Pool->FreeBlockCount;
 
@@ -160,47 +311,185 @@ void TMemPool::DeletePool(TMemPoolHdr* Pool)
 	Stats.Used -= Pool->Used;
 #endif
 
-	TVMBlock PoolVMBlock = move(Pool->PoolVMBlock); 
-	PoolVMBlock.Free();
+	if (!Cache || !CachePool(Pool))
+	{
+		ReclaimPool(Pool);
+	}
+}
+
+template<typename TCONFIG>
+bool TMemPool<TCONFIG>::CachePool(TMemPoolHdr* Pool)
+{
+	TSize PoolSize = Pool->PoolVMBlock.GetAllocatedSize();
+
+	if (!PoolCache->HighWater || PoolCache->Stats.CachedSize + PoolSize > PoolCache->MaxCachedSize)
+	{
+		++PoolCache->Stats.Evictions;
+		return false;
+	}
+
+	CachedPools.PushBack(Pool);
+	++CachedPoolCount;
+	++PoolCache->Stats.CachedPoolCount;
+	PoolCache->Stats.CachedSize += PoolSize;
+
+	if (PoolCache->Stats.CachedSize > PoolCache->Stats.PeakCachedSize)
+	{
+		PoolCache->Stats.PeakCachedSize = PoolCache->Stats.CachedSize;
+	}
+
+	if (CachedPoolCount > PoolCache->HighWater)
+	{
+		TrimCachedPools(PoolCache->LowWater);
+	}
+
+	return true;
 }
 
-TMemPoolHdr* TMemPool::FindNewHeadPool()
+template<typename TCONFIG>
+void TMemPool<TCONFIG>::TrimCachedPools(TSize KeepCount)
 {
-	auto PoolNode = PoolList.GetFirst();
+	while (CachedPoolCount > KeepCount)
+	{
+		TMemPoolHdr* Pool = *CachedPools.PopFront()->GetElement();
+
+		--CachedPoolCount;
+		--PoolCache->Stats.CachedPoolCount;
+		PoolCache->Stats.CachedSize -= Pool->PoolVMBlock.GetAllocatedSize();
+		++PoolCache->Stats.Evictions;
 
-	TMemPoolHdr* Pool = nullptr;
-	TMemPoolHdr* Head = nullptr;
+		ReclaimPool(Pool);
+	}
+}
+
+template<typename TCONFIG>
+void TMemPool<TCONFIG>::ReclaimPool(TMemPoolHdr* Pool)
+{
+	//	The header stays in the pool memory until the pool is unmapped;
+	PoolCache->ReclaimPools.PushBack(Pool);
+	++PoolCache->ReclaimPoolCount;
+}
 
-	while (PoolNode)
+template<typename TCONFIG>
+TMemPoolHdr* TMemPool<TCONFIG>::FindNewHeadPool(TSize HeadSlot)
+{
+	//	Fullest non full pools first, empty pools are used last. Heads of other slots are skipped;
+	for (TSize Bin = POOL_BIN_HIGH; Bin < POOL_BIN_COUNT; ++Bin)
 	{
-		Pool = *PoolNode->GetElement();
+		auto PoolNode = PoolBins[Bin].GetLast();
 
-		if (HeadPool != Pool && Pool->FreeBlockCount >= (HeadPool->FreeBlockCount >> 1))
+		while (PoolNode)
 		{
-			if (!Head)
-			{
-				Head = Pool;
-			}
-			else
+			TMemPoolHdr* Pool = *PoolNode->GetElement();
+
+			if (!Pool->Head &&
+				(Bin == POOL_BIN_EMPTY ||
+				 !Pool->LastHead ||
+				 Pool->LastHead == HeadSlot + 1 ||
+				 !(PoolCache->HeldHeadSlots & ((uint64)1 << (Pool->LastHead - 1)))))
 			{
-				if (Pool->FreeBlockCount > Head->FreeBlockCount)
-				{
-					Head = Pool;
-				}
+				return Pool;
 			}
+
+			PoolNode = PoolNode->GetPrev();
 		}
+	}
+
+	return nullptr;
+}
+
+template<typename TCONFIG>
+inline void TMemPool<TCONFIG>::SetHeadPool(TSize HeadSlot, TMemPoolHdr* Pool)
+{
+	if (HeadPools[HeadSlot])
+	{
+		HeadPools[HeadSlot]->Head = 0;
+	}
+
+	HeadPools[HeadSlot] = Pool;
+
+	if (Pool)
+	{
+		Pool->Head = HeadSlot + 1;
+		Pool->LastHead = HeadSlot + 1;
+	}
+}
+
+template<typename TCONFIG>
+void TMemPool<TCONFIG>::DropHeadSlot(TSize HeadSlot)
+{
+	if (HeadPools[HeadSlot])
+	{
+		SetHeadPool(HeadSlot, nullptr);
+	}
+}
+
+template<typename TCONFIG>
+inline void TMemPool<TCONFIG>::DropHeadPool(TMemPoolHdr* Pool)
+{
+	if (Pool->Head)
+	{
+		HeadPools[Pool->Head - 1] = nullptr;
+		Pool->Head = 0;
+	}
+}
+
+template<typename TCONFIG>
+inline TSize TMemPool<TCONFIG>::GetPoolBin(TMemPoolHdr* Pool)
+{
+	TSize FreeBlockCount = Pool->FreeBlockCount;
+	TSize TotalBlockCount = Pool->TotalBlockCount;
+	TSize Quarter = TotalBlockCount >> 2;
+
+	if (FreeBlockCount == 0)
+	{
+		return POOL_BIN_FULL;
+	}
+
+	if (FreeBlockCount == TotalBlockCount)
+	{
+		return POOL_BIN_EMPTY;
+	}
 
-		PoolNode = PoolNode->GetNext();
+	if (FreeBlockCount < Quarter)
+	{
+		return POOL_BIN_HIGH;
+	}
+
+	if (FreeBlockCount > TotalBlockCount - Quarter)
+	{
+		return POOL_BIN_LOW;
 	}
 
-	return Head;
+	return POOL_BIN_MEDIUM;
 }
 
+template<typename TCONFIG>
+inline void TMemPool<TCONFIG>::UpdatePoolBin(TMemPoolHdr* Pool)
+{
+	TSize Bin = GetPoolBin(Pool);
+
+	if (Bin != Pool->Bin)
+	{
+		PoolBins[Pool->Bin].Delete(Pool);
+		PoolBins[Bin].PushBack(Pool);
+		Pool->Bin = Bin;
+	}
+}
 
-TMemBlockHdr* TMemPool::GetFreeBlock(TSize UsedSize)
+template<typename TCONFIG>
+TMemBlockHdr* TMemPool<TCONFIG>::GetFreeBlock(TSize UsedSize, bool& OutUntouched, TSize HeadSlot)
 {
+	OutUntouched = false;
+
+	TMemPoolHdr* HeadPool = HeadPools[HeadSlot];
+
 	if (!HeadPool || HeadPool->FreeBlockCount == 0)
 	{
+		HeadPool = FindNewHeadPool(HeadSlot);
+
+		if (!HeadPool)
+		{
 			HeadPool = AddPool();
 
 			if (!HeadPool)
@@ -210,6 +499,9 @@ TMemBlockHdr* TMemPool::GetFreeBlock(TSize UsedSize)
 	//#endif
 				return nullptr;
 			}
+		}
+
+		SetHeadPool(HeadSlot, HeadPool);
 	}
 
 	TMemBlockHdr* FreeBlock = nullptr;
@@ -221,14 +513,12 @@ TMemBlockHdr* TMemPool::GetFreeBlock(TSize UsedSize)
 	{
 		if (Pool->ActiveBlocks != Pool->TotalBlockCount)
 		{
-			uint8* FirstBlock = (uint8*)(Pool + 1);
-			auto InactiveBlock = (FirstBlock + (MemBlockHdrSize + MemBlockHdrOffsetSize + BlockSize) * Pool->ActiveBlocks);
-			++Pool->ActiveBlocks;
-			FreeBlock = (TMemBlockHdr*)InactiveBlock;
-			new (FreeBlock) TMemBlockHdr{};
-
-			FreeBlock->BlockSize = BlockSize;
-			FreeBlock->PoolHdr = Pool;
+			FreeBlock = CarveBlock(Pool, Pool->ActiveBlocks++);
+			OutUntouched = Pool->Untouched;
+		}
+		else if (Pool->RestoredBlocks != Pool->RestoredEnd || RestorePurgedGroup(Pool))
+		{
+			FreeBlock = CarveBlock(Pool, Pool->RestoredBlocks++);
 		}
 		else
 		{
@@ -240,13 +530,21 @@ TMemBlockHdr* TMemPool::GetFreeBlock(TSize UsedSize)
 	else
 	{
 		FreeBlock = *FoundBlock->GetElement();
+
+		if (GroupStride)
+		{
+			--Pool->GroupFreeCounts[GetBlockGroup(Pool, FreeBlock)];
+		}
 	}
 
 	if (FreeBlock)
 	{
 		FreeBlock->UsedSize = UsedSize;
+		++Counters.MallocCount;
+		Counters.Allocated += UsedSize;
 		--Pool->FreeBlockCount;
 		--TotalFreeBlockCount;
+		UpdatePoolBin(Pool);
 
 #ifdef MALLOC_STATS
 		Pool->Used += UsedSize;
@@ -283,173 +581,551 @@ TMemBlockHdr* TMemPool::GetFreeBlock(TSize UsedSize)
 	return FreeBlock;
 }
 
-void TMemPool::Release()
+template<typename TCONFIG>
+inline TMemBlockHdr* TMemPool<TCONFIG>::CarveBlock(TMemPoolHdr* Pool, TSize BlockIndex)
 {
-	auto NextPoolNode = PoolList.GetFirst();
+	uint8* FirstBlock = (uint8*)(Pool + 1);
+	TMemBlockHdr* Block = (TMemBlockHdr*)(FirstBlock + (MemBlockHdrSize + MemBlockHdrOffsetSize + BlockSize) * BlockIndex);
+	new (Block) TMemBlockHdr{};
 
-	while (NextPoolNode)
-	{
-		auto PoolToFree = *NextPoolNode->GetElement();
-		NextPoolNode = NextPoolNode->GetNext();
-		DeletePool(PoolToFree);
-	}
+	Block->BlockSize = BlockSize;
+	Block->PoolHdr = Pool;
 
-	HeadPool = nullptr;
+	return Block;
+}
 
-#ifdef MALLOC_STATS
-	Stats = {};
-#endif
+template<typename TCONFIG>
+inline TSize TMemPool<TCONFIG>::GetBlockGroup(TMemPoolHdr* Pool, TMemBlockHdr* Block)
+{
+	return ((uint8*)Block - (uint8*)(Pool + 1)) / GroupStride;
 }
 
-void TMemPool::FreeUsrBlock(TMemBlockHdr* UsrBlock)
+template<typename TCONFIG>
+bool TMemPool<TCONFIG>::RestorePurgedGroup(TMemPoolHdr* Pool)
 {
-	if (UsrBlock)
+	for (TSize i = 0; i < MALLOC_SCALED_POOL_GROUP_COUNT / 64; ++i)
 	{
-		auto Pool = UsrBlock->PoolHdr;
-		TSize UsedSize = UsrBlock->UsedSize;
-
-#ifdef MALLOC_STATS
-		Pool->UsrBlockList.Delete(UsrBlock);
-		Pool->Used -= UsrBlock->UsedSize;
-#endif
-		Pool->FreeBlockList.PushBack(UsrBlock);
-		++Pool->FreeBlockCount;
-		++TotalFreeBlockCount;
+		uint64 Groups = Pool->PurgedGroups[i];
 
-		if (Pool->FreeBlockCount == Pool->TotalBlockCount)
+		if (Groups)
 		{
-			if (TotalFreeBlockCount > (Pool->FreeBlockCount + (Pool->FreeBlockCount >> 1)))
+			TSize Group = i * 64 + FloorLog2Fast(Groups & (~Groups + 1));
+			Pool->PurgedGroups[i] = Groups & (Groups - 1);
+
+			Pool->RestoredBlocks = Group * GroupBlockCount;
+			Pool->RestoredEnd = Pool->RestoredBlocks + GroupBlockCount;
+
+			if (Pool->RestoredEnd > Pool->TotalBlockCount)
 			{
-				if (Pool == HeadPool)
-				{
-					auto NewHead = FindNewHeadPool();
-					HeadPool = NewHead;
-				}
-				DeletePool(Pool);
-				return;
+				Pool->RestoredEnd = Pool->TotalBlockCount;
 			}
-		}
 
-		if (Pool->FreeBlockCount > HeadPool->FreeBlockCount)
-		{
-			HeadPool = Pool;
+			return true;
 		}
-
-#ifdef MALLOC_STATS
-		Stats.Used -= UsrBlock->UsedSize;
-		--Stats.UsedBlockCount;
-#endif
-		UsrBlock->UsedSize = 0;
 	}
-}
-
-TSize TMemPool::GetBlockSize()
-{
-	return BlockSize;
-}
 
-TSize TMemPool::GetPoolCount()
-{
-	return PoolCount;
+	return false;
 }
 
-TMemPoolHdr* TMemPool::GetTop()
+template<typename TCONFIG>
+TSize TMemPool<TCONFIG>::DetachFreeGroups(TMemPoolPageRange* OutRanges, TSize MaxRangeCount, TSize& InOutKeepSize)
 {
-	return HeadPool;
-}
+	TSize RangeCount = 0;
 
-TMemPool::TMemPoolStats* TMemPool::GetPoolStats()
-{
-#ifdef MALLOC_STATS
-	auto FirstPool = PoolList.GetFirst();
+	if (!GroupBlockCount)
+	{
+		return 0;
+	}
 
-	for (auto Pool = FirstPool; Pool != nullptr; Pool = Pool->GetNext())
+	//	Pools more than a quarter free, empty ones are left to the pool cache and Trim;
+	for (TSize Bin : { POOL_BIN_MEDIUM, POOL_BIN_LOW })
 	{
-		auto PoolHdr = *(Pool->GetElement());
-		auto FirstBlock = PoolHdr->UsrBlockList.GetFirst();
+		auto PoolNode = PoolBins[Bin].GetFirst();
 
-		for (auto Block = FirstBlock; Block != nullptr; Block = Block->GetNext())
+		while (PoolNode && RangeCount < MaxRangeCount)
 		{
-			auto BlockHdr = *(Block->GetElement());
+			TMemPoolHdr* Pool = *PoolNode->GetElement();
+			PoolNode = PoolNode->GetNext();
 
-			if (BlockHdr->UsedSize > Stats.BlockStats.MaxUsedBlock)
-			{
-				Stats.BlockStats.MaxUsedBlock = BlockHdr->UsedSize;
-			}
-
-			else if (BlockHdr->UsedSize < Stats.BlockStats.MinUsedBlock)
-			{
-				Stats.BlockStats.MinUsedBlock = BlockHdr->UsedSize;
-			}
+			RangeCount += DetachFreeGroups(Pool, OutRanges + RangeCount, MaxRangeCount - RangeCount, InOutKeepSize);
 		}
 	}
 
-	return &Stats;
-#elif MALLOC_SCALED_DEBUG
-	printf("MALLOC: DBG: Malloc stats are not enabled");
-	return nullptr;
-#else
-	return nullptr;
-#endif
+	return RangeCount;
 }
 
-bool TMemPoolTableEntry::Init(TSize BaseIndex, TSize MinBaseBlockSize, TSize MaxBaseBlockSize, TSize PoolBlockSize, TSize SubIndexCountShift)
+template<typename TCONFIG>
+TSize TMemPool<TCONFIG>::DetachFreeGroups(TMemPoolHdr* Pool, TMemPoolPageRange* OutRanges, TSize MaxRangeCount, TSize& InOutKeepSize)
 {
-	if (Initialized)
+	TSize BlockStride = MemBlockHdrSize + MemBlockHdrOffsetSize + BlockSize;
+	TSize PageSize = TVMBlock::GetPageSize();
+	uint8* FirstBlock = (uint8*)(Pool + 1);
+
+	TSize RangeCount = 0;
+	TSize DetachedCount = 0;
+
+	//	Free counts are kept by GetFreeBlock and FreeUsrBlock, the free list is not walked;
+	for (TSize Group = 0; Group < MALLOC_SCALED_POOL_GROUP_COUNT && RangeCount < MaxRangeCount; ++Group)
 	{
-		return false;
+		TSize First = Group * GroupBlockCount;
+		TSize End = First + GroupBlockCount < Pool->TotalBlockCount ? First + GroupBlockCount : Pool->TotalBlockCount;
+
+		//	Purged groups and blocks not carved yet are not in the free list, so such groups never match;
+		if (First >= End || End > Pool->ActiveBlocks || Pool->GroupFreeCounts[Group] != End - First)
+		{
+			continue;
+		}
+
+		//	Pages shared with the blocks of neighbour groups stay;
+		uint8* Begin = AlignToUpper(FirstBlock + First * BlockStride, PageSize);
+		uint8* PagesEnd = AlignToLower(FirstBlock + End * BlockStride, PageSize);
+
+		if (Begin >= PagesEnd)
+		{
+			continue;
+		}
+
+		if ((TSize)(PagesEnd - Begin) <= InOutKeepSize)
+		{
+			InOutKeepSize -= PagesEnd - Begin;
+			continue;
+		}
+
+		//	All blocks of the group are free, so each of them is in the free list;
+		for (TSize i = First; i < End; ++i)
+		{
+			Pool->FreeBlockList.Delete((TMemBlockHdr*)(FirstBlock + i * BlockStride));
+		}
+
+		Pool->GroupFreeCounts[Group] = 0;
+		DetachedCount += End - First;
+		OutRanges[RangeCount++] = TMemPoolPageRange{ Pool, Group, End - First, Begin, (TSize)(PagesEnd - Begin) };
 	}
 
-	if (SubIndexCountShift > MaxSubIndexCountShift)
+	if (!RangeCount)
 	{
-		// log error;
-		return false;
+		return 0;
 	}
 
-	for (TSize i = 0; i < ((TSize)1 << SubIndexCountShift); ++i)
+	//	Detached blocks are not counted as free until the group is attached back;
+	Pool->FreeBlockCount -= DetachedCount;
+	TotalFreeBlockCount -= DetachedCount;
+	DetachedBlockCount += DetachedCount;
+	UpdatePoolBin(Pool);
+
+	return RangeCount;
+}
+
+template<typename TCONFIG>
+void TMemPool<TCONFIG>::AttachPurgedGroup(const TMemPoolPageRange& Range)
+{
+	TMemPoolHdr* Pool = Range.Pool;
+
+	Pool->PurgedGroups[Range.Group / 64] |= (uint64)1 << (Range.Group % 64);
+	Pool->FreeBlockCount += Range.BlockCount;
+	TotalFreeBlockCount += Range.BlockCount;
+	DetachedBlockCount -= Range.BlockCount;
+	++PoolCache->Stats.PurgedGroups;
+
+	UpdatePoolBin(Pool);
+}
+
+template<typename TCONFIG>
+bool TMemPool<TCONFIG>::Prewarm(TSize BlockCount)
+{
+	while (TotalFreeBlockCount < BlockCount)
 	{
-		TSize BlockSize = TMemPoolTable::CalculatePoolBlockSize(BaseIndex, i, MinBaseBlockSize, MaxBaseBlockSize, ((TSize)1 << SubIndexCountShift)); 
-		Pools[i].Init(BaseIndex, i, BlockSize, PoolBlockSize);
+		TMemPoolHdr* Pool = AddPool();
+
+		if (!Pool)
+		{
+			return false;
+		}
+
+		Pool->PoolVMBlock.Populate();
 	}
 
-	this->SubIndexCountShift = SubIndexCountShift;
-	Initialized = true;
 	return true;
 }
 
-void TMemPoolTableEntry::Release()
+template<typename TCONFIG>
+bool TMemPool<TCONFIG>::RequestSparePool()
 {
-	for (TSize i = 0; i < ((TSize)1 << SubIndexCountShift); ++i)
+	if (SpareRequested || SparePoolCount || TotalFreeBlockCount >= SpareLowWater)
 	{
-		Pools[i].Release();
+		return false;
 	}
 
-	Initialized = false;
+	SpareRequested = true;
+	return true;
 }
 
-TSize TMemPoolTableEntry::GetPoolCount()
+template<typename TCONFIG>
+bool TMemPool<TCONFIG>::AllocateSparePool(TVMBlock& OutPoolVMBlock)
 {
-	return ((TSize)1 << SubIndexCountShift);
+	//	PoolVMBlockSize only changes for big blocks, which never request spares;
+	if (!OutPoolVMBlock.Allocate(PoolVMBlockSize, ArenaSize, ArenaOwner))
+	{
+		return false;
+	}
+
+	OutPoolVMBlock.Populate();
+	return true;
+}
+
+template<typename TCONFIG>
+void TMemPool<TCONFIG>::AddSparePool(TVMBlock&& PoolVMBlock)
+{
+	TMemPoolHdr* PoolHdr = (TMemPoolHdr*)PoolVMBlock.GetBase();
+	new (PoolHdr) TMemPoolHdr{};
+
+	PoolHdr->MemPool = this;
+	PoolHdr->Untouched = PoolVMBlock.IsUntouched();
+	PoolHdr->PoolVMBlock = move(PoolVMBlock);
+
+	SparePools.PushBack(PoolHdr);
+	++SparePoolCount;
+	SpareRequested = false;
+
+#ifdef MALLOC_SCALED_DEBUG
+	printf("MALLOC: DBG: SPARE POOL: Block size: %llu, Spare pools: %llu\n", BlockSize, SparePoolCount);
+#endif
+}
+
+template<typename TCONFIG>
+void TMemPool<TCONFIG>::CancelSparePool()
+{
+	SpareRequested = false;
+}
+
+template<typename TCONFIG>
+TSize TMemPool<TCONFIG>::Trim(TSize& InOutKeepSize)
+{
+	TSize TrimmedSize = 0;
+
+	auto CachedPoolNode = CachedPools.GetFirst();
+
+	while (CachedPoolNode)
+	{
+		TMemPoolHdr* Pool = *CachedPoolNode->GetElement();
+		CachedPoolNode = CachedPoolNode->GetNext();
+		TSize PoolSize = Pool->PoolVMBlock.GetAllocatedSize();
+
+		if (PoolSize <= InOutKeepSize)
+		{
+			InOutKeepSize -= PoolSize;
+			continue;
+		}
+
+		CachedPools.Delete(Pool);
+		--CachedPoolCount;
+		--PoolCache->Stats.CachedPoolCount;
+		PoolCache->Stats.CachedSize -= PoolSize;
+		++PoolCache->Stats.Evictions;
+
+		ReclaimPool(Pool);
+		TrimmedSize += PoolSize;
+	}
+
+	auto SparePoolNode = SparePools.GetFirst();
+
+	while (SparePoolNode)
+	{
+		TMemPoolHdr* Pool = *SparePoolNode->GetElement();
+		SparePoolNode = SparePoolNode->GetNext();
+		TSize PoolSize = Pool->PoolVMBlock.GetAllocatedSize();
+
+		if (PoolSize <= InOutKeepSize)
+		{
+			InOutKeepSize -= PoolSize;
+			continue;
+		}
+
+		SparePools.Delete(Pool);
+		--SparePoolCount;
+
+		ReclaimPool(Pool);
+		TrimmedSize += PoolSize;
+	}
+
+	auto EmptyPoolNode = PoolBins[POOL_BIN_EMPTY].GetFirst();
+
+	while (EmptyPoolNode)
+	{
+		TMemPoolHdr* Pool = *EmptyPoolNode->GetElement();
+		EmptyPoolNode = EmptyPoolNode->GetNext();
+		TSize PoolSize = Pool->PoolVMBlock.GetAllocatedSize();
+
+		if (PoolSize <= InOutKeepSize)
+		{
+			InOutKeepSize -= PoolSize;
+			continue;
+		}
+
+		DropHeadPool(Pool);
+		DeletePool(Pool, false);
+		TrimmedSize += PoolSize;
+	}
+
+	return TrimmedSize;
+}
+
+template<typename TCONFIG>
+void TMemPool<TCONFIG>::Release()
+{
+	for (TSize Bin = 0; Bin < POOL_BIN_COUNT; ++Bin)
+	{
+		auto NextPoolNode = PoolBins[Bin].GetFirst();
+
+		while (NextPoolNode)
+		{
+			auto PoolToFree = *NextPoolNode->GetElement();
+			NextPoolNode = NextPoolNode->GetNext();
+			DeletePool(PoolToFree);
+		}
+	}
+
+	TrimCachedPools(0);
+
+	while (SparePoolCount)
+	{
+		TMemPoolHdr* Pool = *SparePools.PopFront()->GetElement();
+		TVMBlock PoolVMBlock = move(Pool->PoolVMBlock);
+		--SparePoolCount;
+		PoolVMBlock.Free();
+	}
+
+	SpareRequested = false;
+	memset(HeadPools, 0, sizeof(HeadPools));
+
+#ifdef MALLOC_STATS
+	Stats = {};
+#endif
+}
+
+template<typename TCONFIG>
+void TMemPool<TCONFIG>::FreeUsrBlock(TMemBlockHdr* UsrBlock)
+{
+	if (UsrBlock)
+	{
+		auto Pool = UsrBlock->PoolHdr;
+		TSize UsedSize = UsrBlock->UsedSize;
+
+		++Counters.FreeCount;
+		Counters.Deallocated += UsedSize;
+
+#ifdef MALLOC_STATS
+		Pool->UsrBlockList.Delete(UsrBlock);
+		Pool->Used -= UsrBlock->UsedSize;
+#endif
+		Pool->FreeBlockList.PushBack(UsrBlock);
+		++Pool->FreeBlockCount;
+
+		if (GroupStride)
+		{
+			++Pool->GroupFreeCounts[GetBlockGroup(Pool, UsrBlock)];
+		}
+
+		++TotalFreeBlockCount;
+		UpdatePoolBin(Pool);
+
+		if (Pool->Bin == POOL_BIN_EMPTY)
+		{
+			if (TotalFreeBlockCount > (Pool->FreeBlockCount + (Pool->FreeBlockCount >> 1)))
+			{
+				TSize Head = Pool->Head;
+
+				DropHeadPool(Pool);
+				DeletePool(Pool);
+
+				if (Head)
+				{
+					SetHeadPool(Head - 1, FindNewHeadPool(Head - 1));
+				}
+				return;
+			}
+		}
+
+		//	With several head slots a freed pool is left to FindNewHeadPool, it may belong to another thread;
+		if (!Pool->Head && (!HeadPools[0] || Pool->Bin < HeadPools[0]->Bin) && PoolCache->ThreadPoolCount == 1)
+		{
+			SetHeadPool(0, Pool);
+		}
+
+#ifdef MALLOC_STATS
+		Stats.Used -= UsrBlock->UsedSize;
+		--Stats.UsedBlockCount;
+#endif
+		UsrBlock->UsedSize = 0;
+	}
+}
+
+template<typename TCONFIG>
+TSize TMemPool<TCONFIG>::GetBlockSize()
+{
+	return BlockSize;
+}
+
+template<typename TCONFIG>
+TSize TMemPool<TCONFIG>::GetPoolCount()
+{
+	return PoolCount;
+}
+
+template<typename TCONFIG>
+TSize TMemPool<TCONFIG>::GetCachedPoolCount()
+{
+	return CachedPoolCount;
+}
+
+template<typename TCONFIG>
+TMallocCounters* TMemPool<TCONFIG>::GetCounters()
+{
+	return &Counters;
+}
+
+template<typename TCONFIG>
+void TMemPool<TCONFIG>::GetStats(TSizeClassStats& OutStats)
+{
+	OutStats = {};
+	OutStats.BlockSize = BlockSize;
+	OutStats.PoolCount = PoolCount;
+	OutStats.CachedPoolCount = CachedPoolCount;
+	OutStats.SparePoolCount = SparePoolCount;
+
+	for (TSize Bin = 0; Bin < POOL_BIN_COUNT; ++Bin)
+	{
+		for (auto PoolNode = PoolBins[Bin].GetFirst(); PoolNode; PoolNode = PoolNode->GetNext())
+		{
+			TMemPoolHdr* Pool = *PoolNode->GetElement();
+			OutStats.TotalBlockCount += Pool->TotalBlockCount;
+			OutStats.MappedSize += Pool->PoolVMBlock.GetAllocatedSize();
+		}
+	}
+
+	//	Blocks of the groups detached for purging are free, though out of the free lists until attached back;
+	OutStats.UsedBlockCount = Counters.MallocCount - Counters.FreeCount;
+	OutStats.FreeBlockCount = TotalFreeBlockCount + DetachedBlockCount;
+	OutStats.RequestedSize = Counters.Allocated - Counters.Deallocated;
+	OutStats.ConsumedSize = OutStats.UsedBlockCount * BlockSize;
+	OutStats.MallocCount = Counters.MallocCount;
+	OutStats.FreeCount = Counters.FreeCount;
+}
+
+template<typename TCONFIG>
+inline void TMemPool<TCONFIG>::CountResize(TSize OldSize, TSize NewSize)
+{
+	Counters.Allocated += NewSize;
+	Counters.Deallocated += OldSize;
+}
+
+template<typename TCONFIG>
+TMemPoolHdr* TMemPool<TCONFIG>::GetTop()
+{
+	return HeadPools[0];
+}
+
+template<typename TCONFIG>
+typename TMemPool<TCONFIG>::TMemPoolStats* TMemPool<TCONFIG>::GetPoolStats()
+{
+#ifdef MALLOC_STATS
+	for (TSize Bin = 0; Bin < POOL_BIN_COUNT; ++Bin)
+	{
+		auto FirstPool = PoolBins[Bin].GetFirst();
+
+		for (auto Pool = FirstPool; Pool != nullptr; Pool = Pool->GetNext())
+		{
+			auto PoolHdr = *(Pool->GetElement());
+			auto FirstBlock = PoolHdr->UsrBlockList.GetFirst();
+
+			for (auto Block = FirstBlock; Block != nullptr; Block = Block->GetNext())
+			{
+				auto BlockHdr = *(Block->GetElement());
+
+				if (BlockHdr->UsedSize > Stats.BlockStats.MaxUsedBlock)
+				{
+					Stats.BlockStats.MaxUsedBlock = BlockHdr->UsedSize;
+				}
+
+				else if (BlockHdr->UsedSize < Stats.BlockStats.MinUsedBlock)
+				{
+					Stats.BlockStats.MinUsedBlock = BlockHdr->UsedSize;
+				}
+			}
+		}
+	}
+
+	return &Stats;
+#elif MALLOC_SCALED_DEBUG
+	printf("MALLOC: DBG: Malloc stats are not enabled");
+	return nullptr;
+#else
+	return nullptr;
+#endif
+}
+
+template<typename TCONFIG>
+bool TMemPoolTableEntry<TCONFIG>::Init(TSize BaseIndex, TSize MinBaseBlockSize, TSize MaxBaseBlockSize, TSize PoolBlockSize, TSize SubIndexCountShift, TSize ArenaSize, void* ArenaOwner, TMemPoolCache* PoolCache)
+{
+	if (Initialized)
+	{
+		return false;
+	}
+
+	if (SubIndexCountShift > MaxSubIndexCountShift)
+	{
+		// log error;
+		return false;
+	}
+
+	for (TSize i = 0; i < ((TSize)1 << SubIndexCountShift); ++i)
+	{
+		TSize BlockSize = TMemPoolTable<TCONFIG>::CalculatePoolBlockSize(BaseIndex, i, MinBaseBlockSize, MaxBaseBlockSize, ((TSize)1 << SubIndexCountShift)); 
+		Pools[i].Init(BaseIndex, i, BlockSize, PoolBlockSize, ArenaSize, ArenaOwner, PoolCache);
+	}
+
+	this->SubIndexCountShift = SubIndexCountShift;
+	Initialized = true;
+	return true;
+}
+
+template<typename TCONFIG>
+void TMemPoolTableEntry<TCONFIG>::Release()
+{
+	for (TSize i = 0; i < ((TSize)1 << SubIndexCountShift); ++i)
+	{
+		Pools[i].Release();
+	}
+
+	Initialized = false;
 }
 
-TMemPool* TMemPoolTableEntry::GetPool(TSize PoolIndex)
+template<typename TCONFIG>
+TSize TMemPoolTableEntry<TCONFIG>::GetPoolCount()
+{
+	return ((TSize)1 << SubIndexCountShift);
+}
+
+template<typename TCONFIG>
+TMemPool<TCONFIG>* TMemPoolTableEntry<TCONFIG>::GetPool(TSize PoolIndex)
 {
 	return &Pools[PoolIndex];
 }
 
-bool TMemPoolTable::TMemPoolTableStorage::Init(TSize EntryCount)
+template<typename TCONFIG>
+bool TMemPoolTable<TCONFIG>::TMemPoolTableStorage::Init(TSize EntryCount, void* ArenaOwner)
 {
 	bool Ok = false;
 	TSize DataBlockSize = AlignToUpper(EntrySize * EntryCount, TVMBlock::GetPageSize());
 
-	Ok = DataBlock.Allocate(DataBlockSize);
+	Ok = DataBlock.Allocate(DataBlockSize, 0, ArenaOwner);
 
 	if (!Ok)
 	{
 		return false;
 	}
 
-	FirstEntry = (TMemPoolTableEntry*)DataBlock.GetBase();
+	FirstEntry = (TMemPoolTableEntry<TCONFIG>*)DataBlock.GetBase();
 	LastEntry = FirstEntry + (EntryCount - 1);
 	this->EntryCount = EntryCount;
 
@@ -458,17 +1134,20 @@ bool TMemPoolTable::TMemPoolTableStorage::Init(TSize EntryCount)
 	return Ok;
 }
 
-TMemPoolTableEntry* TMemPoolTable::TMemPoolTableStorage::GetFirst()
+template<typename TCONFIG>
+TMemPoolTableEntry<TCONFIG>* TMemPoolTable<TCONFIG>::TMemPoolTableStorage::GetFirst()
 {
 	return FirstEntry;
 }
 
-TMemPoolTableEntry* TMemPoolTable::TMemPoolTableStorage::GetLast()
+template<typename TCONFIG>
+TMemPoolTableEntry<TCONFIG>* TMemPoolTable<TCONFIG>::TMemPoolTableStorage::GetLast()
 {
 	return LastEntry;
 }
 
-TMemPoolTableEntry* TMemPoolTable::TMemPoolTableStorage::GetEntry(TSize Index)
+template<typename TCONFIG>
+TMemPoolTableEntry<TCONFIG>* TMemPoolTable<TCONFIG>::TMemPoolTableStorage::GetEntry(TSize Index)
 {
 	if (Index < EntryCount)
 		return FirstEntry + Index;
@@ -476,22 +1155,26 @@ TMemPoolTableEntry* TMemPoolTable::TMemPoolTableStorage::GetEntry(TSize Index)
 	return nullptr;
 }
 
-TSize TMemPoolTable::TMemPoolTableStorage::GetEntryIndex(TMemPoolTableEntry* Entry)
+template<typename TCONFIG>
+TSize TMemPoolTable<TCONFIG>::TMemPoolTableStorage::GetEntryIndex(TMemPoolTableEntry<TCONFIG>* Entry)
 {
 	return Entry - FirstEntry;
 }
 
-TSize TMemPoolTable::TMemPoolTableStorage::GetEntryCount()
+template<typename TCONFIG>
+TSize TMemPoolTable<TCONFIG>::TMemPoolTableStorage::GetEntryCount()
 {
 	return EntryCount;
 }
 
-void TMemPoolTable::TMemPoolTableStorage::Free()
+template<typename TCONFIG>
+void TMemPoolTable<TCONFIG>::TMemPoolTableStorage::Free()
 {
 	CreateElementsDefault(FirstEntry, EntryCount);
 }
 
-void TMemPoolTable::TMemPoolTableStorage::Release()
+template<typename TCONFIG>
+void TMemPoolTable<TCONFIG>::TMemPoolTableStorage::Release()
 {
 	DataBlock.Free();
 
@@ -501,52 +1184,77 @@ void TMemPoolTable::TMemPoolTableStorage::Release()
 	DataBlock = {};
 }
 
-TSize TMemPoolTable::GetPoolBlockSize()
+template<typename TCONFIG>
+void TMemPoolTable<TCONFIG>::TMemPoolTableStorage::Drop()
+{
+	FirstEntry = nullptr;
+	LastEntry = nullptr;
+	EntryCount = 0;
+	DataBlock = {};
+}
+
+template<typename TCONFIG>
+TSize TMemPoolTable<TCONFIG>::GetPoolBlockSize()
 {
 	return PoolBlockSize;
 }
 
-TSize TMemPoolTable::GetEntryCount()
+template<typename TCONFIG>
+TSize TMemPoolTable<TCONFIG>::GetEntryCount()
 {
 	return BaseEntries.GetEntryCount();
 }
 
-TSize TMemPoolTable::GetSubIndexCount()
+template<typename TCONFIG>
+TSize TMemPoolTable<TCONFIG>::GetSubIndexCount()
 {
 	return SubIndexCount;
 }
 
-TSize TMemPoolTable::GetSubIndexCountShift()
+template<typename TCONFIG>
+TSize TMemPoolTable<TCONFIG>::GetSubIndexCountShift()
 {
 	return SubIndexCountShift;
 }
 
-TSize TMemPoolTable::GetMinBaseBlockSize()
+template<typename TCONFIG>
+TSize TMemPoolTable<TCONFIG>::GetMinBaseBlockSize()
 {
 	return MinBaseBlockSize;
 }
 
-TSize TMemPoolTable::GetMaxBaseBlockSize()
+template<typename TCONFIG>
+TSize TMemPoolTable<TCONFIG>::GetMaxBaseBlockSize()
 {
 	return MaxBaseBlockSize;
 }
 
-TSize TMemPoolTable::GetMinBaseIndex()
+template<typename TCONFIG>
+TSize TMemPoolTable<TCONFIG>::GetMinBaseIndex()
 {
 	return MinBaseIndex;
 }
 
-TSize TMemPoolTable::GetMaxBaseIndex()
+template<typename TCONFIG>
+TSize TMemPoolTable<TCONFIG>::GetMaxBaseIndex()
 {
 	return MaxBaseIndex;
 }
 
-TMemPoolTableEntry* TMemPoolTable::GetEntry(TSize EntryNum)
+template<typename TCONFIG>
+TMemPoolTableEntry<TCONFIG>* TMemPoolTable<TCONFIG>::GetEntry(TSize EntryNum)
 {
 	return &BaseEntries[EntryNum];
 }
 
-bool TMemPoolTable::Init(TSize MinBaseBlockSize, TSize MaxBaseBlockSize, TSize PoolBlockSize, TSize SubIndexCountShift)
+template<typename TCONFIG>
+TMemPoolCacheStats* TMemPoolTable<TCONFIG>::GetPoolCacheStats()
+{
+	return &PoolCache.Stats;
+}
+
+template<typename TCONFIG>
+bool TMemPoolTable<TCONFIG>::Init(TSize MinBaseBlockSize, TSize MaxBaseBlockSize, TSize PoolBlockSize, TSize SubIndexCountShift, TSize ArenaSize, void* ArenaOwner)
 {
 #ifdef	MALLOC_SCALED_DEBUG
 	if (!IsPow2(MinBaseBlockSize))
@@ -578,13 +1286,19 @@ bool TMemPoolTable::Init(TSize MinBaseBlockSize, TSize MaxBaseBlockSize, TSize P
 
 	TSize EntryCount = CalculateNumOfBaseEntries(MinBaseBlockSize, MaxBaseBlockSize);
 
-	Ok = BaseEntries.Init(EntryCount);
+	Ok = BaseEntries.Init(EntryCount, ArenaOwner);
 
 	if (Ok)
 	{
+		PoolCache = {};
+		PoolCache.HighWater     = TCONFIG::PoolCacheHighWater;
+		PoolCache.LowWater      = TCONFIG::PoolCacheLowWater;
+		PoolCache.MaxCachedSize = TCONFIG::PoolCacheMaxSize;
+		PoolCache.ColorCount    = MALLOC_SCALED_POOL_COLOR_COUNT;
+
 		for (uint32 i = 0; i < EntryCount; ++i)
 		{
-			Ok = BaseEntries[i].Init(i, MinBaseBlockSize, MaxBaseBlockSize, PoolBlockSize, SubIndexCountShift);
+			Ok = BaseEntries[i].Init(i, MinBaseBlockSize, MaxBaseBlockSize, PoolBlockSize, SubIndexCountShift, ArenaSize, ArenaOwner, &PoolCache);
 
 			if (!Ok)
 			{
@@ -600,78 +1314,346 @@ bool TMemPoolTable::Init(TSize MinBaseBlockSize, TSize MaxBaseBlockSize, TSize P
 		this->SubIndexCount    = (TSize)1 << SubIndexCountShift;
 		this->SubIndexCountShift = SubIndexCountShift;
 
+		InitPoolLookup();
+
 		return true;
 	}
 
 	return false;
 }
 
-void TMemPoolTable::Release()
+template<typename TCONFIG>
+void TMemPoolTable<TCONFIG>::GetCounters(TMallocCounters& OutCounters)
 {
+	OutCounters = {};
 	TSize EntryCount = BaseEntries.GetEntryCount();
 
-	for (uint32 i = 0; i < EntryCount; ++i)
+	for (TSize i = 0; i < EntryCount; ++i)
 	{
-		BaseEntries[i].Release();
-	}
+		TMemPoolTableEntry<TCONFIG>& Entry = BaseEntries[i];
 
-	BaseEntries.Release();
+		for (TSize j = 0; j < Entry.GetPoolCount(); ++j)
+		{
+			TMallocCounters* Counters = Entry.GetPool(j)->GetCounters();
+			OutCounters.MallocCount += Counters->MallocCount;
+			OutCounters.FreeCount   += Counters->FreeCount;
+			OutCounters.Allocated   += Counters->Allocated;
+			OutCounters.Deallocated += Counters->Deallocated;
+		}
+	}
 }
 
-void TMemPoolTable::UpdateStats()
+template<typename TCONFIG>
+TSize TMemPoolTable<TCONFIG>::GetSizeClassCounters(TSizeClassCounters* OutCounters, TSize MaxCount)
 {
-#ifdef MALLOC_STATS
+	TSize ClassCount = 0;
 	TSize EntryCount = BaseEntries.GetEntryCount();
 
 	for (TSize i = 0; i < EntryCount; ++i)
 	{
-		TSize PoolCount = BaseEntries[i].GetPoolCount();
-		for (TSize j = 0; j < PoolCount; ++j)
-		{
-			TMemPool* Pool = BaseEntries[i].GetPool(j);
-			TMemPool::TMemPoolStats* PoolStats = Pool->GetPoolStats();
-
-			Stats.Used += PoolStats->Used;
-			Stats.UsedBlockCount += PoolStats->UsedBlockCount;
-			Stats.TotalBlockCount += PoolStats->TotalBlockCount;
-			Stats.AllocatedSize += PoolStats->AllocatedSize;
-			
-			if (PoolStats->PeakUsed > Stats.PeakUsed)
-			{
-				Stats.PeakUsed = PoolStats->PeakUsed;
-			}
+		TMemPoolTableEntry<TCONFIG>& Entry = BaseEntries[i];
 
-			if (PoolStats->PeakUsedBlockCount > Stats.PeakUsedBlockCount)
-			{
-				Stats.PeakUsedBlockCount = PoolStats->PeakUsedBlockCount;
-			}
+		for (TSize j = 0; j < Entry.GetPoolCount() && ClassCount < MaxCount; ++j)
+		{
+			TMemPool<TCONFIG>* Pool = Entry.GetPool(j);
+			OutCounters[ClassCount].BlockSize = Pool->GetBlockSize();
+			OutCounters[ClassCount].Counters = *Pool->GetCounters();
+			++ClassCount;
 		}
 	}
 
-#elif MALLOC_SCALED_DEBUG
-	printf("MALLOC: DBG: Malloc stats are not enabled");
-#endif
+	return ClassCount;
 }
 
-
-
-void* TMallocScaled::MallocInternal(TSize Size, TSize Alignment)
+template<typename TCONFIG>
+TSize TMemPoolTable<TCONFIG>::GetSizeClassStats(TSizeClassStats* OutStats, TSize MaxCount)
 {
-#ifdef MALLOC_SCALED_DEBUG
-	printf("\nMALLOC: DBG: ALLOCATE MEM BLOCK: Size: %llu, Alignment: %llu\n", Size, Alignment);
-#endif
-
-#ifdef MALLOC_STATS
-	++MallocStats.RequestStats.MallocRequests;
+	TSize ClassCount = 0;
+	TSize EntryCount = BaseEntries.GetEntryCount();
 
-	if (Size > MallocStats.RequestVals.MaxAllocRequestSize)
+	for (TSize i = 0; i < EntryCount; ++i)
 	{
-		MallocStats.RequestVals.MaxAllocRequestSize = Size;
-	}
+		TMemPoolTableEntry<TCONFIG>& Entry = BaseEntries[i];
 
-	if (Size < MallocStats.RequestVals.MinAllocRequestSize)
-	{
-		MallocStats.RequestVals.MinAllocRequestSize = Size;
+		for (TSize j = 0; j < Entry.GetPoolCount() && ClassCount < MaxCount; ++j)
+		{
+			Entry.GetPool(j)->GetStats(OutStats[ClassCount++]);
+		}
+	}
+
+	return ClassCount;
+}
+
+template<typename TCONFIG>
+TSize TMemPoolTable<TCONFIG>::Trim(TSize& InOutKeepSize)
+{
+	TSize TrimmedSize = 0;
+	TSize EntryCount = BaseEntries.GetEntryCount();
+
+	for (TSize i = 0; i < EntryCount; ++i)
+	{
+		TMemPoolTableEntry<TCONFIG>& Entry = BaseEntries[i];
+
+		for (TSize j = 0; j < Entry.GetPoolCount(); ++j)
+		{
+			TrimmedSize += Entry.GetPool(j)->Trim(InOutKeepSize);
+		}
+	}
+
+	return TrimmedSize;
+}
+
+template<typename TCONFIG>
+TSize TMemPoolTable<TCONFIG>::DetachFreeGroups(TMemPoolPageRange* OutRanges, TSize MaxRangeCount, TSize& InOutKeepSize)
+{
+	TSize RangeCount = 0;
+	TSize EntryCount = BaseEntries.GetEntryCount();
+
+	for (TSize i = 0; i < EntryCount && RangeCount < MaxRangeCount; ++i)
+	{
+		TMemPoolTableEntry<TCONFIG>& Entry = BaseEntries[i];
+
+		for (TSize j = 0; j < Entry.GetPoolCount() && RangeCount < MaxRangeCount; ++j)
+		{
+			RangeCount += Entry.GetPool(j)->DetachFreeGroups(OutRanges + RangeCount, MaxRangeCount - RangeCount, InOutKeepSize);
+		}
+	}
+
+	return RangeCount;
+}
+
+template<typename TCONFIG>
+TSize TMemPoolTable<TCONFIG>::GetReclaimPoolCount()
+{
+	return PoolCache.ReclaimPoolCount;
+}
+
+template<typename TCONFIG>
+void TMemPoolTable<TCONFIG>::TakeReclaimPools(TMemPoolList& OutPools)
+{
+	OutPools.SwapLists(PoolCache.ReclaimPools);
+	PoolCache.ReclaimPoolCount = 0;
+}
+
+template<typename TCONFIG>
+TSize TMemPoolTable<TCONFIG>::FreePools(TMemPoolList& Pools)
+{
+	TSize FreedSize = 0;
+
+	while (auto PoolNode = Pools.PopFront())
+	{
+		TVMBlock PoolVMBlock = move((*PoolNode->GetElement())->PoolVMBlock);
+		FreedSize += PoolVMBlock.GetAllocatedSize();
+		PoolVMBlock.Free();
+	}
+
+	return FreedSize;
+}
+
+template<typename TCONFIG>
+void TMemPoolTable<TCONFIG>::SetPoolCacheLimits(TSize HighWater, TSize LowWater, TSize MaxCachedSize)
+{
+	PoolCache.HighWater     = HighWater;
+	PoolCache.LowWater      = LowWater;
+	PoolCache.MaxCachedSize = MaxCachedSize;
+}
+
+template<typename TCONFIG>
+void TMemPoolTable<TCONFIG>::SetPoolColorCount(TSize ColorCount)
+{
+	PoolCache.ColorCount = ColorCount ? ColorCount : 1;
+}
+
+template<typename TCONFIG>
+void TMemPoolTable<TCONFIG>::SetThreadPoolCount(TSize ThreadPoolCount)
+{
+	PoolCache.ThreadPoolCount = ThreadPoolCount ? ThreadPoolCount : 1;
+}
+
+template<typename TCONFIG>
+bool TMemPoolTable<TCONFIG>::TakeHeadSlot(TSize& OutSlot)
+{
+	for (TSize Slot = 0; Slot < PoolCache.ThreadPoolCount; ++Slot)
+	{
+		if (!(PoolCache.HeldHeadSlots & ((uint64)1 << Slot)))
+		{
+			PoolCache.HeldHeadSlots |= (uint64)1 << Slot;
+			OutSlot = Slot;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+template<typename TCONFIG>
+void TMemPoolTable<TCONFIG>::GiveBackHeadSlot(TSize Slot)
+{
+	PoolCache.HeldHeadSlots &= ~((uint64)1 << Slot);
+
+	//	The heads of the slot are left to the other threads until a new thread takes it;
+	TSize EntryCount = BaseEntries.GetEntryCount();
+
+	for (TSize i = 0; i < EntryCount; ++i)
+	{
+		TMemPoolTableEntry<TCONFIG>& Entry = BaseEntries[i];
+
+		for (TSize j = 0; j < Entry.GetPoolCount(); ++j)
+		{
+			Entry.GetPool(j)->DropHeadSlot(Slot);
+		}
+	}
+}
+
+template<typename TCONFIG>
+void TMemPoolTable<TCONFIG>::Release()
+{
+	TSize EntryCount = BaseEntries.GetEntryCount();
+
+	for (uint32 i = 0; i < EntryCount; ++i)
+	{
+		BaseEntries[i].Release();
+	}
+
+	FreePools(PoolCache.ReclaimPools);
+	BaseEntries.Release();
+	PoolCache = {};
+
+	memset(PoolLookup, 0, sizeof(PoolLookup));
+}
+
+template<typename TCONFIG>
+void TMemPoolTable<TCONFIG>::Drop()
+{
+	BaseEntries.Drop();
+	PoolCache = {};
+
+	memset(PoolLookup, 0, sizeof(PoolLookup));
+}
+
+template<typename TCONFIG>
+void TMemPoolTable<TCONFIG>::UpdateStats()
+{
+#ifdef MALLOC_STATS
+	TSize EntryCount = BaseEntries.GetEntryCount();
+
+	for (TSize i = 0; i < EntryCount; ++i)
+	{
+		TSize PoolCount = BaseEntries[i].GetPoolCount();
+		for (TSize j = 0; j < PoolCount; ++j)
+		{
+			TMemPool<TCONFIG>* Pool = BaseEntries[i].GetPool(j);
+			typename TMemPool<TCONFIG>::TMemPoolStats* PoolStats = Pool->GetPoolStats();
+
+			Stats.Used += PoolStats->Used;
+			Stats.UsedBlockCount += PoolStats->UsedBlockCount;
+			Stats.TotalBlockCount += PoolStats->TotalBlockCount;
+			Stats.AllocatedSize += PoolStats->AllocatedSize;
+			
+			if (PoolStats->PeakUsed > Stats.PeakUsed)
+			{
+				Stats.PeakUsed = PoolStats->PeakUsed;
+			}
+
+			if (PoolStats->PeakUsedBlockCount > Stats.PeakUsedBlockCount)
+			{
+				Stats.PeakUsedBlockCount = PoolStats->PeakUsedBlockCount;
+			}
+		}
+	}
+
+#elif MALLOC_SCALED_DEBUG
+	printf("MALLOC: DBG: Malloc stats are not enabled");
+#endif
+}
+
+
+
+template<typename TCONFIG>
+inline TSize TMallocScaled<TCONFIG>::GetThreadIndex()
+{
+	static std::atomic<TSize> NextThreadIndex{ 0 };
+	static thread_local TSize ThreadIndex = NextThreadIndex.fetch_add(1, std::memory_order_relaxed);
+
+	return ThreadIndex;
+}
+
+template<typename TCONFIG>
+inline TSize TMallocScaled<TCONFIG>::GetHeadSlot()
+{
+	TThreadHeadSlots& ThreadSlots = GThreadHeadSlots;
+	TThreadHeadSlots::TEntry* Entry = nullptr;
+
+	for (TSize i = 0; i < ThreadSlots.EntryCount; ++i)
+	{
+		if (ThreadSlots.Entries[i].Heap == this)
+		{
+			if (ThreadSlots.Entries[i].Epoch == HeadSlotEpoch)
+			{
+				return ThreadSlots.Entries[i].Slot;
+			}
+
+			//	Taken before the heap was shut down, the slot is free already;
+			Entry = &ThreadSlots.Entries[i];
+			break;
+		}
+	}
+
+	TSize Slot = 0;
+
+	if (!Entry && ThreadSlots.EntryCount < MALLOC_SCALED_THREAD_HEAD_SLOT_COUNT)
+	{
+		Entry = &ThreadSlots.Entries[ThreadSlots.EntryCount];
+	}
+
+	if (!Entry || !PoolTable.TakeHeadSlot(Slot))
+	{
+		return GetThreadIndex() & (Conf.ThreadPoolCount - 1);
+	}
+
+	if (Entry == &ThreadSlots.Entries[ThreadSlots.EntryCount])
+	{
+		++ThreadSlots.EntryCount;
+	}
+
+	*Entry = TThreadHeadSlots::TEntry{ this, HeadSlotEpoch, Slot, &TMallocScaled::ReleaseHeadSlot };
+
+	return Slot;
+}
+
+template<typename TCONFIG>
+void TMallocScaled<TCONFIG>::ReleaseHeadSlot(void* Heap, uint64 Epoch, TSize Slot)
+{
+	TMallocScaled* Malloc = (TMallocScaled*)Heap;
+
+	Malloc->Guard.Lock();
+
+	if (Malloc->HeadSlotEpoch == Epoch)
+	{
+		Malloc->PoolTable.GiveBackHeadSlot(Slot);
+	}
+
+	Malloc->Guard.Unlock();
+}
+
+template<typename TCONFIG>
+void* TMallocScaled<TCONFIG>::MallocInternal(TSize Size, TSize Alignment, bool& OutUntouched)
+{
+#ifdef MALLOC_SCALED_DEBUG
+	printf("\nMALLOC: DBG: ALLOCATE MEM BLOCK: Size: %llu, Alignment: %llu\n", Size, Alignment);
+#endif
+
+#ifdef MALLOC_STATS
+	++MallocStats.RequestStats.MallocRequests;
+
+	if (Size > MallocStats.RequestVals.MaxAllocRequestSize)
+	{
+		MallocStats.RequestVals.MaxAllocRequestSize = Size;
+	}
+
+	if (Size < MallocStats.RequestVals.MinAllocRequestSize)
+	{
+		MallocStats.RequestVals.MinAllocRequestSize = Size;
 	}
 #endif
 
@@ -693,38 +1675,35 @@ void* TMallocScaled::MallocInternal(TSize Size, TSize Alignment)
 		TSize AdjustedBlockSize = Size + (Size >> MALLOC_SCALED_ALLOCATION_ADJUSTMENT);
 		AdjustedBlockSize = AlignToUpper(AdjustedBlockSize + Alignment, MALLOC_SCALED_DEFAULT_ALIGNMENT);
 
-		TSize BaseIndex = 0;
-		bool Ok = TMemPoolTable::GetBaseIndex(AdjustedBlockSize, PoolTable.GetMinBaseIndex(), PoolTable.GetMaxBaseIndex(), BaseIndex);
+		TMemPool<TCONFIG>* Pool = PoolTable.GetPool(AdjustedBlockSize);
 
-		if (Ok)
+		if (Pool)
 		{
-			TSize PoolIdx = TMemPoolTable::GetPoolIndex(AdjustedBlockSize, BaseIndex, PoolTable.GetMinBaseIndex(), PoolTable.GetSubIndexCountShift());
-			TMemPoolTableEntry* BaseEntry = PoolTable.GetEntry(BaseIndex);
-
-			TMemPool* Pool = BaseEntry->GetPool(PoolIdx);
-
 			//TIMER
 			//FUNC_TIME(TMemBlockHdr * FreeBlock = Pool->GetFreeBlock(Size));
 			//printf("MALLOC: DBG: Last find free block time: %f ns\n", std::chrono::duration<float64, std::nano>(Ts.GetLastTime()).count());
 
-			TMemBlockHdr* FreeBlock = Pool->GetFreeBlock(Size);
-	
+			TSize HeadSlot = Conf.ThreadPoolCount > 1 ? GetHeadSlot() : 0;
+			TMemBlockHdr* FreeBlock = Pool->GetFreeBlock(Size, OutUntouched, HeadSlot);
+
+			if (BackgroundRunning && Pool->RequestSparePool())
+			{
+				RequestSparePool(Pool);
+			}
 
 			if (FreeBlock)
 			{
-				UsrBlockPtr = FreeBlock + 1;
-				void* AlignedPtr = AlignToUpper(UsrBlockPtr, Alignment);
-				if (AlignedPtr == UsrBlockPtr)
-				{
-					UsrBlockPtr = (TMemBlockHdrOffset*)AlignedPtr + 1;
-					TMemBlockHdrOffset* HdrOffset = (TMemBlockHdrOffset*)AlignedPtr;
-					HdrOffset->BlockHdr = FreeBlock;
-				}
-				else
+				//	Block offset header always precedes the aligned user pointer;
+				UsrBlockPtr = AlignToUpper((TMemBlockHdrOffset*)(FreeBlock + 1) + 1, Alignment);
+				TMemBlockHdrOffset* HdrOffset = (TMemBlockHdrOffset*)UsrBlockPtr - 1;
+				HdrOffset->BlockHdr = FreeBlock;
+
+				++GThreadMallocCounters.MallocCount;
+				GThreadMallocCounters.Allocated += Size;
+
+				if (Conf.ProfSampleInterval && Profiler.ShouldSample(Size))
 				{
-					UsrBlockPtr = AlignedPtr;
-					TMemBlockHdrOffset* HdrOffset = (TMemBlockHdrOffset*)AlignedPtr - 1;
-					HdrOffset->BlockHdr = FreeBlock;
+					Profiler.RecordAlloc(UsrBlockPtr, Size);
 				}
 			}
 		}
@@ -767,7 +1746,8 @@ void* TMallocScaled::MallocInternal(TSize Size, TSize Alignment)
 	return UsrBlockPtr;
 }
 
-void* TMallocScaled::ReallocInternal(void* Addr, TSize NewSize, TSize NewAlignment)
+template<typename TCONFIG>
+void* TMallocScaled<TCONFIG>::ReallocInternal(void* Addr, TSize NewSize, TSize NewAlignment)
 {
 	TSize OldSize = 0; 
 #ifdef MALLOC_SCALED_DEBUG
@@ -806,12 +1786,17 @@ void* TMallocScaled::ReallocInternal(void* Addr, TSize NewSize, TSize NewAlignme
 
 		if (AdjustedNewSize > Block->BlockSize || AdjustedNewSize < (Block->BlockSize >> MALLOC_SCALED_REALLOCATION_ADJUSTMENT))
 		{
-			NewPtr = MallocInternal(NewSize, NewAlignment);
+			bool Untouched = false;
+			NewPtr = MallocInternal(NewSize, NewAlignment, Untouched);
 		}
 		else
 		{
 			OldSize = Block->UsedSize;
 			Block->UsedSize = NewSize;
+
+			((TMemPool<TCONFIG>*)Block->PoolHdr->MemPool)->CountResize(OldSize, NewSize);
+			GThreadMallocCounters.Allocated += NewSize;
+			GThreadMallocCounters.Deallocated += OldSize;
 			
 			void* AlignedPtr = AlignToUpper(Addr, NewAlignment);
 			if (AlignedPtr == Addr)
@@ -824,6 +1809,11 @@ void* TMallocScaled::ReallocInternal(void* Addr, TSize NewSize, TSize NewAlignme
 				TMemBlockHdrOffset* HdrOffset = (TMemBlockHdrOffset*)AlignedPtr - 1;
 				HdrOffset->BlockHdr = Block;
 			}
+
+			if (Conf.ProfSampleInterval)
+			{
+				Profiler.RecordResize(Addr, UsrBlockPtr, NewSize);
+			}
 		}
 
 		if (NewPtr)
@@ -879,7 +1869,8 @@ void* TMallocScaled::ReallocInternal(void* Addr, TSize NewSize, TSize NewAlignme
 	return UsrBlockPtr;
 }
 
-void TMallocScaled::FreeInternal(void* Addr)
+template<typename TCONFIG>
+void TMallocScaled<TCONFIG>::FreeInternal(void* Addr)
 {
 #ifdef MALLOC_SCALED_DEBUG
 	TSize Size0 = GetSizeInternal(Addr);
@@ -906,14 +1897,26 @@ void TMallocScaled::FreeInternal(void* Addr)
 	Timer.Start();
 #endif
 
+#if defined(MALLOC_SCALED_DEBUG) || defined(MALLOC_STATS)
 	bool Ok = true;
+#endif
 	if (Addr)
 	{
 		TMemBlockHdrOffset* Offset = (TMemBlockHdrOffset*)(Addr);
 		--Offset;
 		TMemBlockHdr* Block = Offset->BlockHdr;
 		TMemPoolHdr* PoolHdr = Block->PoolHdr;
-		PoolHdr->MemPool->FreeUsrBlock(Block);	
+		TMemPool<TCONFIG>* MemPool = (TMemPool<TCONFIG>*)PoolHdr->MemPool;
+
+		++GThreadMallocCounters.FreeCount;
+		GThreadMallocCounters.Deallocated += Block->UsedSize;
+
+		if (Conf.ProfSampleInterval)
+		{
+			Profiler.RecordFree(Addr);
+		}
+
+		MemPool->FreeUsrBlock(Block);
 
 #ifdef MALLOC_TIME_STATS
 		Timer.Stop();
@@ -947,7 +1950,8 @@ void TMallocScaled::FreeInternal(void* Addr)
 
 }
 
-TSize TMallocScaled::GetSizeInternal(void* Addr)
+template<typename TCONFIG>
+TSize TMallocScaled<TCONFIG>::GetSizeInternal(void* Addr)
 {
 	TSize UsedSize = 0;
 
@@ -962,30 +1966,88 @@ TSize TMallocScaled::GetSizeInternal(void* Addr)
 	return UsedSize;
 }
 
-void* TMallocScaled::Malloc(TSize Size, TSize Alignment)
+template<typename TCONFIG>
+void* TMallocScaled<TCONFIG>::Malloc(TSize Size, TSize Alignment)
+{
+	bool Untouched = false;
+
+	Guard.Lock();
+	void* FreeBlock = MallocInternal(Size, Alignment, Untouched);
+	bool Flush = Tracer.IsEnabled() && Tracer.Record(ALLOC_TRACE_MALLOC, nullptr, FreeBlock, Size, Alignment);
+	Guard.Unlock();
+
+	if (Flush)
+	{
+		Tracer.FlushPending();
+	}
+
+	return FreeBlock;
+}
+
+template<typename TCONFIG>
+void* TMallocScaled<TCONFIG>::Calloc(TSize Count, TSize Size, TSize Alignment)
 {
+	if (Size && Count > std::numeric_limits<TSize>::max() / Size)
+	{
+		return nullptr;
+	}
+
+	TSize TotalSize = Count * Size;
+	bool Untouched = false;
+
 	Guard.Lock();
-	void* FreeBlock = MallocInternal(Size, Alignment);
+	void* FreeBlock = MallocInternal(TotalSize, Alignment, Untouched);
+	bool Flush = Tracer.IsEnabled() && Tracer.Record(ALLOC_TRACE_CALLOC, nullptr, FreeBlock, TotalSize, Alignment);
 	Guard.Unlock();
+
+	if (Flush)
+	{
+		Tracer.FlushPending();
+	}
+
+	//	Blocks carved from never touched pages are zero already, recycled ones are cleared out of the lock;
+	if (FreeBlock && !Untouched)
+	{
+		ZeroMemoryBlock(FreeBlock, TotalSize);
+	}
+
 	return FreeBlock;
 }
 
-void* TMallocScaled::Realloc(void* Addr, TSize Size, TSize Alignment)
+template<typename TCONFIG>
+void* TMallocScaled<TCONFIG>::Realloc(void* Addr, TSize Size, TSize Alignment)
 {
 	Guard.Lock();
 	void* ReallocatedBlock = ReallocInternal(Addr, Size, Alignment);
+	bool Flush = Tracer.IsEnabled() && Tracer.Record(ALLOC_TRACE_REALLOC, Addr, ReallocatedBlock, Size, Alignment);
+	ReclaimPending();
 	Guard.Unlock();
+
+	if (Flush)
+	{
+		Tracer.FlushPending();
+	}
+
 	return ReallocatedBlock;
 }
 
-void  TMallocScaled::Free(void* Addr)
+template<typename TCONFIG>
+void  TMallocScaled<TCONFIG>::Free(void* Addr)
 {
 	Guard.Lock();
 	FreeInternal(Addr);
+	bool Flush = Tracer.IsEnabled() && Tracer.Record(ALLOC_TRACE_FREE, Addr, nullptr, 0, 0);
+	ReclaimPending();
 	Guard.Unlock();
+
+	if (Flush)
+	{
+		Tracer.FlushPending();
+	}
 }
 
-TSize TMallocScaled::GetSize(void* Addr)
+template<typename TCONFIG>
+TSize TMallocScaled<TCONFIG>::GetSize(void* Addr)
 {
 	Guard.Lock();
 	TSize UsedSize = GetSizeInternal(Addr);
@@ -993,7 +2055,8 @@ TSize TMallocScaled::GetSize(void* Addr)
 	return UsedSize;
 }
 
-void TMallocScaled::DebugInit(TSize MinBaseBlockSize, TSize MaxBaseBlockSize, TSize PoolBlockSize, uint32 SubIndexCount)
+template<typename TCONFIG>
+void TMallocScaled<TCONFIG>::DebugInit(TSize MinBaseBlockSize, TSize MaxBaseBlockSize, TSize PoolBlockSize, uint32 SubIndexCount)
 {
 #ifdef MALLOC_SCALED_DEBUG
 	bool Ok = false;
@@ -1022,54 +2085,664 @@ void TMallocScaled::DebugInit(TSize MinBaseBlockSize, TSize MaxBaseBlockSize, TS
 #endif
 }
 
-bool TMallocScaled::Init()
+template<typename TCONFIG>
+bool TMallocScaled<TCONFIG>::Init()
 {
-	bool Ok = false;
-
-	if (!Initialized)
+	if (Initialized)
 	{
-		Ok = TVMBlock::Init();
 #ifdef MALLOC_SCALED_DEBUG
-		printf("MALLOC: DBG: Initializing memory allocator...\n");
+		printf("MALLOC: DBG: Memory allocator is initialized already...\n");
 #endif
-		if (Ok)
-		{
-			Ok = PoolTable.Init(MALLOC_SCALED_MIN_BASE_BLOCK_SIZE,
-				MALLOC_SCALED_MAX_BASE_BLOCK_SIZE,
-				MALLOC_SCALED_POOL_BLOCK_SIZE,
-				Log2_64(MALLOC_SCALED_SUBINDEX_COUNT));
-		
-			if (Ok)
-			{
-				Initialized = true;
-				return true;
-			}
-		}
+		return false;
 	}
-	else
+
+	TMallocConf EnvConf{};
+
+	if (!ParseMallocConf(GetMallocConfEnv(), EnvConf))
 	{
 #ifdef MALLOC_SCALED_DEBUG
-		printf("MALLOC: DBG: Memory allocator is initialized already...\n");
+		printf("MALLOC: DBG: %s contains invalid options\n", MALLOC_SCALED_CONF_ENV);
 #endif
 	}
 
-	return false;
-}
+	ArenaOwner = nullptr;
+	InitConf(EnvConf);
 
-bool TMallocScaled::IsInitialized()
-{
-	return Initialized;
-}
+	if (!InitInternal())
+	{
+		return false;
+	}
 
+	const char* TracePath = GetAllocTraceEnv();
 
-void TMallocScaled::Shutdown()
-{
+	if (TracePath && !StartTrace(TracePath))
+	{
 #ifdef MALLOC_SCALED_DEBUG
-	printf("MALLOC: DBG: Destroying memory allocator\n");
+		printf("MALLOC: DBG: Allocation trace is not started: %s\n", TracePath);
 #endif
+	}
 
-	PoolTable.Release();
-	TVMBlock::Release();
+	return true;
+}
+
+template<typename TCONFIG>
+bool TMallocScaled<TCONFIG>::InitHeap(const TMallocConf& HeapConf)
+{
+	if (Initialized)
+	{
+		return false;
+	}
+
+	ArenaOwner = this;
+	InitConf(HeapConf);
+
+	return InitInternal();
+}
+
+template<typename TCONFIG>
+bool TMallocScaled<TCONFIG>::InitInternal()
+{
+	bool Ok = TVMBlock::Init(Conf.ArenaPageSize, Conf.ArenaSize);
+#ifdef MALLOC_SCALED_DEBUG
+	printf("MALLOC: DBG: Initializing memory allocator...\n");
+#endif
+	if (Ok)
+	{
+		Conf.ArenaPageSize = TVMBlock::GetGranularity();
+
+		Ok = PoolTable.Init(Conf.MinBaseBlockSize,
+			Conf.MaxBaseBlockSize,
+			Conf.PoolBlockSize,
+			FloorLog2(Conf.SubIndexCount),
+			Conf.ArenaSize,
+			ArenaOwner);
+	
+		if (Ok)
+		{
+			PoolTable.SetPoolCacheLimits(Conf.PoolCacheHighWater, Conf.PoolCacheLowWater, Conf.PoolCacheMaxSize);
+			PoolTable.SetPoolColorCount(Conf.PoolColorCount);
+			PoolTable.SetThreadPoolCount(Conf.ThreadPoolCount);
+
+			Guard.Lock();
+			++HeadSlotEpoch;
+			Guard.Unlock();
+
+			if (Conf.ProfSampleInterval && !Profiler.Init(Conf.ProfSampleInterval))
+			{
+#ifdef MALLOC_SCALED_DEBUG
+				printf("MALLOC: DBG: Heap profiler is not started\n");
+#endif
+				Conf.ProfSampleInterval = 0;
+			}
+
+			if (Conf.StatsPrint)
+			{
+				char ConfBuf[MALLOC_CONF_MAX_LENGTH];
+				FormatMallocConf(Conf, ConfBuf, sizeof(ConfBuf));
+				printf("MALLOC: %s:\n%s", ArenaOwner ? "HEAP" : MALLOC_SCALED_CONF_ENV, ConfBuf);
+			}
+
+			Initialized = true;
+
+			for (TSize i = 0; i < Conf.PrewarmCount; ++i)
+			{
+				PrewarmInternal(Conf.Prewarm[i].Size, Conf.Prewarm[i].Count, MALLOC_SCALED_DEFAULT_ALIGNMENT);
+			}
+
+			//	The soft limit and the pressure monitor are watched by the background thread;
+			if (Conf.BackgroundThread || Conf.SoftLimit || Conf.PressureMonitor)
+			{
+				StartBackgroundThread();
+			}
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
+template<typename TCONFIG>
+void TMallocScaled<TCONFIG>::StartBackgroundThread()
+{
+	if (BackgroundThread.joinable())
+	{
+		return;
+	}
+
+	BackgroundStop = false;
+	SpareRequestCount = 0;
+	PressureBackoff = 0;
+	PressureSkips = 0;
+	BackgroundThread = std::thread(&TMallocScaled::BackgroundThreadLoop, this);
+	BackgroundRunning = true;
+
+#ifdef MALLOC_SCALED_DEBUG
+	printf("MALLOC: DBG: Background thread is started\n");
+#endif
+}
+
+template<typename TCONFIG>
+void TMallocScaled<TCONFIG>::StopBackgroundThread()
+{
+	if (!BackgroundThread.joinable())
+	{
+		return;
+	}
+
+	//	The thread is gone and its wait may never end, only the handle is given back;
+	if (GMallocProcessExiting)
+	{
+		BackgroundRunning = false;
+		BackgroundThread.detach();
+		return;
+	}
+
+	Guard.Lock();
+	BackgroundRunning = false;
+	Guard.Unlock();
+
+	BackgroundGuard.lock();
+	BackgroundStop = true;
+	BackgroundGuard.unlock();
+	BackgroundWakeup.notify_one();
+
+	BackgroundThread.join();
+
+	//	Requests left in the queue are dropped, their pools may request again later.
+	//	Pools waiting for reclaim stay queued for Trim or Shutdown;
+	Guard.Lock();
+
+	for (TSize i = 0; i < SpareRequestCount; ++i)
+	{
+		SpareRequests[i]->CancelSparePool();
+	}
+
+	SpareRequestCount = 0;
+	ReclaimQueued = false;
+	ReclaimRequested = false;
+	Guard.Unlock();
+
+#ifdef MALLOC_SCALED_DEBUG
+	printf("MALLOC: DBG: Background thread is stopped\n");
+#endif
+}
+
+template<typename TCONFIG>
+void TMallocScaled<TCONFIG>::RequestSparePool(TMemPool<TCONFIG>* Pool)
+{
+	BackgroundGuard.lock();
+	bool Queued = SpareRequestCount < MALLOC_SCALED_SPARE_REQUEST_COUNT;
+
+	if (Queued)
+	{
+		SpareRequests[SpareRequestCount++] = Pool;
+	}
+
+	BackgroundGuard.unlock();
+
+	if (Queued)
+	{
+		BackgroundWakeup.notify_one();
+	}
+	else
+	{
+		Pool->CancelSparePool();
+	}
+}
+
+template<typename TCONFIG>
+void TMallocScaled<TCONFIG>::ReclaimPending()
+{
+	if (BackgroundRunning && !ReclaimQueued && PoolTable.GetReclaimPoolCount())
+	{
+		ReclaimQueued = true;
+
+		BackgroundGuard.lock();
+		ReclaimRequested = true;
+		BackgroundGuard.unlock();
+		BackgroundWakeup.notify_one();
+	}
+}
+
+template<typename TCONFIG>
+TSize TMallocScaled<TCONFIG>::ReclaimPools()
+{
+	TMemPoolList Pools;
+
+	Guard.Lock();
+	PoolTable.TakeReclaimPools(Pools);
+	ReclaimQueued = false;
+	Guard.Unlock();
+
+	//	Unmapping takes the page allocator lock only, allocations go on meanwhile;
+	TSize FreedSize = TMemPoolTable<TCONFIG>::FreePools(Pools);
+
+#ifdef MALLOC_SCALED_DEBUG
+	printf("MALLOC: DBG: RECLAIM: Freed: %llu Bytes\n", FreedSize);
+#endif
+
+	return FreedSize;
+}
+
+template<typename TCONFIG>
+TSize TMallocScaled<TCONFIG>::ReclaimPoolPages(TSize KeepSize)
+{
+	TMemPoolPageRange Ranges[MALLOC_SCALED_PAGE_RECLAIM_BATCH_COUNT];
+	TSize RangeCount = 0;
+	TSize PurgedSize = 0;
+
+	do
+	{
+		//	Every batch walks the pools from the first one, so the same groups are kept each time;
+		TSize BatchKeepSize = KeepSize;
+
+		Guard.Lock();
+		RangeCount = Initialized ? PoolTable.DetachFreeGroups(Ranges, MALLOC_SCALED_PAGE_RECLAIM_BATCH_COUNT, BatchKeepSize) : 0;
+		Guard.Unlock();
+
+		//	Detached groups belong to no one until attached back, their pools cannot be deleted meanwhile;
+		for (TSize i = 0; i < RangeCount; ++i)
+		{
+			if (Ranges[i].Pool->PoolVMBlock.Purge(Ranges[i].Begin, Ranges[i].Size))
+			{
+				PurgedSize += Ranges[i].Size;
+			}
+		}
+
+		Guard.Lock();
+
+		for (TSize i = 0; i < RangeCount; ++i)
+		{
+			((TMemPool<TCONFIG>*)Ranges[i].Pool->MemPool)->AttachPurgedGroup(Ranges[i]);
+		}
+
+		Guard.Unlock();
+	}
+	while (RangeCount == MALLOC_SCALED_PAGE_RECLAIM_BATCH_COUNT);
+
+#ifdef MALLOC_SCALED_DEBUG
+	if (PurgedSize)
+	{
+		printf("MALLOC: DBG: POOL PAGES PURGED: %llu Bytes\n", PurgedSize);
+	}
+#endif
+
+	return PurgedSize;
+}
+
+template<typename TCONFIG>
+void TMallocScaled<TCONFIG>::SetMemoryPressureCallback(TMemoryPressureCallback Callback, void* Context)
+{
+	Guard.Lock();
+	PressureCallback = Callback;
+	PressureContext = Context;
+	Guard.Unlock();
+}
+
+template<typename TCONFIG>
+bool TMallocScaled<TCONFIG>::DumpHeapProfile(TMallocWriter Writer, void* Context)
+{
+	return Profiler.Dump(Guard, Writer, Context);
+}
+
+template<typename TCONFIG>
+bool TMallocScaled<TCONFIG>::StartTrace(const char* Path)
+{
+	return Initialized && Tracer.Start(Path, Guard);
+}
+
+template<typename TCONFIG>
+void TMallocScaled<TCONFIG>::StopTrace()
+{
+	Tracer.Stop(Guard);
+}
+
+template<typename TCONFIG>
+bool TMallocScaled<TCONFIG>::DumpStats(EMallocStatsFormat Format, TMallocWriter Writer, void* Context)
+{
+	if (!Writer)
+	{
+		return false;
+	}
+
+	Guard.Lock();
+	TSize MaxClassCount = PoolTable.GetEntryCount() * PoolTable.GetSubIndexCount();
+	Guard.Unlock();
+
+	TSize ClassesSize = AlignToUpper(MaxClassCount * sizeof(TSizeClassStats), MAX_ALIGN);
+	TSize ArenasSize = PAGE_MALLOC_MAX_ARENA_COUNT * sizeof(TPageMallocArenaStats);
+
+	//	The snapshot comes from the shared arenas, never from the pools it describes;
+	TVMBlock SnapshotBlock;
+
+	if (!SnapshotBlock.Allocate(ClassesSize + ArenasSize))
+	{
+		return false;
+	}
+
+	TSizeClassStats* Classes = (TSizeClassStats*)SnapshotBlock.GetBase();
+	TPageMallocArenaStats* Arenas = (TPageMallocArenaStats*)((uint8*)Classes + ClassesSize);
+
+	Guard.Lock();
+	TSize ClassCount = PoolTable.GetSizeClassStats(Classes, MaxClassCount);
+	Guard.Unlock();
+
+	TSize ArenaCount = TVMBlock::GetArenaStats(Arenas, PAGE_MALLOC_MAX_ARENA_COUNT);
+
+	bool Ok = WriteMallocStats(Format, Classes, ClassCount, Arenas, ArenaCount, Writer, Context);
+
+	SnapshotBlock.Free();
+
+	return Ok;
+}
+
+template<typename TCONFIG>
+bool TMallocScaled<TCONFIG>::CheckMemoryPressure()
+{
+	TSize ResidentSize = TVMBlock::GetResidentSize();
+
+	if (!(Conf.SoftLimit && ResidentSize > Conf.SoftLimit) && !(Conf.PressureMonitor && TVMBlock::IsMemoryPressure()))
+	{
+		PressureBackoff = 0;
+		PressureSkips = 0;
+		return false;
+	}
+
+	if (PressureSkips)
+	{
+		--PressureSkips;
+		return false;
+	}
+
+	//	The first trim runs once the pressure starts, the next ones wait twice as long as before
+	//	until the resident size drops below the one of the last trim;
+	if (!PressureBackoff || ResidentSize < PressureResidentSize)
+	{
+		PressureBackoff = 1;
+	}
+	else if (PressureBackoff < MALLOC_SCALED_PRESSURE_MAX_BACKOFF)
+	{
+		PressureBackoff <<= 1;
+	}
+
+	PressureSkips = PressureBackoff;
+	PressureResidentSize = ResidentSize;
+
+	Guard.Lock();
+	TMemoryPressureCallback Callback = PressureCallback;
+	void* Context = PressureContext;
+	++PoolTable.GetPoolCacheStats()->PressureTrims;
+	Guard.Unlock();
+
+	//	The application sheds its caches first, so the blocks it frees are trimmed as well;
+	if (Callback)
+	{
+		Callback(ResidentSize, Context);
+	}
+
+	TSize TrimmedSize = Trim(0);
+
+#ifdef MALLOC_SCALED_DEBUG
+	printf("MALLOC: DBG: MEMORY PRESSURE: Resident: %llu, Soft limit: %llu, Trimmed: %llu Bytes\n", ResidentSize, Conf.SoftLimit, TrimmedSize);
+#endif
+
+	return TrimmedSize != 0;
+}
+
+template<typename TCONFIG>
+void TMallocScaled<TCONFIG>::BackgroundThreadLoop()
+{
+	using TClock = std::chrono::steady_clock;
+
+	std::unique_lock<std::mutex> Lock(BackgroundGuard);
+	bool PressureChecks = Conf.SoftLimit || Conf.PressureMonitor;
+	auto NextPageReclaim = TClock::now() + std::chrono::milliseconds(MALLOC_SCALED_PAGE_RECLAIM_PERIOD);
+	auto NextPressureCheck = PressureChecks ? TClock::now() + std::chrono::milliseconds(MALLOC_SCALED_PRESSURE_CHECK_PERIOD) : TClock::time_point::max();
+
+	while (!BackgroundStop)
+	{
+		if (TClock::now() >= NextPressureCheck)
+		{
+			Lock.unlock();
+			CheckMemoryPressure();
+			Lock.lock();
+
+			NextPressureCheck = TClock::now() + std::chrono::milliseconds(MALLOC_SCALED_PRESSURE_CHECK_PERIOD);
+			continue;
+		}
+
+		if (TClock::now() >= NextPageReclaim)
+		{
+			Lock.unlock();
+			ReclaimPoolPages();
+			Lock.lock();
+
+			NextPageReclaim = TClock::now() + std::chrono::milliseconds(MALLOC_SCALED_PAGE_RECLAIM_PERIOD);
+			continue;
+		}
+
+		if (ReclaimRequested)
+		{
+			ReclaimRequested = false;
+			Lock.unlock();
+			ReclaimPools();
+			Lock.lock();
+			continue;
+		}
+
+		if (!SpareRequestCount)
+		{
+			BackgroundWakeup.wait_until(Lock, NextPressureCheck < NextPageReclaim ? NextPressureCheck : NextPageReclaim);
+			continue;
+		}
+
+		TMemPool<TCONFIG>* Pool = SpareRequests[--SpareRequestCount];
+		Lock.unlock();
+
+		//	Mapping and faulting in are the slow part, they run without the allocator lock;
+		TVMBlock PoolVMBlock;
+		bool Ok = Pool->AllocateSparePool(PoolVMBlock);
+
+		Guard.Lock();
+
+		if (Ok)
+		{
+			Pool->AddSparePool(move(PoolVMBlock));
+		}
+		else
+		{
+			Pool->CancelSparePool();
+		}
+
+		Guard.Unlock();
+		Lock.lock();
+	}
+}
+
+template<typename TCONFIG>
+TSize TMallocScaled<TCONFIG>::Trim(TSize KeepBytes)
+{
+	if (!Initialized)
+	{
+		return 0;
+	}
+
+	//	KeepBytes is spent on the cached pools first, then on the free arena runs and then on the free pool pages;
+	TSize KeepSize = KeepBytes;
+
+	Guard.Lock();
+	PoolTable.Trim(KeepSize);
+	Guard.Unlock();
+
+	//	Pools go back to their arenas first, so their pages are purged with the rest of the free runs;
+	TSize PurgedSize = ReclaimPools();
+	PurgedSize += TVMBlock::PurgeArenas(ArenaOwner, KeepSize);
+	PurgedSize += ReclaimPoolPages(KeepSize);
+
+#ifdef MALLOC_SCALED_DEBUG
+	printf("MALLOC: DBG: TRIM: Keep: %llu, Purged: %llu Bytes\n", KeepBytes, PurgedSize);
+#endif
+
+	return PurgedSize;
+}
+
+template<typename TCONFIG>
+bool TMallocScaled<TCONFIG>::Prewarm(TSize Size, TSize Count, TSize Alignment)
+{
+	Guard.Lock();
+	bool Ok = PrewarmInternal(Size, Count, Alignment);
+	Guard.Unlock();
+	return Ok;
+}
+
+template<typename TCONFIG>
+bool TMallocScaled<TCONFIG>::PrewarmInternal(TSize Size, TSize Count, TSize Alignment)
+{
+	if (!Initialized || !Size)
+	{
+		return false;
+	}
+
+	if (!Alignment)
+	{
+		Alignment = MALLOC_SCALED_DEFAULT_ALIGNMENT;
+	}
+
+	TSize AdjustedBlockSize = Size + (Size >> MALLOC_SCALED_ALLOCATION_ADJUSTMENT);
+	AdjustedBlockSize = AlignToUpper(AdjustedBlockSize + Alignment, MALLOC_SCALED_DEFAULT_ALIGNMENT);
+
+	TMemPool<TCONFIG>* Pool = PoolTable.GetPool(AdjustedBlockSize);
+
+	if (!Pool)
+	{
+		return false;
+	}
+
+	bool Ok = Pool->Prewarm(Count);
+
+#ifdef MALLOC_SCALED_DEBUG
+	printf("MALLOC: DBG: PREWARM: Size: %llu, Count: %llu, Block size: %llu, Pools: %llu - [ %s ]\n", Size, Count, Pool->GetBlockSize(), Pool->GetPoolCount(), Ok ? "OK" : "FAILED");
+#endif
+
+	return Ok;
+}
+
+template<typename TCONFIG>
+void TMallocScaled<TCONFIG>::InitConf(const TMallocConf& UserConf)
+{
+	Conf = {};
+	Conf.MinBaseBlockSize   = TCONFIG::MinBaseBlockSize;
+	Conf.MaxBaseBlockSize   = TCONFIG::MaxBaseBlockSize;
+	Conf.SubIndexCount      = TCONFIG::SubIndexCount;
+	Conf.PoolBlockSize      = TCONFIG::PoolBlockSize;
+	Conf.ArenaSize          = TCONFIG::ArenaSize;
+	Conf.ArenaPageSize      = IsPow2(UserConf.ArenaPageSize) ? UserConf.ArenaPageSize : 0;
+	Conf.PoolCacheHighWater = TCONFIG::PoolCacheHighWater;
+	Conf.PoolCacheLowWater  = TCONFIG::PoolCacheLowWater;
+	Conf.PoolCacheMaxSize   = TCONFIG::PoolCacheMaxSize;
+	Conf.StatsPrint         = UserConf.StatsPrint;
+	Conf.BackgroundThread   = UserConf.BackgroundThread;
+	Conf.PressureMonitor    = UserConf.PressureMonitor;
+	Conf.SoftLimit          = UserConf.SoftLimit;
+	Conf.PoolColorCount     = UserConf.PoolColorCount ? UserConf.PoolColorCount : MALLOC_SCALED_POOL_COLOR_COUNT;
+	Conf.ThreadPoolCount    = UserConf.ThreadPoolCount && IsPow2(UserConf.ThreadPoolCount) && UserConf.ThreadPoolCount <= MALLOC_SCALED_MAX_THREAD_POOL_COUNT ? UserConf.ThreadPoolCount : 1;
+	Conf.ProfSampleInterval = UserConf.ProfSampleInterval;
+
+	//	Size classes are taken as a whole and only if they keep the invariants checked by TMallocScaledSizeClasses;
+	TSize MinBaseBlockSize = UserConf.MinBaseBlockSize ? UserConf.MinBaseBlockSize : Conf.MinBaseBlockSize;
+	TSize MaxBaseBlockSize = UserConf.MaxBaseBlockSize ? UserConf.MaxBaseBlockSize : Conf.MaxBaseBlockSize;
+	TSize SubIndexCount    = UserConf.SubIndexCount    ? UserConf.SubIndexCount    : Conf.SubIndexCount;
+
+	if (IsPow2(MinBaseBlockSize) && IsPow2(MaxBaseBlockSize) && IsPow2(SubIndexCount) &&
+		MinBaseBlockSize <= MaxBaseBlockSize &&
+		SubIndexCount <= TCONFIG::MaxSubIndexCount &&
+		MinBaseBlockSize / SubIndexCount >= MALLOC_SCALED_DEFAULT_ALIGNMENT)
+	{
+		Conf.MinBaseBlockSize = MinBaseBlockSize;
+		Conf.MaxBaseBlockSize = MaxBaseBlockSize;
+		Conf.SubIndexCount    = SubIndexCount;
+	}
+#ifdef MALLOC_SCALED_DEBUG
+	else
+	{
+		printf("MALLOC: DBG: %s: invalid size classes, using the defaults\n", ArenaOwner ? "HEAP" : MALLOC_SCALED_CONF_ENV);
+	}
+#endif
+
+	if (UserConf.PoolBlockSize && IsAligned(UserConf.PoolBlockSize, MALLOC_SCALED_SYSTEM_DEFAULT_ALIGNMENT))
+	{
+		Conf.PoolBlockSize = UserConf.PoolBlockSize;
+	}
+
+	if (UserConf.ArenaSize)
+	{
+		Conf.ArenaSize = UserConf.ArenaSize;
+	}
+
+	TSize HighWater = UserConf.PoolCacheHighWater ? UserConf.PoolCacheHighWater : Conf.PoolCacheHighWater;
+	TSize LowWater  = UserConf.PoolCacheLowWater  ? UserConf.PoolCacheLowWater  : Conf.PoolCacheLowWater;
+
+	if (LowWater <= HighWater)
+	{
+		Conf.PoolCacheHighWater = HighWater;
+		Conf.PoolCacheLowWater  = LowWater;
+	}
+
+	if (UserConf.PoolCacheMaxSize)
+	{
+		Conf.PoolCacheMaxSize = UserConf.PoolCacheMaxSize;
+	}
+
+	Conf.PrewarmCount = UserConf.PrewarmCount < MALLOC_CONF_MAX_PREWARM_COUNT ? UserConf.PrewarmCount : MALLOC_CONF_MAX_PREWARM_COUNT;
+
+	for (TSize i = 0; i < Conf.PrewarmCount; ++i)
+	{
+		Conf.Prewarm[i] = UserConf.Prewarm[i];
+	}
+}
+
+template<typename TCONFIG>
+void TMallocScaled<TCONFIG>::GetConf(TMallocConf& OutConf)
+{
+	OutConf = Conf;
+}
+
+template<typename TCONFIG>
+bool TMallocScaled<TCONFIG>::IsInitialized()
+{
+	return Initialized;
+}
+
+
+template<typename TCONFIG>
+void TMallocScaled<TCONFIG>::Shutdown()
+{
+#ifdef MALLOC_SCALED_DEBUG
+	printf("MALLOC: DBG: Destroying memory allocator\n");
+#endif
+
+	StopBackgroundThread();
+	Profiler.Release();
+	Tracer.Stop(Guard);
+
+	//	Slots of the live threads go with the pool table;
+	Guard.Lock();
+	++HeadSlotEpoch;
+	Guard.Unlock();
+
+	if (ArenaOwner)
+	{
+		//	The table storage and all pools live in the owned arenas;
+		PoolTable.Drop();
+		TVMBlock::ReleaseArenas(ArenaOwner);
+	}
+	else
+	{
+		//	Heaps still alive keep their owned arenas;
+		PoolTable.Release();
+		TVMBlock::ReleaseSharedArenas();
+	}
 
 #ifdef MALLOC_STATS
 	MallocStats = {};
@@ -1083,12 +2756,14 @@ void TMallocScaled::Shutdown()
 #endif
 }
 
-TSize TMallocScaled::GetMallocMaxAlignment()
+template<typename TCONFIG>
+TSize TMallocScaled<TCONFIG>::GetMallocMaxAlignment()
 {
 	return TVMBlock::GetPageSize();
 }
 
-void TMallocScaled::GetSpecificStats(void* OutStatData)
+template<typename TCONFIG>
+void TMallocScaled<TCONFIG>::GetSpecificStats(void* OutStatData)
 {
 //#ifdef MALLOC_STATS
 //	TBigMemBlock* FBlock = *(BigBlockMemRegion.BigBlocks.GetFirst()->GetElement());
@@ -1113,35 +2788,101 @@ void TMallocScaled::GetSpecificStats(void* OutStatData)
 //#endif
 }
 
-TSize TMallocScaled::GetBaseEntryCount()
+template<typename TCONFIG>
+TSize TMallocScaled<TCONFIG>::GetBaseEntryCount()
 {
 	return PoolTable.GetEntryCount();
 }
 
-TSize TMallocScaled::GetBlockSize(TSize BaseIndex, TSize PoolIndex)
+template<typename TCONFIG>
+TSize TMallocScaled<TCONFIG>::GetBlockSize(TSize BaseIndex, TSize PoolIndex)
 {
-	TMemPoolTableEntry* BaseEntry = PoolTable.GetEntry(BaseIndex);
+	TMemPoolTableEntry<TCONFIG>* BaseEntry = PoolTable.GetEntry(BaseIndex);
 
-	TMemPool* Pool = BaseEntry->GetPool(PoolIndex);
+	TMemPool<TCONFIG>* Pool = BaseEntry->GetPool(PoolIndex);
 
 	return Pool->GetBlockSize();
 }
 
-TSize TMallocScaled::GetBlockCount(TSize BaseIndex, TSize PoolIndex)
+template<typename TCONFIG>
+TSize TMallocScaled<TCONFIG>::GetBlockCount(TSize BaseIndex, TSize PoolIndex)
 {
-	TMemPoolTableEntry* BaseEntry = PoolTable.GetEntry(BaseIndex);
-	TMemPool* Pool = BaseEntry->GetPool(PoolIndex);
+	TMemPoolTableEntry<TCONFIG>* BaseEntry = PoolTable.GetEntry(BaseIndex);
+	TMemPool<TCONFIG>* Pool = BaseEntry->GetPool(PoolIndex);
 	TSize BlockCount = PoolTable.GetPoolBlockSize() / (Pool->GetBlockSize() + MemBlockHdrSize + MemBlockHdrOffsetSize);
 
 	return BlockCount;
 }
 
-TSize TMallocScaled::GetMaxPoolBlockSize()
+template<typename TCONFIG>
+TSize TMallocScaled<TCONFIG>::GetMaxPoolBlockSize()
 {
 	return PoolTable.GetPoolBlockSize();
 }
 
+template<typename TCONFIG>
+TSize TMallocScaled<TCONFIG>::GetGoodSize(TSize Size, TSize Alignment)
+{
+	if (!Alignment)
+	{
+		Alignment = MALLOC_SCALED_DEFAULT_ALIGNMENT;
+	}
+
+	TSize AdjustedBlockSize = Size + (Size >> MALLOC_SCALED_ALLOCATION_ADJUSTMENT);
+	AdjustedBlockSize = AlignToUpper(AdjustedBlockSize + Alignment, MALLOC_SCALED_DEFAULT_ALIGNMENT);
+
+	TMemPool<TCONFIG>* Pool = PoolTable.GetPool(AdjustedBlockSize);
+
+	return Pool ? Pool->GetBlockSize() : 0;
+}
+
+template<typename TCONFIG>
+void TMallocScaled<TCONFIG>::GetPoolCacheStats(TMemPoolCacheStats& OutStats)
+{
+	Guard.Lock();
+	OutStats = *PoolTable.GetPoolCacheStats();
+	Guard.Unlock();
+}
+
+template<typename TCONFIG>
+void TMallocScaled<TCONFIG>::GetCounters(TMallocCounters& OutCounters)
+{
+	Guard.Lock();
+	PoolTable.GetCounters(OutCounters);
+	Guard.Unlock();
+}
+
+template<typename TCONFIG>
+TSize TMallocScaled<TCONFIG>::GetSizeClassCounters(TSizeClassCounters* OutCounters, TSize MaxCount)
+{
+	Guard.Lock();
+	TSize ClassCount = PoolTable.GetSizeClassCounters(OutCounters, MaxCount);
+	Guard.Unlock();
+
+	return ClassCount;
+}
+
+template<typename TCONFIG>
+TSize TMallocScaled<TCONFIG>::GetSizeClassStats(TSizeClassStats* OutStats, TSize MaxCount)
+{
+	Guard.Lock();
+	TSize ClassCount = PoolTable.GetSizeClassStats(OutStats, MaxCount);
+	Guard.Unlock();
+
+	return ClassCount;
+}
+
 float64 GetFunctionTime()
 {
 	return std::chrono::duration<float64, std::nano>(Ts.GetAvgTime()).count();
-}
\ No newline at end of file
+}
+
+template class TMemPool<TMallocScaledDefaultConfig>;
+template class TMemPoolTableEntry<TMallocScaledDefaultConfig>;
+template class TMemPoolTable<TMallocScaledDefaultConfig>;
+template class TMallocScaled<TMallocScaledDefaultConfig>;
+
+template class TMemPool<TMallocScaledLargeBufferConfig>;
+template class TMemPoolTableEntry<TMallocScaledLargeBufferConfig>;
+template class TMemPoolTable<TMallocScaledLargeBufferConfig>;
+template class TMallocScaled<TMallocScaledLargeBufferConfig>;
\ No newline at end of file
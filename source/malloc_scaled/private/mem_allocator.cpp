@@ -8,7 +8,13 @@ TMemoryAllocator* TMemoryAllocator::GMemoryAllocator = nullptr;
 TMallocBase* TMemoryAllocator::GMalloc = nullptr;
 EMAllocToUse TMemoryAllocator::MallocToUse = EMAllocToUse::None;
 
-static TMallocScaled GMallocScaled1;
+static TMallocScaled<> GMallocScaled1;
+
+static TMallocScaled<> GHeaps[MALLOC_SCALED_MAX_HEAP_COUNT];
+static bool GHeapUsed[MALLOC_SCALED_MAX_HEAP_COUNT];
+static TMallocScaled<TMallocScaledLargeBufferConfig> GLargeBufferHeaps[MALLOC_SCALED_MAX_LARGE_BUFFER_HEAP_COUNT];
+static bool GLargeBufferHeapUsed[MALLOC_SCALED_MAX_LARGE_BUFFER_HEAP_COUNT];
+static TCriticalSection GHeapGuard;
 
 IMalloc* TMemoryAllocator::GetMalloc()
 {
@@ -42,7 +48,7 @@ bool TMemoryAllocator::Init(EMAllocToUse MallocToUse)
 	return Ok;
 }
 
-TMallocScaled* TMemoryAllocator::GetMallocObject()
+TMallocScaled<>* TMemoryAllocator::GetMallocObject()
 {
 	switch (MallocToUse)
 	{
@@ -71,6 +77,99 @@ void TMemoryAllocator::Shutdown()
 	}
 }
 
+template<typename THEAP, TSize HEAP_COUNT>
+static IMalloc* CreateHeapIn(THEAP (&Heaps)[HEAP_COUNT], bool (&HeapUsed)[HEAP_COUNT], const TMallocConf& Conf)
+{
+	for (TSize i = 0; i < HEAP_COUNT; ++i)
+	{
+		if (!HeapUsed[i])
+		{
+			if (Heaps[i].InitHeap(Conf))
+			{
+				HeapUsed[i] = true;
+				return &Heaps[i];
+			}
+
+			break;
+		}
+	}
+
+	return nullptr;
+}
+
+template<typename THEAP, TSize HEAP_COUNT>
+static bool DestroyHeapIn(THEAP (&Heaps)[HEAP_COUNT], bool (&HeapUsed)[HEAP_COUNT], IMalloc* Heap)
+{
+	for (TSize i = 0; i < HEAP_COUNT; ++i)
+	{
+		if (HeapUsed[i] && Heap == &Heaps[i])
+		{
+			Heaps[i].Shutdown();
+			HeapUsed[i] = false;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+template<typename THEAP, TSize HEAP_COUNT>
+static bool DumpHeapProfileIn(THEAP (&Heaps)[HEAP_COUNT], bool (&HeapUsed)[HEAP_COUNT], IMalloc* Heap, TMallocWriter Writer, void* Context, bool& OutOk)
+{
+	for (TSize i = 0; i < HEAP_COUNT; ++i)
+	{
+		if (HeapUsed[i] && Heap == &Heaps[i])
+		{
+			OutOk = Heaps[i].DumpHeapProfile(Writer, Context);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+IMalloc* TMemoryAllocator::CreateHeap(const TMallocConf& Conf)
+{
+	GHeapGuard.Lock();
+
+	IMalloc* Heap = Conf.LargeBuffers ?
+		CreateHeapIn(GLargeBufferHeaps, GLargeBufferHeapUsed, Conf) :
+		CreateHeapIn(GHeaps, GHeapUsed, Conf);
+
+	GHeapGuard.Unlock();
+
+	return Heap;
+}
+
+bool TMemoryAllocator::DestroyHeap(IMalloc* Heap)
+{
+	GHeapGuard.Lock();
+
+	bool Ok = DestroyHeapIn(GHeaps, GHeapUsed, Heap) ||
+		DestroyHeapIn(GLargeBufferHeaps, GLargeBufferHeapUsed, Heap);
+
+	GHeapGuard.Unlock();
+
+	return Ok;
+}
+
+bool TMemoryAllocator::DumpHeapProfile(IMalloc* Heap, TMallocWriter Writer, void* Context)
+{
+	bool Ok = false;
+
+	//	The heap cannot be destroyed while its profile is written;
+	GHeapGuard.Lock();
+
+	if (!DumpHeapProfileIn(GHeaps, GHeapUsed, Heap, Writer, Context, Ok))
+	{
+		DumpHeapProfileIn(GLargeBufferHeaps, GLargeBufferHeapUsed, Heap, Writer, Context, Ok);
+	}
+
+	GHeapGuard.Unlock();
+
+	return Ok;
+}
+
 bool InitMalloc()
 {
 	return TMemoryAllocator::Init(EMAllocToUse::MallocScaled1);
@@ -86,6 +185,16 @@ void ShutdownMalloc()
 	TMemoryAllocator::Shutdown();
 }
 
+IMalloc* CreateHeap(const TMallocConf& Conf)
+{
+	return TMemoryAllocator::CreateHeap(Conf);
+}
+
+bool DestroyHeap(IMalloc* Heap)
+{
+	return TMemoryAllocator::DestroyHeap(Heap);
+}
+
 void* Malloc(TSize Size, TSize Alignment)
 {
 	IMalloc* Ma = TMemoryAllocator::GetMalloc();
@@ -98,6 +207,18 @@ void* Malloc(TSize Size, TSize Alignment)
 	return nullptr;
 }
 
+void* Calloc(TSize Count, TSize Size, TSize Alignment)
+{
+	IMalloc* Ma = TMemoryAllocator::GetMalloc();
+
+	if (Ma)
+	{
+		return Ma->Calloc(Count, Size, Alignment);
+	}
+
+	return nullptr;
+}
+
 void* Realloc(void* Addr, TSize NewSize, TSize NewAlignment)
 {
 	IMalloc* Ma = TMemoryAllocator::GetMalloc();
@@ -132,14 +253,144 @@ TSize GetSize(void* Addr)
 	return 0;
 }
 
-//TMallocScaled* GetMallocObject(EMAllocToUse MallocToUse)
+TSize GetGoodSize(TSize Size, TSize Alignment)
+{
+	TMallocScaled<>* MemoryAllocator = TMemoryAllocator::GetMallocObject();
+	if (MemoryAllocator)
+	{
+		return MemoryAllocator->GetGoodSize(Size, Alignment);
+	}
+
+	return 0;
+}
+
+bool Prewarm(TSize Size, TSize Count, TSize Alignment)
+{
+	TMallocScaled<>* MemoryAllocator = TMemoryAllocator::GetMallocObject();
+	if (MemoryAllocator)
+	{
+		return MemoryAllocator->Prewarm(Size, Count, Alignment);
+	}
+
+	return false;
+}
+
+TSize Trim(TSize KeepBytes)
+{
+	TMallocScaled<>* MemoryAllocator = TMemoryAllocator::GetMallocObject();
+	if (MemoryAllocator)
+	{
+		return MemoryAllocator->Trim(KeepBytes);
+	}
+
+	return 0;
+}
+
+void SetMemoryPressureCallback(TMemoryPressureCallback Callback, void* Context)
+{
+	TMallocScaled<>* MemoryAllocator = TMemoryAllocator::GetMallocObject();
+	if (MemoryAllocator)
+	{
+		MemoryAllocator->SetMemoryPressureCallback(Callback, Context);
+	}
+}
+
+void GetThreadMallocCounters(TMallocCounters& Counters)
+{
+	Counters = GThreadMallocCounters;
+}
+
+void GetMallocCounters(TMallocCounters& Counters)
+{
+	TMallocScaled<>* MemoryAllocator = TMemoryAllocator::GetMallocObject();
+	if (MemoryAllocator)
+	{
+		MemoryAllocator->GetCounters(Counters);
+	}
+}
+
+TSize GetSizeClassCounters(TSizeClassCounters* Counters, TSize MaxCount)
+{
+	TMallocScaled<>* MemoryAllocator = TMemoryAllocator::GetMallocObject();
+	if (MemoryAllocator)
+	{
+		return MemoryAllocator->GetSizeClassCounters(Counters, MaxCount);
+	}
+
+	return 0;
+}
+
+TSize GetSizeClassStats(TSizeClassStats* Stats, TSize MaxCount)
+{
+	TMallocScaled<>* MemoryAllocator = TMemoryAllocator::GetMallocObject();
+	if (MemoryAllocator)
+	{
+		return MemoryAllocator->GetSizeClassStats(Stats, MaxCount);
+	}
+
+	return 0;
+}
+
+TSize GetArenaStats(TPageMallocArenaStats* Stats, TSize MaxCount)
+{
+	return TVMBlock::GetArenaStats(Stats, MaxCount);
+}
+
+bool DumpHeapProfile(TMallocWriter Writer, void* Context)
+{
+	TMallocScaled<>* MemoryAllocator = TMemoryAllocator::GetMallocObject();
+	if (MemoryAllocator)
+	{
+		return MemoryAllocator->DumpHeapProfile(Writer, Context);
+	}
+
+	return false;
+}
+
+bool DumpHeapProfileOf(IMalloc* Heap, TMallocWriter Writer, void* Context)
+{
+	return TMemoryAllocator::DumpHeapProfile(Heap, Writer, Context);
+}
+
+bool DumpStats(EMallocStatsFormat Format, TMallocWriter Writer, void* Context)
+{
+	TMallocScaled<>* MemoryAllocator = TMemoryAllocator::GetMallocObject();
+	if (MemoryAllocator)
+	{
+		return MemoryAllocator->DumpStats(Format, Writer, Context);
+	}
+
+	return false;
+}
+
+bool StartAllocTrace(const char* Path)
+{
+	TMallocScaled<>* MemoryAllocator = TMemoryAllocator::GetMallocObject();
+	if (MemoryAllocator)
+	{
+		return MemoryAllocator->StartTrace(Path);
+	}
+
+	return false;
+}
+
+void StopAllocTrace()
+{
+	TMallocScaled<>* MemoryAllocator = TMemoryAllocator::GetMallocObject();
+	if (MemoryAllocator)
+	{
+		MemoryAllocator->StopTrace();
+	}
+}
+
+//TMallocScaled<>* GetMallocObject(EMAllocToUse MallocToUse)
 //{
 //
 //}
 
 void GetMallocStats(TMallocStats& Stats)
 {
-	TMallocScaled* MemoryAllocator = TMemoryAllocator::GetMallocObject();
+	TMallocScaled<>* MemoryAllocator = TMemoryAllocator::GetMallocObject();
 	if (MemoryAllocator)
 	{
 		MemoryAllocator->GetMallocStats(Stats);
@@ -150,7 +401,7 @@ void GetMallocStats(TMallocStats& Stats)
 
 void GetMallocTimeStats(TMallocTimeStats& TimeStats)
 {
-	TMallocScaled* MemoryAllocator = TMemoryAllocator::GetMallocObject();
+	TMallocScaled<>* MemoryAllocator = TMemoryAllocator::GetMallocObject();
 	if (MemoryAllocator)
 	{
 		MemoryAllocator->GetMallocTimeStats(TimeStats);
@@ -160,7 +411,7 @@ void GetMallocTimeStats(TMallocTimeStats& TimeStats)
 
 TSize GetMaxPoolBlockSize()
 {
-	TMallocScaled* MemoryAllocator = TMemoryAllocator::GetMallocObject();
+	TMallocScaled<>* MemoryAllocator = TMemoryAllocator::GetMallocObject();
 	if (MemoryAllocator)
 	{
 		return MemoryAllocator->GetMaxPoolBlockSize();
@@ -169,6 +420,24 @@ TSize GetMaxPoolBlockSize()
 	return 0;
 }
 
+void GetMemPoolCacheStats(TMemPoolCacheStats& Stats)
+{
+	TMallocScaled<>* MemoryAllocator = TMemoryAllocator::GetMallocObject();
+	if (MemoryAllocator)
+	{
+		MemoryAllocator->GetPoolCacheStats(Stats);
+	}
+}
+
+void GetMallocConf(TMallocConf& Conf)
+{
+	TMallocScaled<>* MemoryAllocator = TMemoryAllocator::GetMallocObject();
+	if (MemoryAllocator)
+	{
+		MemoryAllocator->GetConf(Conf);
+	}
+}
+
 float64 GetAvgTime_ms(TMallocTimeStats & TimeStats, EMallocAction Act)
 {
 	std::chrono::duration<float64, std::milli> Time = {};
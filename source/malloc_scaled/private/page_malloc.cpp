@@ -10,7 +10,7 @@ static const TSize DEFAULT_ARENA_SIZE      = 256 * 1024 * 1024;
 
 TPageMalloc* TPageMalloc::GPageMalloc = nullptr;
 
-TPageMalloc* TPageMalloc::GetPageMalloc()
+TPageMalloc* TPageMalloc::GetPageMalloc(TSize ArenaPageSize, TSize ArenaMinSize)
 {
 	static TPlatformMalloc PlatformMalloc;
 	static TPageMalloc PageMalloc;
@@ -19,7 +19,7 @@ TPageMalloc* TPageMalloc::GetPageMalloc()
 	{
 		if (PlatformMalloc.Init())
 		{
-			if (PageMalloc.Init(&PlatformMalloc))
+			if (PageMalloc.Init(&PlatformMalloc, ArenaPageSize, 0, ArenaMinSize))
 			{
 				GPageMalloc = &PageMalloc;
 			}
@@ -165,6 +165,7 @@ bool TPageMalloc::TArena::Init(TSize AreaSize, TSize ArenaPageSize, TSize PageSi
 			this->PlatformMalloc = PlatformMalloc;
 			this->ArenaPageSizeShift = ArenaPageSizeShift;
 			RestFreeSize = AreaSize;
+			TouchedEnd = (uint8*)AreaAddress;
 			this->LastTimeStats = OutTimeStats;
 
 			Initialized = true;
@@ -185,6 +186,7 @@ bool TPageMalloc::TArena::Init(TSize AreaSize, TSize ArenaPageSize, TSize PageSi
 
 TPageMalloc::TArena::TArena() :
 	RestFreeSize(0),
+	TouchedEnd(nullptr),
 	ArenaPageSize(0),
 	ArenaPageSizeShift(0),
 	UserBlockCount(0),
@@ -201,7 +203,7 @@ bool TPageMalloc::TArena::IsInitialized()
 	return Initialized;
 }
 
-void* TPageMalloc::TArena::TryMallocBlock(TSize Size, TSize& OutSize, void* Address)
+void* TPageMalloc::TArena::TryMallocBlock(TSize Size, TSize& OutSize, bool& OutUntouched, void* Address)
 {
 #if PAGE_MALLOC_TIME_STATS
 	TTimer Timer;
@@ -250,6 +252,15 @@ void* TPageMalloc::TArena::TryMallocBlock(TSize Size, TSize& OutSize, void* Addr
 	{
 		OutSize = AlignedSize;
 		RestFreeSize -= AlignedSize;
+
+		//	The arena is committed at once, so pages above the highest block ever handed out are still zero;
+		uint8* End = (uint8*)Ptr + AlignedSize;
+		OutUntouched = (uint8*)Ptr >= TouchedEnd;
+
+		if (End > TouchedEnd)
+		{
+			TouchedEnd = End;
+		}
 	}
 
 #if PAGE_MALLOC_TIME_STATS
@@ -388,6 +399,7 @@ TPageMalloc::TArena::TBlock* TPageMalloc::TArena::SplitReleasedBlock(TBlock* Par
 
 			RestBlock->Ptr = (uint8_t*)(ParentBlock->Ptr) + SizeToSplit;
 			RestBlock->Size = ParentBlockSize - SizeToSplit;
+			RestBlock->Purged = ParentBlock->Purged;
 
 			TBlock* Upper = ParentBlock->Upper;
 			RestBlock->Lower = ParentBlock;
@@ -430,6 +442,7 @@ void TPageMalloc::TArena::MergeAdjecentReleasedBlocks(TBlock* Block)
 			UpperBlock->Lower = nullptr;
 
 			Block->Size += UpperBlock->Size;
+			Block->Purged = Block->Purged && UpperBlock->Purged;
 		}
 	}
 
@@ -452,6 +465,7 @@ void TPageMalloc::TArena::MergeAdjecentReleasedBlocks(TBlock* Block)
 			Block->Lower = nullptr;
 
 			LowerBlock->Size += Block->Size;
+			LowerBlock->Purged = LowerBlock->Purged && Block->Purged;
 		}
 	}
 }
@@ -477,6 +491,7 @@ bool TPageMalloc::TArena::TryFreeBlock(void* Address)
 				BlkSize = Block->Size;
 				RestFreeSize += Block->Size;
 				Block->State = RELEASED;
+				Block->Purged = false;
 				--UserBlockCount;
 				++FreeBlockCount;
 				FreeBlockList.PushBack(Block);
@@ -523,6 +538,93 @@ bool TPageMalloc::TArena::IsEmpty()
 	return UserBlockCount == 0;
 }
 
+void TPageMalloc::TArena::GetStats(TPageMallocArenaStats& OutStats)
+{
+	OutStats.Base = Arena.GetBase();
+	OutStats.ReservedSize = Arena.GetSize();
+	OutStats.UsedSize = Arena.GetSize() - RestFreeSize;
+	OutStats.FreeSize = RestFreeSize;
+	OutStats.FreeRunCount = 0;
+	OutStats.LargestFreeRun = 0;
+	OutStats.BlockCount = UserBlockCount;
+
+	for (auto BlockNode = FreeBlockList.GetFirst(); BlockNode; BlockNode = BlockNode->GetNext())
+	{
+		TBlock* Block = *BlockNode->GetElement();
+
+		++OutStats.FreeRunCount;
+
+		if (Block->Size > OutStats.LargestFreeRun)
+		{
+			OutStats.LargestFreeRun = Block->Size;
+		}
+	}
+}
+
+TSize TPageMalloc::TArena::Purge(TSize& InOutKeepSize)
+{
+	TSize PurgedSize = 0;
+
+	for (auto BlockNode = FreeBlockList.GetFirst(); BlockNode; BlockNode = BlockNode->GetNext())
+	{
+		TBlock* Block = *BlockNode->GetElement();
+
+		if (Block->Purged)
+		{
+			continue;
+		}
+
+		uint8* Begin = (uint8*)Block->Ptr;
+		uint8* End = Begin + Block->Size;
+
+		//	Pages above TouchedEnd were never handed out and hold no frames;
+		if (End > TouchedEnd)
+		{
+			End = TouchedEnd;
+		}
+
+		if (Begin >= End)
+		{
+			Block->Purged = true;
+		}
+		else if ((TSize)(End - Begin) <= InOutKeepSize)
+		{
+			InOutKeepSize -= End - Begin;
+		}
+		else if (PlatformMalloc->PurgeMemoryBlock(TPlatformMemoryBlock(Begin, End - Begin)))
+		{
+			Block->Purged = true;
+			PurgedSize += End - Begin;
+		}
+	}
+
+	return PurgedSize;
+}
+
+TSize TPageMalloc::TArena::GetUnpurgedSize()
+{
+	TSize UnpurgedSize = 0;
+
+	for (auto BlockNode = FreeBlockList.GetFirst(); BlockNode; BlockNode = BlockNode->GetNext())
+	{
+		TBlock* Block = *BlockNode->GetElement();
+		uint8* Begin = (uint8*)Block->Ptr;
+		uint8* End = Begin + Block->Size;
+
+		if (End > TouchedEnd)
+		{
+			End = TouchedEnd;
+		}
+
+		if (!Block->Purged && Begin < End)
+		{
+			UnpurgedSize += End - Begin;
+		}
+	}
+
+	return UnpurgedSize;
+}
+
 void TPageMalloc::TArena::Free()
 {
 	FreeBlockList.Delete();
@@ -532,6 +634,7 @@ void TPageMalloc::TArena::Free()
 	ZeroBlock->Size = Arena.GetSize();
 	ZeroBlock->Ptr = Arena.GetBase();
 	ZeroBlock->State = RELEASED;
+	ZeroBlock->Purged = false;
 
 	RestFreeSize = Arena.GetSize();
 	UserBlockCount = 0;
@@ -541,7 +644,7 @@ void TPageMalloc::TArena::Free()
 
 bool TPageMalloc::TArena::Release()
 {
-	bool Ok = PlatformMalloc->DeallocateMemoryBlock(TPlatformMemoryBlock(Arena.GetBase(), 0));
+	bool Ok = PlatformMalloc->DeallocateMemoryBlock(Arena);
 	if (Ok)
 	{
 		FreeBlockList.Delete();
@@ -630,8 +733,10 @@ bool TPageMalloc::Reserve(TMemoryBlock& OutBlock)
 	return Reserve(ArenaMinSize, OutBlock);
 }
 
-bool TPageMalloc::Reserve(TSize Size, TMemoryBlock& OutBlock)
+bool TPageMalloc::Reserve(TSize Size, TMemoryBlock& OutBlock, void* Owner)
 {
+	Guard.Lock();
+
 #if PAGE_MALLOC_STATS
 	++Stats.ReserveRequests;
 #endif
@@ -654,6 +759,7 @@ bool TPageMalloc::Reserve(TSize Size, TMemoryBlock& OutBlock)
 		if (Ok)
 		{
 			ArenaTable[FreeSlot]->Free = false;
+			ArenaTable[FreeSlot]->Owner = Owner;
 			OutBlock = TMemoryBlock{ ArenaTable[FreeSlot]->Arena.GetArenaBase(), ArenaTable[FreeSlot]->Arena.GetArenaSize() };
 
 #if PAGE_MALLOC_DEBUG
@@ -694,23 +800,28 @@ bool TPageMalloc::Reserve(TSize Size, TMemoryBlock& OutBlock)
 	}
 
 #endif
+	Guard.Unlock();
+
 	return Ok;
 }
 
 bool TPageMalloc::AllocateBlock(TSize Size, TMemoryBlock& OutBlock, void* AreaBaseAddr)
 {
+	Guard.Lock();
+
 #if PAGE_MALLOC_STATS
 	++Stats.AllocRequests;
 #endif
 
 	TSize AllocatedSize;
+	bool Untouched = false;
 	void* Ptr = nullptr;
 	bool Ok = false;
-	Ptr = TryAllocateBlock(Size, AllocatedSize, AreaBaseAddr);
+	Ptr = TryAllocateBlock(Size, AllocatedSize, Untouched, AreaBaseAddr);
 
 	if (Ptr)
 	{
-		OutBlock = TMemoryBlock(Ptr, AllocatedSize);
+		OutBlock = TMemoryBlock(Ptr, AllocatedSize, Untouched);
 		Ok = true;
 #if PAGE_MALLOC_STATS
 		Stats.TotalUsedSize += AllocatedSize;
@@ -733,22 +844,28 @@ bool TPageMalloc::AllocateBlock(TSize Size, TMemoryBlock& OutBlock, void* AreaBa
 		++Stats.FailedAllocRequests;
 #endif
 	}
+
+	Guard.Unlock();
+
 	return Ok;
 }
 
 bool TPageMalloc::AllocateBlock(void* Address, TSize Size, TMemoryBlock& OutBlock)
 {
+	Guard.Lock();
+
 #if PAGE_MALLOC_STATS
 	++Stats.AllocRequests;
 #endif
 	TSize AllocatedSize;
+	bool Untouched = false;
 	void* Ptr = nullptr;
 	bool Ok = false;
-	Ptr = TryAllocateBlock(Address, Size, AllocatedSize);
+	Ptr = TryAllocateBlock(Address, Size, AllocatedSize, Untouched);
 
 	if (Ptr)
 	{
-		OutBlock = TMemoryBlock(Address, AllocatedSize);
+		OutBlock = TMemoryBlock(Address, AllocatedSize, Untouched);
 		Ok = true;
 
 #if PAGE_MALLOC_STATS
@@ -773,10 +890,50 @@ bool TPageMalloc::AllocateBlock(void* Address, TSize Size, TMemoryBlock& OutBloc
 #endif
 	}
 
+	Guard.Unlock();
+
 	return Ok;
 }
 
-void* TPageMalloc::TryAllocateBlock(TSize Size, TSize& OutSize, void* AreaBaseAddr)
+bool TPageMalloc::AllocateOwnedBlock(TSize Size, void* Owner, TMemoryBlock& OutBlock)
+{
+	Guard.Lock();
+
+#if PAGE_MALLOC_STATS
+	++Stats.AllocRequests;
+#endif
+
+	TSize AllocatedSize;
+	bool Untouched = false;
+	void* Ptr = TryAllocateBlock(Size, AllocatedSize, Untouched, nullptr, Owner);
+
+	if (Ptr)
+	{
+		OutBlock = TMemoryBlock(Ptr, AllocatedSize, Untouched);
+#if PAGE_MALLOC_STATS
+		Stats.TotalUsedSize += AllocatedSize;
+		if (Size > Stats.MaxBlockSizeToAlloc)
+		{
+			Stats.MaxBlockSizeToAlloc = Size;
+		}
+#endif
+	}
+#if PAGE_MALLOC_STATS
+	else
+	{
+		++Stats.FailedAllocRequests;
+	}
+#endif
+#if PAGE_MALLOC_DEBUG
+	printf("PAGE MALLOC: DBG: Alloc owned memory block: size: %llu owner: 0x%p - [ %s ]\n", Size, Owner, Ptr ? "OK" : "FAILED");
+#endif
+
+	Guard.Unlock();
+
+	return Ptr != nullptr;
+}
+
+void* TPageMalloc::TryAllocateBlock(TSize Size, TSize& OutSize, bool& OutUntouched, void* AreaBaseAddr, void* Owner)
 {
 	void* Ptr = nullptr;
 	if (AreaBaseAddr)
@@ -787,7 +944,7 @@ void* TPageMalloc::TryAllocateBlock(TSize Size, TSize& OutSize, void* AreaBaseAd
 			{
 				if (ArenaTable[i]->Arena.GetArenaBase() == AreaBaseAddr)
 				{
-					Ptr = ArenaTable[i]->Arena.TryMallocBlock(Size, OutSize, nullptr);
+					Ptr = ArenaTable[i]->Arena.TryMallocBlock(Size, OutSize, OutUntouched, nullptr);
 					break;
 				}
 			}
@@ -797,9 +954,9 @@ void* TPageMalloc::TryAllocateBlock(TSize Size, TSize& OutSize, void* AreaBaseAd
 	{
 		for (TSize i = 0; i < PAGE_MALLOC_MAX_ARENA_COUNT; ++i)
 		{
-			if (!ArenaTable[i]->Free)
+			if (!ArenaTable[i]->Free && ArenaTable[i]->Owner == Owner)
 			{
-				Ptr = ArenaTable[i]->Arena.TryMallocBlock(Size, OutSize, nullptr);
+				Ptr = ArenaTable[i]->Arena.TryMallocBlock(Size, OutSize, OutUntouched, nullptr);
 
 				if (Ptr)
 				{
@@ -813,7 +970,7 @@ void* TPageMalloc::TryAllocateBlock(TSize Size, TSize& OutSize, void* AreaBaseAd
 	return Ptr;
 }
 
-void* TPageMalloc::TryAllocateBlock(void* Address, TSize Size, TSize& OutSize)
+void* TPageMalloc::TryAllocateBlock(void* Address, TSize Size, TSize& OutSize, bool& OutUntouched)
 {
 
 	void* Ptr = nullptr;
@@ -823,7 +980,7 @@ void* TPageMalloc::TryAllocateBlock(void* Address, TSize Size, TSize& OutSize)
 		{
 			if (::IsPartOf(Address, ArenaTable[i]->Arena.GetArenaBase(), ArenaTable[i]->Arena.GetArenaSize()))
 			{
-				Ptr = ArenaTable[i]->Arena.TryMallocBlock(Size, OutSize, Address);
+				Ptr = ArenaTable[i]->Arena.TryMallocBlock(Size, OutSize, OutUntouched, Address);
 				break;
 			}
 		}
@@ -833,6 +990,8 @@ void* TPageMalloc::TryAllocateBlock(void* Address, TSize Size, TSize& OutSize)
 
 bool TPageMalloc::FreeBlock(TMemoryBlock Block)
 {
+	Guard.Lock();
+
 #if PAGE_MALLOC_STATS
 	++Stats.FreeRequests;
 #endif
@@ -848,17 +1007,7 @@ bool TPageMalloc::FreeBlock(TMemoryBlock Block)
 			{
 				if (ArenaTable[i]->Arena.IsEmpty())
 				{
-					void* ArenaAddr = ArenaTable[i]->Arena.GetArenaBase();
-					Ok = ArenaTable[i]->Arena.Release();
-
-					if (Ok)
-					{
-						ArenaTable[i]->Free = true;
-					}
-					else
-					{
-						printf("PAGE MALLOC: WARNING: CANNOT RELEASE VM ARENA BACK TO OPERATING SYSTEM: %p; POSSIBLE LACK OF MEMORY\n", ArenaAddr);
-					}
+					Ok = ReleaseArenaSlot(ArenaTable[i]);
 				}
 
 				//Ok = true;
@@ -890,6 +1039,8 @@ bool TPageMalloc::FreeBlock(TMemoryBlock Block)
 	}
 #endif
 
+	Guard.Unlock();
+
 	return Ok;
 }
 
@@ -898,6 +1049,81 @@ bool TPageMalloc::SetProtection(TMemoryBlock Block, TMemoryBlockAccess Protect)
 	return PlatformMalloc->SetMemBlockProtection(TPlatformMemoryBlock(Block.GetBase(), Block.GetSize()), Protect);
 }
 
+bool TPageMalloc::CommitBlock(TMemoryBlock Block)
+{
+	return PlatformMalloc->CommitMemoryBlock(TPlatformMemoryBlock(Block.GetBase(), Block.GetSize()));
+}
+
+bool TPageMalloc::DecommitBlock(TMemoryBlock Block)
+{
+	return PlatformMalloc->DecommitMemoryBlock(TPlatformMemoryBlock(Block.GetBase(), Block.GetSize()));
+}
+
+bool TPageMalloc::PopulateBlock(TMemoryBlock Block)
+{
+	return PlatformMalloc->PopulateMemoryBlock(TPlatformMemoryBlock(Block.GetBase(), Block.GetSize()));
+}
+
+bool TPageMalloc::PurgeBlock(TMemoryBlock Block)
+{
+	return PlatformMalloc->PurgeMemoryBlock(TPlatformMemoryBlock(Block.GetBase(), Block.GetSize()));
+}
+
+TSize TPageMalloc::Purge(void* Owner, TSize& InOutKeepSize)
+{
+	TSize PurgedSize = 0;
+
+	Guard.Lock();
+
+	for (TSize i = 0; i < PAGE_MALLOC_MAX_ARENA_COUNT; ++i)
+	{
+		if (ArenaTable[i]->Free || ArenaTable[i]->Owner != Owner)
+		{
+			continue;
+		}
+
+		if (ArenaTable[i]->Arena.IsEmpty())
+		{
+			TSize ArenaSize = ArenaTable[i]->Arena.GetArenaSize();
+			TSize UnpurgedSize = ArenaTable[i]->Arena.GetUnpurgedSize();
+
+			//	An empty arena is kept as a whole while its resident pages fit into the kept size;
+			if (UnpurgedSize && UnpurgedSize <= InOutKeepSize)
+			{
+				InOutKeepSize -= UnpurgedSize;
+				continue;
+			}
+
+			if (ReleaseArenaSlot(ArenaTable[i]))
+			{
+				PurgedSize += ArenaSize;
+			}
+		}
+		else
+		{
+			PurgedSize += ArenaTable[i]->Arena.Purge(InOutKeepSize);
+		}
+	}
+
+	Guard.Unlock();
+
+#if PAGE_MALLOC_DEBUG
+	printf("PAGE MALLOC: DBG: Purge: size: %llu\n", PurgedSize);
+#endif
+
+	return PurgedSize;
+}
+
+TSize TPageMalloc::GetResidentSize()
+{
+	return PlatformMalloc->GetResidentSize();
+}
+
+bool TPageMalloc::IsMemoryPressure()
+{
+	return PlatformMalloc->IsMemoryPressure();
+}
+
 bool TPageMalloc::IsProtectionSupported()
 {
 	return PlatformMalloc->IsProtectionSupported();
@@ -946,16 +1172,102 @@ bool TPageMalloc::Free()
 	return Ok;
 }
 
+bool TPageMalloc::ReleaseArenaSlot(TArenaSlot* Slot)
+{
+	void* ArenaAddr = Slot->Arena.GetArenaBase();
+	bool Ok = Slot->Arena.Release();
+
+	if (Ok)
+	{
+		Slot->Free = true;
+		Slot->Owner = nullptr;
+	}
+	else
+	{
+		printf("PAGE MALLOC: WARNING: CANNOT RELEASE VM ARENA BACK TO OPERATING SYSTEM: %p; POSSIBLE LACK OF MEMORY\n", ArenaAddr);
+	}
+
+	return Ok;
+}
+
 bool TPageMalloc::Release(void* AreaBaseAddr)
 {
-	// not implemented yet;
-	return true;
+	bool Ok = false;
+
+	Guard.Lock();
+
+	for (TSize i = 0; i < PAGE_MALLOC_MAX_ARENA_COUNT; ++i)
+	{
+		if (!ArenaTable[i]->Free && ArenaTable[i]->Arena.GetArenaBase() == AreaBaseAddr)
+		{
+			Ok = ReleaseArenaSlot(ArenaTable[i]);
+			break;
+		}
+	}
+
+	Guard.Unlock();
+
+	return Ok;
+}
+
+bool TPageMalloc::ReleaseOwned(void* Owner)
+{
+	if (!Owner)
+	{
+		return false;
+	}
+
+	bool Ok = true;
+
+	Guard.Lock();
+
+	for (TSize i = 0; i < PAGE_MALLOC_MAX_ARENA_COUNT; ++i)
+	{
+		if (!ArenaTable[i]->Free && ArenaTable[i]->Owner == Owner)
+		{
+			Ok &= ReleaseArenaSlot(ArenaTable[i]);
+		}
+	}
+
+	Guard.Unlock();
+
+#if PAGE_MALLOC_DEBUG
+	printf("PAGE MALLOC: DBG: Release arenas of owner: 0x%p - [ %s ]\n", Owner, Ok ? "OK" : "FAILED");
+#endif
+
+	return Ok;
+}
+
+bool TPageMalloc::ReleaseShared()
+{
+	bool Ok = true;
+
+	Guard.Lock();
+
+	for (TSize i = 0; i < PAGE_MALLOC_MAX_ARENA_COUNT; ++i)
+	{
+		if (!ArenaTable[i]->Free && !ArenaTable[i]->Owner)
+		{
+			Ok &= ReleaseArenaSlot(ArenaTable[i]);
+		}
+	}
+
+	Guard.Unlock();
+
+#if PAGE_MALLOC_DEBUG
+	printf("PAGE MALLOC: DBG: Release shared arenas - [ %s ]\n", Ok ? "OK" : "FAILED");
+#endif
+
+	return Ok;
 }
 
 bool TPageMalloc::Release()
 {
 
 	bool Ok = false;
+
+	Guard.Lock();
+
 	for (TSize i = 0; i < PAGE_MALLOC_MAX_ARENA_COUNT; ++i)
 	{
 		if (!ArenaTable[i]->Free)
@@ -964,6 +1276,7 @@ bool TPageMalloc::Release()
 			if (Ok)
 			{
 				ArenaTable[i]->Free = true;
+				ArenaTable[i]->Owner = nullptr;
 			}
 			else
 			{
@@ -974,6 +1287,8 @@ bool TPageMalloc::Release()
 		}
 	}
 
+	Guard.Unlock();
+
 #if PAGE_MALLOC_DEBUG
 	if (Ok)
 	{
@@ -1009,6 +1324,29 @@ void TPageMalloc::GetStats(TPageMallocStats& OutStats)
 #endif
 }
 
+TSize TPageMalloc::GetArenaStats(TPageMallocArenaStats* OutStats, TSize MaxCount)
+{
+	TSize Count = 0;
+
+	Guard.Lock();
+
+	for (TSize i = 0; i < PAGE_MALLOC_MAX_ARENA_COUNT && Count < MaxCount; ++i)
+	{
+		if (ArenaTable[i]->Free)
+		{
+			continue;
+		}
+
+		ArenaTable[i]->Arena.GetStats(OutStats[Count]);
+		OutStats[Count].Owned = ArenaTable[i]->Owner != nullptr;
+		++Count;
+	}
+
+	Guard.Unlock();
+
+	return Count;
+}
+
 bool TPageMalloc::TArenaTable::Init(IPlatformMalloc* PlatformMalloc, TSize ArenaCount)
 {
 	TSize DataBlockSize = AlignToUpper(ArenaSlotSize * ArenaCount, PlatformMalloc->GetPageSize());
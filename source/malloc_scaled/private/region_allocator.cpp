@@ -0,0 +1,290 @@
+#include "region_allocator.h"
+#include "align.h"
+#include "zero_memory.h"
+
+TRegionAllocator::TRegionAllocator() :
+	Base(nullptr),
+	Top(nullptr),
+	CommitEnd(nullptr),
+	End(nullptr),
+	LastBlock(nullptr),
+	LastTop(nullptr),
+	CommitSize(0)
+{
+}
+
+TRegionAllocator::~TRegionAllocator()
+{
+	Release();
+}
+
+bool TRegionAllocator::Init(TSize ReserveSize, TSize CommitSize)
+{
+	if (Base || !ReserveSize || !TVMBlock::Init())
+	{
+		return false;
+	}
+
+	TSize PageSize = TVMBlock::GetPageSize();
+	ReserveSize = AlignToUpper(ReserveSize, PageSize);
+	CommitSize = AlignToUpper(CommitSize ? CommitSize : REGION_DEFAULT_COMMIT_SIZE, PageSize);
+
+	if (!VMBlock.Allocate(ReserveSize))
+	{
+		return false;
+	}
+
+	Base = (uint8*)VMBlock.GetBase();
+	End = (uint8*)VMBlock.GetEnd();
+	Top = Base;
+	LastBlock = nullptr;
+	LastTop = nullptr;
+	this->CommitSize = CommitSize < (TSize)(End - Base) ? CommitSize : End - Base;
+
+	//	Arena pages come committed, only the first chunk is kept until the region grows into the rest;
+	CommitEnd = Base + this->CommitSize;
+
+	if (CommitEnd < End)
+	{
+		VMBlock.Decommit(CommitEnd, End - CommitEnd);
+	}
+
+#ifdef MALLOC_SCALED_DEBUG
+	printf("MALLOC: DBG: REGION INIT: Base: %p, Reserved: %llu, Commit step: %llu\n", Base, (uint64)(End - Base), (uint64)this->CommitSize);
+#endif
+
+	return true;
+}
+
+void TRegionAllocator::Release()
+{
+	if (!Base)
+	{
+		return;
+	}
+
+	//	The block goes back to its arena, which expects its free pages to be committed;
+	if (CommitEnd < End)
+	{
+		VMBlock.Commit(CommitEnd, End - CommitEnd);
+	}
+
+	VMBlock.Free();
+
+	Base = nullptr;
+	Top = nullptr;
+	CommitEnd = nullptr;
+	End = nullptr;
+	LastBlock = nullptr;
+	LastTop = nullptr;
+}
+
+bool TRegionAllocator::CommitTo(uint8* NewTop)
+{
+	if (NewTop <= CommitEnd)
+	{
+		return true;
+	}
+
+	if (NewTop > End)
+	{
+		return false;
+	}
+
+	uint8* NewCommitEnd = Base + AlignToUpper((TSize)(NewTop - Base), CommitSize);
+
+	if (NewCommitEnd > End)
+	{
+		NewCommitEnd = End;
+	}
+
+	if (!VMBlock.Commit(CommitEnd, NewCommitEnd - CommitEnd))
+	{
+		return false;
+	}
+
+	CommitEnd = NewCommitEnd;
+
+	return true;
+}
+
+void* TRegionAllocator::Malloc(TSize Size, TSize Alignment)
+{
+	if (!Base || !Size)
+	{
+		return nullptr;
+	}
+
+	if (Alignment < REGION_DEFAULT_ALIGNMENT)
+	{
+		Alignment = REGION_DEFAULT_ALIGNMENT;
+	}
+
+	if (!IsPow2(Alignment) || Alignment > TVMBlock::GetPageSize())
+	{
+		return nullptr;
+	}
+
+	TSize Room = End - Top;
+	uint8* Block = AlignToUpper(Top + BlockHdrSize, Alignment);
+
+	if ((TSize)(Block - Top) > Room || Size > Room - (Block - Top))
+	{
+		return nullptr;
+	}
+
+	uint8* NewTop = Block + Size;
+
+	if (!CommitTo(NewTop))
+	{
+		return nullptr;
+	}
+
+	((TRegionBlockHdr*)Block - 1)->Size = Size;
+
+	LastBlock = Block;
+	LastTop = Top;
+	Top = NewTop;
+
+	return Block;
+}
+
+void* TRegionAllocator::Calloc(TSize Count, TSize Size, TSize Alignment)
+{
+	if (Size && Count > std::numeric_limits<TSize>::max() / Size)
+	{
+		return nullptr;
+	}
+
+	TSize TotalSize = Count * Size;
+	void* Block = Malloc(TotalSize, Alignment);
+
+	if (Block)
+	{
+		ZeroMemoryBlock(Block, TotalSize);
+	}
+
+	return Block;
+}
+
+void* TRegionAllocator::Realloc(void* Addr, TSize NewSize, TSize NewAlignment)
+{
+	if (!Addr)
+	{
+		return Malloc(NewSize, NewAlignment);
+	}
+
+	if (!NewSize)
+	{
+		Free(Addr);
+		return nullptr;
+	}
+
+	TRegionBlockHdr* Hdr = (TRegionBlockHdr*)Addr - 1;
+
+	//	The last block grows and shrinks in place;
+	if (Addr == LastBlock && IsAligned(Addr, NewAlignment ? NewAlignment : REGION_DEFAULT_ALIGNMENT))
+	{
+		if (NewSize <= Hdr->Size || (NewSize - Hdr->Size <= (TSize)(End - Top) && CommitTo(Top + (NewSize - Hdr->Size))))
+		{
+			Top = (uint8*)Addr + NewSize;
+			Hdr->Size = NewSize;
+			return Addr;
+		}
+
+		return nullptr;
+	}
+
+	if (NewSize <= Hdr->Size && IsAligned(Addr, NewAlignment ? NewAlignment : REGION_DEFAULT_ALIGNMENT))
+	{
+		Hdr->Size = NewSize;
+		return Addr;
+	}
+
+	void* NewAddr = Malloc(NewSize, NewAlignment);
+
+	if (NewAddr)
+	{
+		memcpy(NewAddr, Addr, NewSize < Hdr->Size ? NewSize : Hdr->Size);
+	}
+
+	return NewAddr;
+}
+
+void TRegionAllocator::Free(void* Addr)
+{
+	if (Addr && Addr == LastBlock)
+	{
+		Top = LastTop;
+		LastBlock = nullptr;
+		LastTop = nullptr;
+	}
+}
+
+TSize TRegionAllocator::GetSize(void* Addr)
+{
+	if (!Addr)
+	{
+		return 0;
+	}
+
+	return ((TRegionBlockHdr*)Addr - 1)->Size;
+}
+
+TRegionMark TRegionAllocator::Mark()
+{
+	return TRegionMark{ Top };
+}
+
+void TRegionAllocator::Rollback(TRegionMark Mark)
+{
+	if (Mark.Top < Base || Mark.Top > Top)
+	{
+		return;
+	}
+
+	Top = Mark.Top;
+
+	if (LastBlock && LastBlock > Top)
+	{
+		LastBlock = nullptr;
+		LastTop = nullptr;
+	}
+}
+
+void TRegionAllocator::Reset(bool Decommit)
+{
+	Top = Base;
+	LastBlock = nullptr;
+	LastTop = nullptr;
+
+	if (Decommit && Base)
+	{
+		uint8* KeepEnd = Base + CommitSize;
+
+		if (CommitEnd > KeepEnd && VMBlock.Decommit(KeepEnd, CommitEnd - KeepEnd))
+		{
+			CommitEnd = KeepEnd;
+		}
+	}
+}
+
+bool TRegionAllocator::IsInitialized()
+{
+	return Base != nullptr;
+}
+
+TSize TRegionAllocator::GetUsedSize()
+{
+	return Top - Base;
+}
+
+TSize TRegionAllocator::GetCommittedSize()
+{
+	return CommitEnd - Base;
+}
+
+TSize TRegionAllocator::GetReservedSize()
+{
+	return End - Base;
+}
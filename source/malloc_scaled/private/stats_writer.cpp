@@ -0,0 +1,147 @@
+#include "stats_writer.h"
+
+#include <cstdio>
+#include <cstdarg>
+
+static const TSize STATS_WRITER_LINE_SIZE = 256; // Bytes;
+
+struct TSizeClassStatsKey
+{
+	const char* Name;
+	const char* Type; // Prometheus metric type;
+	const char* Help;
+	TSize TSizeClassStats::* Value;
+};
+
+struct TArenaStatsKey
+{
+	const char* Name;
+	const char* Help;
+	TSize TPageMallocArenaStats::* Value;
+};
+
+static const TSizeClassStatsKey SizeClassStatsKeys[] =
+{
+	{ "pools",           "gauge",   "Pools in use",                               &TSizeClassStats::PoolCount       },
+	{ "cached_pools",    "gauge",   "Empty pools kept by the pool cache",         &TSizeClassStats::CachedPoolCount },
+	{ "spare_pools",     "gauge",   "Pools made ready by the background thread",  &TSizeClassStats::SparePoolCount  },
+	{ "blocks",          "gauge",   "Blocks of the pools in use",                 &TSizeClassStats::TotalBlockCount },
+	{ "used_blocks",     "gauge",   "Blocks handed out",                          &TSizeClassStats::UsedBlockCount  },
+	{ "free_blocks",     "gauge",   "Blocks ready to be handed out",              &TSizeClassStats::FreeBlockCount  },
+	{ "requested_bytes", "gauge",   "Requested bytes of the used blocks",         &TSizeClassStats::RequestedSize   },
+	{ "consumed_bytes",  "gauge",   "Block bytes of the used blocks",             &TSizeClassStats::ConsumedSize    },
+	{ "mapped_bytes",    "gauge",   "Bytes of the pools in use",                  &TSizeClassStats::MappedSize      },
+	{ "mallocs",         "counter", "Blocks allocated since the start",           &TSizeClassStats::MallocCount     },
+	{ "frees",           "counter", "Blocks freed since the start",               &TSizeClassStats::FreeCount       }
+};
+
+static const TArenaStatsKey ArenaStatsKeys[] =
+{
+	{ "reserved_bytes",   "Bytes reserved by the arena",       &TPageMallocArenaStats::ReservedSize   },
+	{ "used_bytes",       "Bytes of the blocks handed out",    &TPageMallocArenaStats::UsedSize       },
+	{ "free_bytes",       "Bytes of the free runs",            &TPageMallocArenaStats::FreeSize       },
+	{ "free_runs",        "Free runs the free bytes split in", &TPageMallocArenaStats::FreeRunCount   },
+	{ "largest_free_run", "Bytes of the largest free run",     &TPageMallocArenaStats::LargestFreeRun },
+	{ "blocks",           "Blocks handed out",                 &TPageMallocArenaStats::BlockCount     }
+};
+
+static void WriteLine(TMallocWriter Writer, void* Context, const char* Format, ...)
+{
+	char Line[STATS_WRITER_LINE_SIZE];
+
+	va_list Args;
+	va_start(Args, Format);
+	int32 Length = vsnprintf(Line, sizeof(Line), Format, Args);
+	va_end(Args);
+
+	if (Length > 0)
+	{
+		Writer(Line, (TSize)Length < sizeof(Line) ? Length : sizeof(Line) - 1, Context);
+	}
+}
+
+static void WriteJson(const TSizeClassStats* Classes, TSize ClassCount,
+	const TPageMallocArenaStats* Arenas, TSize ArenaCount, TMallocWriter Writer, void* Context)
+{
+	WriteLine(Writer, Context, "{\n\t\"size_classes\": [");
+
+	for (TSize i = 0; i < ClassCount; ++i)
+	{
+		WriteLine(Writer, Context, "%s\n\t\t{ \"block_size\": %zu", i ? "," : "", Classes[i].BlockSize);
+
+		for (const TSizeClassStatsKey& Key : SizeClassStatsKeys)
+		{
+			WriteLine(Writer, Context, ", \"%s\": %zu", Key.Name, Classes[i].*Key.Value);
+		}
+
+		WriteLine(Writer, Context, " }");
+	}
+
+	WriteLine(Writer, Context, "\n\t],\n\t\"arenas\": [");
+
+	for (TSize i = 0; i < ArenaCount; ++i)
+	{
+		WriteLine(Writer, Context, "%s\n\t\t{ \"base\": \"0x%llx\", \"owned\": %s", i ? "," : "",
+			(uint64)Arenas[i].Base, Arenas[i].Owned ? "true" : "false");
+
+		for (const TArenaStatsKey& Key : ArenaStatsKeys)
+		{
+			WriteLine(Writer, Context, ", \"%s\": %zu", Key.Name, Arenas[i].*Key.Value);
+		}
+
+		WriteLine(Writer, Context, " }");
+	}
+
+	WriteLine(Writer, Context, "\n\t]\n}\n");
+}
+
+//	Text exposition format: every metric is written once with a sample per size class or arena;
+static void WritePrometheus(const TSizeClassStats* Classes, TSize ClassCount,
+	const TPageMallocArenaStats* Arenas, TSize ArenaCount, TMallocWriter Writer, void* Context)
+{
+	for (const TSizeClassStatsKey& Key : SizeClassStatsKeys)
+	{
+		const char* Suffix = Key.Type[0] == 'c' ? "_total" : "";
+
+		WriteLine(Writer, Context, "# HELP malloc_scaled_class_%s%s %s.\n", Key.Name, Suffix, Key.Help);
+		WriteLine(Writer, Context, "# TYPE malloc_scaled_class_%s%s %s\n", Key.Name, Suffix, Key.Type);
+
+		for (TSize i = 0; i < ClassCount; ++i)
+		{
+			WriteLine(Writer, Context, "malloc_scaled_class_%s%s{block_size=\"%zu\"} %zu\n", Key.Name, Suffix, Classes[i].BlockSize, Classes[i].*Key.Value);
+		}
+	}
+
+	for (const TArenaStatsKey& Key : ArenaStatsKeys)
+	{
+		WriteLine(Writer, Context, "# HELP malloc_scaled_arena_%s %s.\n", Key.Name, Key.Help);
+		WriteLine(Writer, Context, "# TYPE malloc_scaled_arena_%s gauge\n", Key.Name);
+
+		for (TSize i = 0; i < ArenaCount; ++i)
+		{
+			WriteLine(Writer, Context, "malloc_scaled_arena_%s{base=\"0x%llx\",owned=\"%s\"} %zu\n", Key.Name,
+				(uint64)Arenas[i].Base, Arenas[i].Owned ? "true" : "false", Arenas[i].*Key.Value);
+		}
+	}
+}
+
+bool WriteMallocStats(EMallocStatsFormat Format, const TSizeClassStats* Classes, TSize ClassCount,
+	const TPageMallocArenaStats* Arenas, TSize ArenaCount, TMallocWriter Writer, void* Context)
+{
+	if (!Writer)
+	{
+		return false;
+	}
+
+	switch (Format)
+	{
+	case MALLOC_STATS_FORMAT_JSON:
+		WriteJson(Classes, ClassCount, Arenas, ArenaCount, Writer, Context);
+		return true;
+	case MALLOC_STATS_FORMAT_PROMETHEUS:
+		WritePrometheus(Classes, ClassCount, Arenas, ArenaCount, Writer, Context);
+		return true;
+	}
+
+	return false;
+}
@@ -6,6 +6,41 @@
 
 #include <sys/mman.h>
 #include <unistd.h>
+#include <fcntl.h>
+
+static const uint64 UNIX_PRESSURE_SOME_AVG10   = 10; // Percent of the last 10 s some task stalled on memory;
+static const uint64 UNIX_PRESSURE_CGROUP_RATIO = 90; // Percent of memory.high;
+
+//	Reads a small proc or sysfs file without stdio, which could allocate;
+static TSize ReadSmallFile(const char* Path, char* OutBuf, TSize BufSize)
+{
+	int32 Fd = open(Path, O_RDONLY);
+
+	if (Fd < 0)
+	{
+		return 0;
+	}
+
+	ssize_t Length = read(Fd, OutBuf, BufSize - 1);
+	close(Fd);
+
+	Length = Length > 0 ? Length : 0;
+	OutBuf[Length] = 0;
+
+	return Length;
+}
+
+static uint64 ParseUInt(const char* Str)
+{
+	uint64 Value = 0;
+
+	while (*Str >= '0' && *Str <= '9')
+	{
+		Value = Value * 10 + (*Str++ - '0');
+	}
+
+	return Value;
+}
 
 int32 TUnixPlatformMalloc::TranslatePageProtection(TMemoryBlockAccess Access)
 {
@@ -90,14 +125,98 @@ bool TUnixPlatformMalloc::AllocateMemoryBlock(void* Address, TSize Size, TPlatfo
 
 bool TUnixPlatformMalloc::CommitMemoryBlock(TPlatformMemoryBlock InBlock)
 {
+	//	Mapped pages are committed by the first touch;
 	return true;
 }
 
 bool TUnixPlatformMalloc::DecommitMemoryBlock(TPlatformMemoryBlock InBlock)
 {
+	if (!InBlock.GetBase())
+	{
+		return false;
+	}
+
+	//	Pages stay mapped and read as zero on the next touch;
+	return !madvise(InBlock.GetBase(), InBlock.GetSize(), MADV_DONTNEED);
+}
+
+bool TUnixPlatformMalloc::PopulateMemoryBlock(TPlatformMemoryBlock InBlock)
+{
+	if (!InBlock.GetBase())
+	{
+		return false;
+	}
+
+#ifdef MADV_POPULATE_WRITE
+	if (!madvise(InBlock.GetBase(), InBlock.GetSize(), MADV_POPULATE_WRITE))
+	{
+		return true;
+	}
+#endif
+
+	//	Kernels before 5.14 have no MADV_POPULATE_WRITE, the pages are written in place;
+	for (volatile uint8* Page = (uint8*)InBlock.GetBase(); Page < (uint8*)InBlock.GetEnd(); Page += PageSize)
+	{
+		*Page = *Page;
+	}
+
 	return true;
 }
 
+bool TUnixPlatformMalloc::PurgeMemoryBlock(TPlatformMemoryBlock InBlock)
+{
+	if (!InBlock.GetBase())
+	{
+		return false;
+	}
+
+	return !madvise(InBlock.GetBase(), InBlock.GetSize(), MADV_DONTNEED);
+}
+
+TSize TUnixPlatformMalloc::GetResidentSize()
+{
+	char Buf[128];
+
+	if (!ReadSmallFile("/proc/self/statm", Buf, sizeof(Buf)))
+	{
+		return 0;
+	}
+
+	//	statm: size resident shared text lib data dt, in pages;
+	const char* Resident = strchr(Buf, ' ');
+
+	return Resident ? ParseUInt(Resident + 1) * PageSize : 0;
+}
+
+bool TUnixPlatformMalloc::IsMemoryPressure()
+{
+	char Buf[256];
+
+	//	PSI, kernels from 4.20: "some avg10=1.23 avg60=... total=...";
+	if (ReadSmallFile("/proc/pressure/memory", Buf, sizeof(Buf)))
+	{
+		const char* Avg10 = strstr(Buf, "avg10=");
+
+		if (Avg10 && ParseUInt(Avg10 + 6) >= UNIX_PRESSURE_SOME_AVG10)
+		{
+			return true;
+		}
+	}
+
+	//	cgroup v2 starts throttling and reclaiming the group above memory.high;
+	if (ReadSmallFile("/sys/fs/cgroup/memory.high", Buf, sizeof(Buf)) && Buf[0] >= '0' && Buf[0] <= '9')
+	{
+		uint64 High = ParseUInt(Buf);
+
+		if (ReadSmallFile("/sys/fs/cgroup/memory.current", Buf, sizeof(Buf)))
+		{
+			return ParseUInt(Buf) * 100 >= High * UNIX_PRESSURE_CGROUP_RATIO;
+		}
+	}
+
+	return false;
+}
+
 bool TUnixPlatformMalloc::SetMemBlockProtection(TPlatformMemoryBlock InBlock, TMemoryBlockAccess ProtFlag)
 {
 	if (!InBlock.GetBase())
@@ -133,7 +252,7 @@ bool TUnixPlatformMalloc::DeallocateMemoryBlock(TPlatformMemoryBlock InBlock)
 		return false;
 	}
 
-	bool Ok = munmap(InBlock.GetBase(), InBlock.GetSize());
+	bool Ok = !munmap(InBlock.GetBase(), InBlock.GetSize());
 
 	return Ok;
 }
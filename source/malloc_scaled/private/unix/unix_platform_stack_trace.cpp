@@ -0,0 +1,61 @@
+#include "unix\unix_platform_stack_trace.h"
+
+#if PLATFORM_UNIX
+
+#include <execinfo.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+static const TSize UNIX_STACK_TRACE_MAX_FRAMES = 128;
+static const TSize UNIX_MODULE_MAP_CHUNK_SIZE  = 4096; // Bytes;
+
+void TUnixPlatformStackTrace::Init()
+{
+	//	glibc loads libgcc_s with malloc on the first backtrace, which must not happen under the allocator lock;
+	void* Frame = nullptr;
+	backtrace(&Frame, 1);
+}
+
+TSize TUnixPlatformStackTrace::Capture(void** OutFrames, TSize MaxCount, TSize SkipCount)
+{
+	void* Frames[UNIX_STACK_TRACE_MAX_FRAMES];
+
+	//	The frame of Capture itself is skipped as well;
+	TSize Skip = SkipCount + 1;
+	TSize Wanted = MaxCount + Skip < UNIX_STACK_TRACE_MAX_FRAMES ? MaxCount + Skip : UNIX_STACK_TRACE_MAX_FRAMES;
+	int32 Count = backtrace(Frames, (int32)Wanted);
+
+	if (Count <= (int32)Skip)
+	{
+		return 0;
+	}
+
+	TSize FrameCount = Count - Skip;
+	memcpy(OutFrames, Frames + Skip, FrameCount * sizeof(void*));
+
+	return FrameCount;
+}
+
+bool TUnixPlatformStackTrace::WriteModuleMap(TMallocWriter Writer, void* Context)
+{
+	int32 Fd = open("/proc/self/maps", O_RDONLY);
+
+	if (Fd < 0)
+	{
+		return false;
+	}
+
+	char Buf[UNIX_MODULE_MAP_CHUNK_SIZE];
+	ssize_t Read = 0;
+
+	while ((Read = read(Fd, Buf, sizeof(Buf))) > 0)
+	{
+		Writer(Buf, Read, Context);
+	}
+
+	close(Fd);
+
+	return Read == 0;
+}
+
+#endif
@@ -3,11 +3,11 @@
 
 IPageMalloc* TVMBlock::PageMalloc   = nullptr;
 
-bool TVMBlock::Init()
+bool TVMBlock::Init(TSize ArenaPageSize, TSize ArenaSize)
 {
 	if (!PageMalloc)
 	{
-		PageMalloc = TPageMalloc::GetPageMalloc();
+		PageMalloc = TPageMalloc::GetPageMalloc(ArenaPageSize, ArenaSize);
 		if (!PageMalloc)
 		{
 			return false;
@@ -25,22 +25,22 @@ void TVMBlock::Release()
 	}
 }
 
-bool TVMBlock::Allocate(TSize Size)
+bool TVMBlock::Allocate(TSize Size, TSize ArenaSize, void* ArenaOwner)
 {
 	bool Ok = false;
 
 	if (PageMalloc)
 	{
-		Ok = PageMalloc->AllocateBlock(Size, VMBlock);
+		Ok = ArenaOwner ? PageMalloc->AllocateOwnedBlock(Size, ArenaOwner, VMBlock) : PageMalloc->AllocateBlock(Size, VMBlock);
 		
 		if (!Ok)
 		{
 			TMemoryBlock Block;
-			Ok = PageMalloc->Reserve(Size, Block);
+			Ok = PageMalloc->Reserve(Size > ArenaSize ? Size : ArenaSize, Block, ArenaOwner);
 
 			if (Ok)
 			{
-				Ok = PageMalloc->AllocateBlock(Size, VMBlock);
+				Ok = ArenaOwner ? PageMalloc->AllocateOwnedBlock(Size, ArenaOwner, VMBlock) : PageMalloc->AllocateBlock(Size, VMBlock);
 			}
 		}
 
@@ -54,6 +54,26 @@ bool TVMBlock::Allocate(TSize Size)
 	return false;
 }
 
+bool TVMBlock::ReleaseArenas(void* ArenaOwner)
+{
+	if (PageMalloc)
+	{
+		return PageMalloc->ReleaseOwned(ArenaOwner);
+	}
+
+	return false;
+}
+
+bool TVMBlock::ReleaseSharedArenas()
+{
+	if (PageMalloc)
+	{
+		return PageMalloc->ReleaseShared();
+	}
+
+	return false;
+}
+
 bool TVMBlock::Allocate(void* Address, TSize Size)
 {
 	return false;
@@ -88,6 +108,66 @@ bool TVMBlock::SetProtection(void* Offset, TSize Size, TMemoryBlockAccess Access
 	return false;
 }
 
+bool TVMBlock::Commit(void* Offset, TSize Size)
+{
+	if (PageMalloc)
+	{
+		return PageMalloc->CommitBlock(TMemoryBlock{ Offset, Size });
+	}
+
+	return false;
+}
+
+bool TVMBlock::Decommit(void* Offset, TSize Size)
+{
+	if (PageMalloc)
+	{
+		return PageMalloc->DecommitBlock(TMemoryBlock{ Offset, Size });
+	}
+
+	return false;
+}
+
+bool TVMBlock::Purge(void* Offset, TSize Size)
+{
+	if (PageMalloc)
+	{
+		return PageMalloc->PurgeBlock(TMemoryBlock{ Offset, Size });
+	}
+
+	return false;
+}
+
+bool TVMBlock::Populate()
+{
+	if (PageMalloc && Allocated)
+	{
+		return PageMalloc->PopulateBlock(VMBlock);
+	}
+
+	return false;
+}
+
+TSize TVMBlock::PurgeArenas(void* ArenaOwner, TSize& InOutKeepSize)
+{
+	return PageMalloc ? PageMalloc->Purge(ArenaOwner, InOutKeepSize) : 0;
+}
+
+TSize TVMBlock::GetResidentSize()
+{
+	return PageMalloc ? PageMalloc->GetResidentSize() : 0;
+}
+
+bool TVMBlock::IsMemoryPressure()
+{
+	return PageMalloc ? PageMalloc->IsMemoryPressure() : false;
+}
+
+TSize TVMBlock::GetArenaStats(TPageMallocArenaStats* OutStats, TSize MaxCount)
+{
+	return PageMalloc ? PageMalloc->GetArenaStats(OutStats, MaxCount) : 0;
+}
+
 bool TVMBlock::IsPagingSupported()
 {
 	return (bool)PageMalloc->GetPageSize();
@@ -103,6 +183,11 @@ TSize TVMBlock::GetPageSize()
 	return PageMalloc->GetPageSize();
 }
 
+TSize TVMBlock::GetGranularity()
+{
+	return PageMalloc->GetGranularity();
+}
+
 bool TVMBlock::IsAllocated()
 {
 	return Allocated;
@@ -113,6 +198,11 @@ TSize TVMBlock::GetAllocatedSize()
 	return VMBlock.GetSize();
 }
 
+bool TVMBlock::IsUntouched()
+{
+	return VMBlock.IsUntouched();
+}
+
 void* TVMBlock::GetBase()
 {
 	return VMBlock.GetBase();
@@ -1,6 +1,7 @@
 
 #include "build.h"
 #include "lib_malloc.h"
+#include "malloc_scaled.h"
 
 #if PLATFORM_WIN
 #include "win.h"
@@ -21,6 +22,8 @@ BOOL WINAPI DllMain(HINSTANCE hinstDLL, DWORD fdwReason, LPVOID lpvReserved)
     case DLL_THREAD_DETACH:      
         break;
     case DLL_PROCESS_DETACH:
+        //  The process is exiting and has ended the other threads already;
+        GMallocProcessExiting = lpvReserved != NULL;
 #if !defined(MALLOC_DEBUG) && !defined(MALLOC_STATS) && !defined(MALLOC_TIME_STATS)
         ShutdownMalloc(); 
 #endif
@@ -4,6 +4,8 @@
 
 #if PLATFORM_WIN
 
+#include <psapi.h>
+
 DWORD TWinPlatformMalloc::TranslatePageProtection(TMemoryBlockAccess Access)
 {
 	DWORD Pr = 0;
@@ -44,9 +46,23 @@ bool TWinPlatformMalloc::Init()
 
 	bIsProtectionSupported = true;
 
+	if (!LowMemoryNotification)
+	{
+		LowMemoryNotification = CreateMemoryResourceNotification(LowMemoryResourceNotification);
+	}
+
 	return true;
 }
 
+TWinPlatformMalloc::~TWinPlatformMalloc()
+{
+	if (LowMemoryNotification)
+	{
+		CloseHandle(LowMemoryNotification);
+		LowMemoryNotification = nullptr;
+	}
+}
+
 bool TWinPlatformMalloc::AllocateMemoryBlock(TSize Size, TPlatformMemoryBlock& OutBlock)
 {
 	if (!Size)
@@ -157,8 +173,73 @@ bool TWinPlatformMalloc::DecommitMemoryBlock(TPlatformMemoryBlock InBlock)
 
 	return (bool)Ok;
 }
+
+bool TWinPlatformMalloc::PopulateMemoryBlock(TPlatformMemoryBlock InBlock)
+{
+	if (!InBlock.GetBase())
+	{
+		return false;
+	}
+
+	//	A demand zero page gets its frame on the first write;
+	for (volatile uint8* Page = (uint8*)InBlock.GetBase(); Page < (uint8*)InBlock.GetEnd(); Page += PageSize)
+	{
+		*Page = *Page;
+	}
+
+	return true;
+}
+
+bool TWinPlatformMalloc::PurgeMemoryBlock(TPlatformMemoryBlock InBlock)
+{
+	if (!InBlock.GetBase())
+	{
+		return false;
+	}
+
+	//	Discarded pages stay committed but leave the working set and give their frames back,
+	//	the next access gets zero pages;
+	if (DiscardVirtualMemory(InBlock.GetBase(), InBlock.GetSize()) == ERROR_SUCCESS)
+	{
+		return true;
+	}
+
+	//	MEM_RESET alone keeps the pages in the working set, unlocking pages that are not locked drops them from it;
+	if (!VirtualAlloc(InBlock.GetBase(), InBlock.GetSize(), MEM_RESET, PAGE_READWRITE))
+	{
+		return false;
+	}
+
+	VirtualUnlock(InBlock.GetBase(), InBlock.GetSize());
+
+	return true;
+}
 #pragma warning(default:6250)
 
+TSize TWinPlatformMalloc::GetResidentSize()
+{
+	PROCESS_MEMORY_COUNTERS Counters = {};
+
+	if (!K32GetProcessMemoryInfo(GetCurrentProcess(), &Counters, sizeof(Counters)))
+	{
+		return 0;
+	}
+
+	return Counters.WorkingSetSize;
+}
+
+bool TWinPlatformMalloc::IsMemoryPressure()
+{
+	BOOL LowMemory = FALSE;
+
+	if (!LowMemoryNotification || !QueryMemoryResourceNotification(LowMemoryNotification, &LowMemory))
+	{
+		return false;
+	}
+
+	return LowMemory != FALSE;
+}
+
 bool TWinPlatformMalloc::SetMemBlockProtection(TPlatformMemoryBlock InBlock, TMemoryBlockAccess ProtFlag)
 {
 	if (!InBlock.GetBase())
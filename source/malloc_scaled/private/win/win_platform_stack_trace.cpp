@@ -0,0 +1,64 @@
+#include "win\win_platform_stack_trace.h"
+
+#if PLATFORM_WIN
+
+#include "win.h"
+#include <psapi.h>
+#include <cstdio>
+
+static const TSize WIN_STACK_TRACE_MAX_FRAMES = 62; // CaptureStackBackTrace limit on older systems;
+static const TSize WIN_MODULE_MAP_MAX_COUNT   = 1024;
+
+void TWinPlatformStackTrace::Init()
+{
+}
+
+TSize TWinPlatformStackTrace::Capture(void** OutFrames, TSize MaxCount, TSize SkipCount)
+{
+	if (MaxCount > WIN_STACK_TRACE_MAX_FRAMES)
+	{
+		MaxCount = WIN_STACK_TRACE_MAX_FRAMES;
+	}
+
+	//	The frame of Capture itself is skipped as well;
+	return RtlCaptureStackBackTrace((DWORD)(SkipCount + 1), (DWORD)MaxCount, OutFrames, nullptr);
+}
+
+bool TWinPlatformStackTrace::WriteModuleMap(TMallocWriter Writer, void* Context)
+{
+	HANDLE Process = GetCurrentProcess();
+	HMODULE Modules[WIN_MODULE_MAP_MAX_COUNT];
+	DWORD Needed = 0;
+
+	if (!K32EnumProcessModules(Process, Modules, sizeof(Modules), &Needed))
+	{
+		return false;
+	}
+
+	TSize ModuleCount = Needed / sizeof(HMODULE) < WIN_MODULE_MAP_MAX_COUNT ? Needed / sizeof(HMODULE) : WIN_MODULE_MAP_MAX_COUNT;
+
+	for (TSize i = 0; i < ModuleCount; ++i)
+	{
+		MODULEINFO Info;
+		char Path[MAX_PATH];
+
+		if (!K32GetModuleInformation(Process, Modules[i], &Info, sizeof(Info)) ||
+			!K32GetModuleFileNameExA(Process, Modules[i], Path, sizeof(Path)))
+		{
+			continue;
+		}
+
+		char Line[MAX_PATH + 96];
+		int32 Length = snprintf(Line, sizeof(Line), "%016llx-%016llx r-xp 00000000 00:00 0 %s\n",
+			(uint64)Info.lpBaseOfDll, (uint64)Info.lpBaseOfDll + Info.SizeOfImage, Path);
+
+		if (Length > 0)
+		{
+			Writer(Line, (TSize)Length < sizeof(Line) ? Length : sizeof(Line) - 1, Context);
+		}
+	}
+
+	return true;
+}
+
+#endif
@@ -0,0 +1,135 @@
+#include "zero_memory.h"
+#include "align.h"
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define ZERO_MEMORY_X64 1
+#include <immintrin.h>
+#if !defined(_MSC_VER)
+#include <cpuid.h>
+#endif
+#else
+#define ZERO_MEMORY_X64 0
+#endif
+
+#if ZERO_MEMORY_X64
+
+#if defined(_MSC_VER)
+#define ZERO_MEMORY_TARGET_AVX2
+#else
+#define ZERO_MEMORY_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+static const TSize ZERO_MEMORY_STREAM_ALIGNMENT = 64; // Bytes;
+
+static bool IsAVX2Supported()
+{
+	uint32 Regs[4] = {};
+
+#if defined(_MSC_VER)
+	__cpuid((int32*)Regs, 0);
+	if (Regs[0] < 7)
+	{
+		return false;
+	}
+
+	__cpuid((int32*)Regs, 1);
+#else
+	if (__get_cpuid_max(0, nullptr) < 7)
+	{
+		return false;
+	}
+
+	__cpuid(1, Regs[0], Regs[1], Regs[2], Regs[3]);
+#endif
+
+	//	AVX and OSXSAVE, then the OS must save the YMM state;
+	const uint32 AVXBits = (1u << 28) | (1u << 27);
+	if ((Regs[2] & AVXBits) != AVXBits)
+	{
+		return false;
+	}
+
+#if defined(_MSC_VER)
+	uint64 XCR0 = _xgetbv(0);
+#else
+	uint32 XCR0Lo = 0;
+	uint32 XCR0Hi = 0;
+	__asm__ volatile("xgetbv" : "=a"(XCR0Lo), "=d"(XCR0Hi) : "c"(0));
+	uint64 XCR0 = ((uint64)XCR0Hi << 32) | XCR0Lo;
+#endif
+
+	if ((XCR0 & 0x6) != 0x6)
+	{
+		return false;
+	}
+
+#if defined(_MSC_VER)
+	__cpuidex((int32*)Regs, 7, 0);
+#else
+	__cpuid_count(7, 0, Regs[0], Regs[1], Regs[2], Regs[3]);
+#endif
+
+	return (Regs[1] & (1u << 5)) != 0;
+}
+
+//	Ptr and Size are aligned by ZERO_MEMORY_STREAM_ALIGNMENT;
+ZERO_MEMORY_TARGET_AVX2 static void StreamZeroAVX2(uint8* Ptr, TSize Size)
+{
+	const __m256i Zero = _mm256_setzero_si256();
+
+	for (uint8* End = Ptr + Size; Ptr < End; Ptr += ZERO_MEMORY_STREAM_ALIGNMENT)
+	{
+		_mm256_stream_si256((__m256i*)Ptr, Zero);
+		_mm256_stream_si256((__m256i*)(Ptr + 32), Zero);
+	}
+
+	_mm_sfence();
+}
+
+static void StreamZeroSSE2(uint8* Ptr, TSize Size)
+{
+	const __m128i Zero = _mm_setzero_si128();
+
+	for (uint8* End = Ptr + Size; Ptr < End; Ptr += ZERO_MEMORY_STREAM_ALIGNMENT)
+	{
+		_mm_stream_si128((__m128i*)Ptr, Zero);
+		_mm_stream_si128((__m128i*)(Ptr + 16), Zero);
+		_mm_stream_si128((__m128i*)(Ptr + 32), Zero);
+		_mm_stream_si128((__m128i*)(Ptr + 48), Zero);
+	}
+
+	_mm_sfence();
+}
+
+static const bool GIsAVX2Supported = IsAVX2Supported();
+
+#endif
+
+void ZeroMemoryBlock(void* Ptr, TSize Size)
+{
+#if ZERO_MEMORY_X64
+	if (Size >= ZERO_MEMORY_STREAM_MIN_SIZE)
+	{
+		uint8* Begin = (uint8*)Ptr;
+		uint8* End = Begin + Size;
+		uint8* StreamBegin = AlignToUpper(Begin, ZERO_MEMORY_STREAM_ALIGNMENT);
+		uint8* StreamEnd = AlignToLower(End, ZERO_MEMORY_STREAM_ALIGNMENT);
+
+		memset(Begin, 0, StreamBegin - Begin);
+
+		if (GIsAVX2Supported)
+		{
+			StreamZeroAVX2(StreamBegin, StreamEnd - StreamBegin);
+		}
+		else
+		{
+			StreamZeroSSE2(StreamBegin, StreamEnd - StreamBegin);
+		}
+
+		memset(StreamEnd, 0, End - StreamEnd);
+		return;
+	}
+#endif
+
+	memset(Ptr, 0, Size);
+}
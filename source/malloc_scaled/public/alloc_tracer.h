@@ -0,0 +1,159 @@
+#pragma once
+
+#include "std.h"
+#include "vm_block.h"
+#include "critical_section.h"
+
+#include <cstdio>
+#include <atomic>
+#include <thread>
+#include <chrono>
+
+//	Name of the environment variable with the path of the trace file the allocator writes from its start, e.g.
+//	MALLOC_SCALED_TRACE="malloc_trace.bin";
+#define MALLOC_SCALED_TRACE_ENV "MALLOC_SCALED_TRACE"
+
+static const TSize  ALLOC_TRACE_MAX_PATH_LENGTH  = 512;
+static const TSize  ALLOC_TRACE_MAX_THREAD_COUNT = 256;   // Threads traced at once, the requests of the later ones are dropped;
+static const TSize  ALLOC_TRACE_BUFFER_RECORDS   = 512;   // Records of a buffer half;
+static const uint64 ALLOC_TRACE_MAGIC            = 0x314543415254534Dull; // "MSTRACE1";
+static const uint32 ALLOC_TRACE_VERSION          = 1;
+
+//	Returns the value of MALLOC_SCALED_TRACE or nullptr;
+const char* GetAllocTraceEnv();
+
+enum EAllocTraceOp : uint8
+{
+	ALLOC_TRACE_MALLOC,
+	ALLOC_TRACE_CALLOC,
+	ALLOC_TRACE_REALLOC,
+	ALLOC_TRACE_FREE
+};
+
+//	Trace file: the header followed by records in chunks of one thread each, Seq orders them across threads;
+struct TAllocTraceHeader
+{
+	uint64 Magic;
+	uint32 Version;
+	uint32 RecordSize;
+};
+
+struct TAllocTraceRecord
+{
+	uint64 Seq;       // Order of the request under the allocator lock;
+	uint64 Time;      // Nanoseconds since the trace start;
+	uint64 Addr;      // Block passed to Realloc and Free;
+	uint64 Result;    // Block returned by Malloc, Calloc and Realloc;
+	uint64 Size;      // Requested size, Count * Size for Calloc;
+	uint32 Alignment;
+	uint16 Thread;    // Index of the thread in the order it was first traced;
+	uint8  Op;
+	uint8  Reserved;
+};
+
+static_assert(sizeof(TAllocTraceRecord) == 48, "TAllocTraceRecord is a part of the trace file format");
+
+//	Binary recorder of the allocator requests.
+//	Records are taken under the allocator lock into double buffers of the calling thread, so they get a total order
+//	without atomics. A full buffer half is written to the file by its thread once it has left the allocator lock.
+//	Record must be called under the allocator lock, FlushPending and the others without it;
+class TAllocTracer
+{
+	struct TThreadBuffer
+	{
+		TAllocTraceRecord* Halves[2];
+		TSize Count;          // records in the active half;
+		TSize Active;         // half the thread writes to;
+		bool  Pending[2];     // half is full and waits for its thread to write it out, cleared under FileGuard;
+		std::thread::id Owner;
+	};
+
+	struct TThreadSlot
+	{
+		TAllocTracer* Tracer;
+		uint64 Session;
+		TThreadBuffer* Buffer; // nullptr when the thread came above ALLOC_TRACE_MAX_THREAD_COUNT;
+	};
+
+public:
+	TAllocTracer();
+	~TAllocTracer();
+
+	TAllocTracer(TAllocTracer&) = delete;
+	TAllocTracer& operator=(TAllocTracer&) = delete;
+
+	//	Starts a trace written to Path, an existing file is overwritten.
+	//	AllocatorGuard is taken to start recording once the file and the buffers are ready;
+	bool Start(const char* Path, TCriticalSection& AllocatorGuard);
+
+	//	Writes out the records of all threads and closes the file.
+	//	AllocatorGuard is taken to stop recording before the buffers are written;
+	void Stop(TCriticalSection& AllocatorGuard);
+
+	inline bool IsEnabled();
+
+	//	Returns true when a buffer half of the calling thread is full and FlushPending must be called;
+	inline bool Record(EAllocTraceOp Op, void* Addr, void* Result, TSize Size, TSize Alignment);
+	void FlushPending();
+
+	TSize GetDroppedCount();
+
+private:
+	TThreadBuffer* GetThreadBuffer();
+	void WriteHalf(TThreadBuffer& Buffer, TSize Half, TSize Count);
+
+	bool Enabled;
+	uint64 Session;
+	uint64 NextSeq;
+	TSize ThreadCount;
+	TSize DroppedCount;
+	std::chrono::steady_clock::time_point StartTime;
+
+	FILE* File;
+	TCriticalSection FileGuard;
+
+	TThreadBuffer* Buffers;
+	TVMBlock DataBlock;
+
+	static thread_local TThreadSlot ThreadSlot;
+	static std::atomic<uint64> NextSession;
+};
+
+inline bool TAllocTracer::IsEnabled()
+{
+	return Enabled;
+}
+
+inline bool TAllocTracer::Record(EAllocTraceOp Op, void* Addr, void* Result, TSize Size, TSize Alignment)
+{
+	TThreadBuffer* Buffer = ThreadSlot.Tracer == this && ThreadSlot.Session == Session ? ThreadSlot.Buffer : GetThreadBuffer();
+
+	if (!Buffer)
+	{
+		++DroppedCount;
+		return false;
+	}
+
+	TAllocTraceRecord& Rec = Buffer->Halves[Buffer->Active][Buffer->Count];
+	Rec.Seq       = NextSeq++;
+	Rec.Time      = (uint64)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - StartTime).count();
+	Rec.Addr      = (uint64)Addr;
+	Rec.Result    = (uint64)Result;
+	Rec.Size      = Size;
+	Rec.Alignment = (uint32)Alignment;
+	Rec.Thread    = (uint16)(Buffer - Buffers);
+	Rec.Op        = Op;
+	Rec.Reserved  = 0;
+
+	if (++Buffer->Count < ALLOC_TRACE_BUFFER_RECORDS)
+	{
+		return false;
+	}
+
+	//	The other half was written out by the thread after its last full half;
+	Buffer->Pending[Buffer->Active] = true;
+	Buffer->Active ^= 1;
+	Buffer->Count = 0;
+
+	return true;
+}
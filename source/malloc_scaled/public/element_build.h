@@ -18,7 +18,7 @@ void CreateElementsFromArgs(TELEM* Dst, TSize Count, TARGS&&... Args)
 {
 	while (Count)
 	{
-		//new (Dst) TELEM(forward<TARGS>(Args)...);
+		new (Dst) TELEM(forward<TARGS>(Args)...);
 		++Dst;
 		--Count;
 	}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include "std.h"
+#include "align.h"
+#include "vm_block.h"
+#include "critical_section.h"
+
+static const TSize HEAP_PROFILER_MAX_DEPTH        = 32;    // Frames kept of an allocation stack;
+static const TSize HEAP_PROFILER_MAX_STACK_COUNT  = 4096;  // Distinct allocation stacks;
+static const TSize HEAP_PROFILER_MAX_SAMPLE_COUNT = 32768; // Sampled blocks alive at once;
+static const TSize HEAP_PROFILER_FILTER_SIZE      = 8192;  // Counters of the filter freed blocks pass before the sample table is searched;
+static const uint64 HEAP_PROFILER_HASH_MUL        = 0x9E3779B97F4A7C15ull;
+
+static_assert(IsPow2(HEAP_PROFILER_MAX_STACK_COUNT),  "HEAP_PROFILER_MAX_STACK_COUNT must be power of 2");
+static_assert(IsPow2(HEAP_PROFILER_MAX_SAMPLE_COUNT), "HEAP_PROFILER_MAX_SAMPLE_COUNT must be power of 2");
+static_assert(IsPow2(HEAP_PROFILER_FILTER_SIZE),      "HEAP_PROFILER_FILTER_SIZE must be power of 2");
+
+//	Sampled allocations of one call stack: the live ones and all made since the start;
+struct THeapProfileStack
+{
+	uint64 Hash;
+	TSize Depth;
+	TSize LiveCount;
+	TSize LiveBytes;
+	TSize AllocCount; // 0 for an empty slot;
+	TSize AllocBytes;
+	void* Frames[HEAP_PROFILER_MAX_DEPTH];
+};
+
+struct THeapProfileSample
+{
+	void* Addr; // nullptr for an empty slot;
+	TSize Size;
+	TSize Stack;
+};
+
+//	Sampling heap profiler.
+//	Allocations are sampled by bytes: the gaps between two samples of a thread are drawn from an exponential
+//	distribution with the mean of SampleInterval, so a block of Size is sampled with the probability of
+//	1 - exp(-Size / SampleInterval) whatever the allocation pattern is. The stack of a sampled block is captured
+//	and the block is tracked until it is freed. Tables live in a block of their own, outside of the profiled heap.
+//	Record functions are called under the allocator lock;
+class THeapProfiler
+{
+	//	The gap is kept in units of the mean interval, so heaps sampling at different intervals share the clock of a thread;
+	struct TThreadSampler
+	{
+		float64 GapLeft;
+		uint64  Random; // 0 until the thread draws its first gap;
+	};
+
+public:
+	THeapProfiler();
+	~THeapProfiler();
+
+	THeapProfiler(THeapProfiler&) = delete;
+	THeapProfiler& operator=(THeapProfiler&) = delete;
+
+	bool Init(TSize SampleInterval);
+	void Release();
+
+	bool IsInitialized();
+
+	//	Counts Size off the bytes left to the next sample of the calling thread;
+	inline bool ShouldSample(TSize Size);
+
+	void RecordAlloc(void* Addr, TSize Size);
+
+	//	Called for every freed or resized block, the sample table is searched only for the blocks which pass
+	//	a small filter of the sampled addresses, so the table stays out of the caches;
+	inline void RecordFree(void* Addr);
+	inline void RecordResize(void* OldAddr, void* NewAddr, TSize NewSize);
+
+	//	Writes the profile in the heap_v2 text format of pprof: the live sampled blocks and the sampled allocations
+	//	since the start of every stack, followed by the module map. The stacks are copied under AllocatorGuard
+	//	and written out of it, so Writer may allocate;
+	bool Dump(TCriticalSection& AllocatorGuard, TMallocWriter Writer, void* Context);
+
+private:
+	bool NextSample();
+
+	void RemoveSampledBlock(void* Addr);
+	void MoveSampledBlock(void* OldAddr, void* NewAddr, TSize NewSize);
+
+	TSize FindStack(void** Frames, TSize Depth);
+	static inline TSize GetFilterSlot(void* Addr);
+	inline TSize GetSampleSlot(void* Addr);
+	TSize FindSample(void* Addr);
+	void InsertSample(const THeapProfileSample& Sample);
+	void RemoveSample(TSize Slot);
+
+	TSize SampleInterval;
+	float64 SampleRate; // 1 / SampleInterval;
+	TSize SampleCount;
+	TSize StackCount;
+	TSize DroppedCount; // sampled blocks not tracked as the stack or the sample table was full;
+
+	uint8* SampleFilter; // sampled blocks per filter slot, saturated counters are never decreased;
+	THeapProfileSample* Samples;
+	THeapProfileStack* Stacks;
+	THeapProfileStack* Snapshot;
+
+	TVMBlock DataBlock;
+	TCriticalSection DumpGuard;
+
+	static thread_local TThreadSampler ThreadSampler;
+
+	static constexpr TSize SampleSlotCount = HEAP_PROFILER_MAX_SAMPLE_COUNT * 2;
+	static constexpr TSize StackSlotCount  = HEAP_PROFILER_MAX_STACK_COUNT * 2;
+};
+
+inline bool THeapProfiler::ShouldSample(TSize Size)
+{
+	if ((ThreadSampler.GapLeft -= (float64)Size * SampleRate) > 0.0)
+	{
+		return false;
+	}
+
+	return NextSample();
+}
+
+inline TSize THeapProfiler::GetFilterSlot(void* Addr)
+{
+	return (TSize)((((uint64)Addr >> 4) * HEAP_PROFILER_HASH_MUL) >> (64 - FloorLog2(HEAP_PROFILER_FILTER_SIZE)));
+}
+
+inline void THeapProfiler::RecordFree(void* Addr)
+{
+	if (SampleFilter[GetFilterSlot(Addr)])
+	{
+		RemoveSampledBlock(Addr);
+	}
+}
+
+inline void THeapProfiler::RecordResize(void* OldAddr, void* NewAddr, TSize NewSize)
+{
+	if (SampleFilter[GetFilterSlot(OldAddr)])
+	{
+		MoveSampledBlock(OldAddr, NewAddr, NewSize);
+	}
+}
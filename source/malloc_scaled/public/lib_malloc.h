@@ -3,6 +3,9 @@
 #include "build.h"
 #include "std.h"
 #include "malloc_base.h"
+#include "malloc_conf.h"
+
+struct TPageMallocArenaStats;
 
 enum EMallocAction
 {
@@ -18,9 +21,13 @@ enum EMallocAction
 extern "C" __declspec(dllexport) bool InitMalloc();
 extern "C" __declspec(dllexport) bool IsMallocInitialized();
 extern "C" __declspec(dllexport) void ShutdownMalloc();
+extern "C" __declspec(dllexport) IMalloc* CreateHeap(const TMallocConf& Conf);
+extern "C" __declspec(dllexport) bool DestroyHeap(IMalloc* Heap);
 extern "C" __declspec(dllexport) void GetMallocStats(TMallocStats& Stats);
 extern "C" __declspec(dllexport) void GetMallocTimeStats(TMallocTimeStats & TimeStats);
 extern "C" __declspec(dllexport) TSize GetMaxPoolBlockSize();
+extern "C" __declspec(dllexport) void GetMemPoolCacheStats(TMemPoolCacheStats& Stats);
+extern "C" __declspec(dllexport) void GetMallocConf(TMallocConf& Conf);
 
 extern "C" __declspec(dllexport) float64 GetAvgTime_ms(TMallocTimeStats& TimeStats, EMallocAction Act);
 extern "C" __declspec(dllexport) float64 GetMaxTime_ms(TMallocTimeStats & TimeStats, EMallocAction Act);
@@ -34,9 +41,36 @@ extern "C" __declspec(dllexport) uint64 GetMeasureCount(TMallocTimeStats & TimeS
 //#endif
 
 extern "C" __declspec(dllexport) void* Malloc(TSize Size, TSize Alignment = MALLOC_DEFAULT_ALIGNMENT);
+extern "C" __declspec(dllexport) void* Calloc(TSize Count, TSize Size, TSize Alignment = MALLOC_DEFAULT_ALIGNMENT);
 extern "C" __declspec(dllexport) void* Realloc(void* Addr, TSize NewSize, TSize NewAlignment = MALLOC_DEFAULT_ALIGNMENT);
 extern "C" __declspec(dllexport) void  Free(void* Addr);
 extern "C" __declspec(dllexport) TSize GetSize(void* Addr);
+extern "C" __declspec(dllexport) TSize GetGoodSize(TSize Size, TSize Alignment = MALLOC_DEFAULT_ALIGNMENT);
+extern "C" __declspec(dllexport) bool  Prewarm(TSize Size, TSize Count, TSize Alignment = MALLOC_DEFAULT_ALIGNMENT);
+extern "C" __declspec(dllexport) TSize Trim(TSize KeepBytes = 0);
+extern "C" __declspec(dllexport) void  SetMemoryPressureCallback(TMemoryPressureCallback Callback, void* Context = nullptr);
+
+//	Always on counters: of the calling thread, summed over the size classes and per size class;
+extern "C" __declspec(dllexport) void  GetThreadMallocCounters(TMallocCounters& Counters);
+extern "C" __declspec(dllexport) void  GetMallocCounters(TMallocCounters& Counters);
+extern "C" __declspec(dllexport) TSize GetSizeClassCounters(TSizeClassCounters* Counters, TSize MaxCount);
+
+//	Size class layout and page allocator arenas, as written by DumpStats;
+extern "C" __declspec(dllexport) TSize GetSizeClassStats(TSizeClassStats* Stats, TSize MaxCount);
+extern "C" __declspec(dllexport) TSize GetArenaStats(TPageMallocArenaStats* Stats, TSize MaxCount);
+
+//	Heap profile in the pprof heap_v2 text format, needs prof_sample in MALLOC_SCALED_CONF;
+extern "C" __declspec(dllexport) bool  DumpHeapProfile(TMallocWriter Writer, void* Context = nullptr);
+//	Heap profile of a heap made by CreateHeap with prof_sample in its configuration;
+extern "C" __declspec(dllexport) bool  DumpHeapProfileOf(IMalloc* Heap, TMallocWriter Writer, void* Context = nullptr);
+
+//	Size classes and page allocator arenas as JSON or Prometheus text, Writer may allocate;
+extern "C" __declspec(dllexport) bool  DumpStats(EMallocStatsFormat Format, TMallocWriter Writer, void* Context = nullptr);
+
+//	Binary trace of the allocator requests for replay, also started by MALLOC_SCALED_TRACE;
+extern "C" __declspec(dllexport) bool  StartAllocTrace(const char* Path);
+extern "C" __declspec(dllexport) void  StopAllocTrace();
+
 extern "C" __declspec(dllexport) float64 GetFunctionTime();
 
 #endif
@@ -49,6 +83,8 @@ extern "C" void ShutdownMalloc();
 extern "C" void GetMallocStats(TMallocStats & Stats);
 extern "C" void GetMallocTimeStats(TMallocTimeStats & TimeStats);
 extern "C" TSize GetMaxPoolBlockSize();
+extern "C" void GetMemPoolCacheStats(TMemPoolCacheStats& Stats);
+extern "C" void GetMallocConf(TMallocConf& Conf);
 
 extern "C" float64 GetAvgTime_ms(TMallocTimeStats & TimeStats, EMallocAction Act);
 extern "C" float64 GetMaxTime_ms(TMallocTimeStats & TimeStats, EMallocAction Act);
@@ -60,9 +96,30 @@ extern "C" float64 GetMinTime_ns(TMallocTimeStats & TimeStats, EMallocAction Act
 extern "C" uint64 GetMeasureCount(TMallocTimeStats & TimeStats, EMallocAction Act);
 #endif
 
+extern "C" IMalloc* CreateHeap(const TMallocConf& Conf);
+extern "C" bool DestroyHeap(IMalloc* Heap);
+
 extern "C" void* Malloc(TSize Size, TSize Alignment);
+extern "C" void* Calloc(TSize Count, TSize Size, TSize Alignment);
 extern "C" void* Realloc(void* Addr, TSize NewSize, TSize NewAlignment);
 extern "C" void  Free(void* Addr);
 extern "C" TSize GetSize(void* Addr);
+extern "C" TSize GetGoodSize(TSize Size, TSize Alignment);
+extern "C" bool  Prewarm(TSize Size, TSize Count, TSize Alignment);
+extern "C" TSize Trim(TSize KeepBytes);
+extern "C" void  SetMemoryPressureCallback(TMemoryPressureCallback Callback, void* Context);
+
+extern "C" void  GetThreadMallocCounters(TMallocCounters& Counters);
+extern "C" void  GetMallocCounters(TMallocCounters& Counters);
+extern "C" TSize GetSizeClassCounters(TSizeClassCounters* Counters, TSize MaxCount);
+extern "C" TSize GetSizeClassStats(TSizeClassStats* Stats, TSize MaxCount);
+extern "C" TSize GetArenaStats(TPageMallocArenaStats* Stats, TSize MaxCount);
+
+extern "C" bool  DumpHeapProfile(TMallocWriter Writer, void* Context);
+extern "C" bool  DumpHeapProfileOf(IMalloc* Heap, TMallocWriter Writer, void* Context);
+extern "C" bool  DumpStats(EMallocStatsFormat Format, TMallocWriter Writer, void* Context);
+
+extern "C" bool  StartAllocTrace(const char* Path);
+extern "C" void  StopAllocTrace();
 
 #endif
\ No newline at end of file
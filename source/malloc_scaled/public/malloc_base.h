@@ -7,6 +7,10 @@
 
 static const TSize MALLOC_DEFAULT_ALIGNMENT = 16;
 
+//	Called by the background thread under memory pressure or above the soft limit, before the allocator trims itself,
+//	so the application can drop its own caches first. Must not block on threads waiting for the allocator;
+typedef void (*TMemoryPressureCallback)(TSize ResidentSize, void* Context);
+
 class TMallocBase :
 	public IMalloc
 {
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "std.h"
+
+//	Name of the environment variable with the allocator options, e.g.
+//	MALLOC_SCALED_CONF="pool_size:4m,subindex_count:16,arena_size:1g,stats_print:true,background_thread:true,soft_limit:2g,prof_sample:512k,prewarm:32x10000;4kx64";
+#define MALLOC_SCALED_CONF_ENV "MALLOC_SCALED_CONF"
+
+static const TSize MALLOC_CONF_MAX_LENGTH = 1024; // Bytes;
+static const TSize MALLOC_CONF_MAX_PREWARM_COUNT = 16;
+
+//	Count blocks of Size made ready at startup;
+struct TMallocConfPrewarm
+{
+	TSize Size;
+	TSize Count;
+};
+
+/*
+----------------------------------------------------------
+	Effective allocator parameters, zero means the default
+	of the allocator or the page allocator is used
+----------------------------------------------------------
+*/
+
+struct TMallocConf
+{
+	TMallocConf() :
+		MinBaseBlockSize(0),
+		MaxBaseBlockSize(0),
+		SubIndexCount(0),
+		PoolBlockSize(0),
+		ArenaSize(0),
+		ArenaPageSize(0),
+		PoolCacheHighWater(0),
+		PoolCacheLowWater(0),
+		PoolCacheMaxSize(0),
+		SoftLimit(0),
+		PoolColorCount(0),
+		ThreadPoolCount(0),
+		ProfSampleInterval(0),
+		StatsPrint(false),
+		BackgroundThread(false),
+		PressureMonitor(false),
+		LargeBuffers(false),
+		Prewarm{},
+		PrewarmCount(0)
+	{
+	}
+
+	TSize MinBaseBlockSize;   // min_block;
+	TSize MaxBaseBlockSize;   // max_block;
+	TSize SubIndexCount;      // subindex_count;
+	TSize PoolBlockSize;      // pool_size;
+	TSize ArenaSize;          // arena_size;
+	TSize ArenaPageSize;      // arena_page_size;
+	TSize PoolCacheHighWater; // pool_cache_high;
+	TSize PoolCacheLowWater;  // pool_cache_low;
+	TSize PoolCacheMaxSize;   // pool_cache_max;
+	TSize SoftLimit;          // soft_limit: resident size above which the allocator trims itself;
+	TSize PoolColorCount;     // pool_colors: cache line offsets the pool starts rotate through, 1 turns coloring off;
+	TSize ThreadPoolCount;    // thread_pools: power of 2 pools per size class carved by different threads at once;
+	TSize ProfSampleInterval; // prof_sample: mean bytes allocated between two allocations sampled by the heap profiler, 0 turns it off;
+	bool  StatsPrint;         // stats_print;
+	bool  BackgroundThread;   // background_thread;
+	bool  PressureMonitor;    // pressure_monitor: trim when the system or the container runs low on memory;
+	bool  LargeBuffers;       // large_buffers: CreateHeap builds the heap with the TMallocScaledLargeBufferConfig size classes;
+
+	TMallocConfPrewarm Prewarm[MALLOC_CONF_MAX_PREWARM_COUNT]; // prewarm:<size>x<count>[;<size>x<count>...];
+	TSize PrewarmCount;
+};
+
+//	Parses "key:value[,key:value...]" into InOutConf, sizes accept k, m and g suffixes.
+//	Does not allocate, unknown keys and malformed values are skipped and make it return false;
+bool ParseMallocConf(const char* ConfStr, TMallocConf& InOutConf);
+
+//	Returns the value of MALLOC_SCALED_CONF or nullptr;
+const char* GetMallocConfEnv();
+
+//	Writes the configuration as "key:value" lines, returns the written length;
+TSize FormatMallocConf(const TMallocConf& Conf, char* OutBuf, TSize BufSize);
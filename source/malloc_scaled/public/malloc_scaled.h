@@ -5,10 +5,18 @@
 #include "mem_block.h"
 #include "vm_block.h"
 #include "malloc_base.h"
+#include "malloc_conf.h"
 #include "critical_section.h"
+#include "heap_profiler.h"
+#include "alloc_tracer.h"
 
 #include "align.h"
 
+#include <array>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+
 static const TSize MALLOC_SCALED_DEFAULT_ALIGNMENT        = 16;
 static const TSize MALLOC_SCALED_SYSTEM_DEFAULT_ALIGNMENT = 16;
 static const TSize MALLOC_SCALED_SUBINDEX_COUNT           = 8;
@@ -17,6 +25,23 @@ static const TSize MALLOC_SCALED_MIN_BASE_BLOCK_SIZE      = 256;        // Bytes
 static const TSize MALLOC_SCALED_MAX_BASE_BLOCK_SIZE      = 34359738368; // Bytes;
 static const TSize MALLOC_SCALED_POOL_BLOCK_SIZE          = 8388608;   // Previous val: 524288 Bytes;
 static const TSize MALLOC_SCALED_AREA_BLOCK_SIZE          = 268435456; // Bytes;
+static const TSize MALLOC_SCALED_POOL_CACHE_HIGH_WATER    = 4;         // Empty pools per size class;
+static const TSize MALLOC_SCALED_POOL_CACHE_LOW_WATER     = 1;         // Empty pools per size class;
+static const TSize MALLOC_SCALED_POOL_CACHE_MAX_SIZE      = 268435456; // Bytes;
+static const TSize MALLOC_SCALED_DIRECT_LOOKUP_MAX_SIZE   = 32768;     // Bytes;
+static const TSize MALLOC_SCALED_DIRECT_LOOKUP_SHIFT      = 4;
+static const TSize MALLOC_SCALED_SPARE_POOL_LOW_WATER     = 4;         // Spare is requested below 1/N of the pool blocks free;
+static const TSize MALLOC_SCALED_SPARE_REQUEST_COUNT      = 64;        // Pending spare pool requests;
+static const TSize MALLOC_SCALED_POOL_GROUP_COUNT         = 128;       // Groups of blocks a pool purges pages by;
+static const TSize MALLOC_SCALED_POOL_GROUP_MIN_SIZE      = 65536;     // Bytes;
+static const TSize MALLOC_SCALED_PAGE_RECLAIM_BATCH_COUNT = 16;        // Groups detached under one hold of the allocator lock;
+static const TSize MALLOC_SCALED_PAGE_RECLAIM_PERIOD      = 1000;      // Milliseconds between page reclaim passes of the background thread;
+static const TSize MALLOC_SCALED_PRESSURE_CHECK_PERIOD    = 250;       // Milliseconds between memory pressure checks;
+static const TSize MALLOC_SCALED_PRESSURE_MAX_BACKOFF     = 64;        // Pressure checks skipped at most between trims while the pressure lasts;
+static const TSize MALLOC_SCALED_CACHE_LINE_SIZE          = 64;        // Bytes;
+static const TSize MALLOC_SCALED_POOL_COLOR_COUNT         = 64;        // Cache line offsets the pool starts rotate through by default;
+static const TSize MALLOC_SCALED_MAX_THREAD_POOL_COUNT    = 16;        // Pools of a size class carved at once by different threads;
+static const TSize MALLOC_SCALED_THREAD_HEAD_SLOT_COUNT   = 8;         // Heaps a thread holds a head slot of at once;
 
 
 static_assert(IsPow2(MALLOC_SCALED_DEFAULT_ALIGNMENT),        "MALLOC_SCALED_SYSTEM_DEFAULT_ALIGNMENT must be power of 2");
@@ -27,8 +52,94 @@ static_assert(IsPow2(MALLOC_SCALED_MIN_BASE_BLOCK_SIZE),      "MALLOC_SCALED_MIN
 static_assert(IsPow2(MALLOC_SCALED_MAX_BASE_BLOCK_SIZE),      "MALLOC_SCALED_MAX_BASE_BLOCK_SIZE must be power of 2");
 static_assert(IsAligned(MALLOC_SCALED_MIN_BASE_BLOCK_SIZE / MALLOC_SCALED_SUBINDEX_COUNT, MALLOC_SCALED_DEFAULT_ALIGNMENT), "the smallest block size must be aligned by MALLOC_SCALED_SYSTEM_DEFAULT_ALIGNMENT");
 static_assert(IsAligned(MALLOC_SCALED_POOL_BLOCK_SIZE, MALLOC_SCALED_SYSTEM_DEFAULT_ALIGNMENT), "commited pool size must be aligned by MALLOC_SCALED_SYSTEM_DEFAULT_ALIGNMENT");
+static_assert(((TSize)1 << MALLOC_SCALED_DIRECT_LOOKUP_SHIFT) == MALLOC_SCALED_DEFAULT_ALIGNMENT, "direct lookup step must be equal to MALLOC_SCALED_DEFAULT_ALIGNMENT");
+
+//	Compile-time configuration of TMallocScaled.
+//	Another configuration is a struct with the same members, e.g. a small-object heap
+//	with small pools and a short direct lookup next to a large-buffer heap with large arenas;
+struct TMallocScaledDefaultConfig
+{
+	static constexpr TSize SubIndexCount       = MALLOC_SCALED_SUBINDEX_COUNT;
+	static constexpr TSize MaxSubIndexCount    = MALLOC_SCALED_MAX_SUBINDEX_COUNT;
+	static constexpr TSize MinBaseBlockSize    = MALLOC_SCALED_MIN_BASE_BLOCK_SIZE;
+	static constexpr TSize MaxBaseBlockSize    = MALLOC_SCALED_MAX_BASE_BLOCK_SIZE;
+	static constexpr TSize PoolBlockSize       = MALLOC_SCALED_POOL_BLOCK_SIZE;
+	static constexpr TSize ArenaSize           = MALLOC_SCALED_AREA_BLOCK_SIZE;
+	static constexpr TSize PoolCacheHighWater  = MALLOC_SCALED_POOL_CACHE_HIGH_WATER;
+	static constexpr TSize PoolCacheLowWater   = MALLOC_SCALED_POOL_CACHE_LOW_WATER;
+	static constexpr TSize PoolCacheMaxSize    = MALLOC_SCALED_POOL_CACHE_MAX_SIZE;
+	static constexpr TSize DirectLookupMaxSize = MALLOC_SCALED_DIRECT_LOOKUP_MAX_SIZE;
+};
+
+//	Heaps of large buffers: coarse size classes from 4 KB, large pools and arenas, few cached pools;
+struct TMallocScaledLargeBufferConfig
+{
+	static constexpr TSize SubIndexCount       = 4;
+	static constexpr TSize MaxSubIndexCount    = MALLOC_SCALED_MAX_SUBINDEX_COUNT;
+	static constexpr TSize MinBaseBlockSize    = 4096;       // Bytes;
+	static constexpr TSize MaxBaseBlockSize    = MALLOC_SCALED_MAX_BASE_BLOCK_SIZE;
+	static constexpr TSize PoolBlockSize       = 33554432;   // Bytes;
+	static constexpr TSize ArenaSize           = 1073741824; // Bytes;
+	static constexpr TSize PoolCacheHighWater  = 2;          // Empty pools per size class;
+	static constexpr TSize PoolCacheLowWater   = 1;          // Empty pools per size class;
+	static constexpr TSize PoolCacheMaxSize    = 536870912;  // Bytes;
+	static constexpr TSize DirectLookupMaxSize = 65536;      // Bytes;
+};
+
+//	Size classes of a configuration evaluated at compile time;
+template<typename TCONFIG>
+struct TMallocScaledSizeClasses
+{
+	static_assert(IsPow2(TCONFIG::SubIndexCount),    "SubIndexCount must be power of 2");
+	static_assert(IsPow2(TCONFIG::MaxSubIndexCount), "MaxSubIndexCount must be power of 2");
+	static_assert(IsPow2(TCONFIG::MinBaseBlockSize), "MinBaseBlockSize must be power of 2");
+	static_assert(IsPow2(TCONFIG::MaxBaseBlockSize), "MaxBaseBlockSize must be power of 2");
+	static_assert(TCONFIG::SubIndexCount <= TCONFIG::MaxSubIndexCount, "SubIndexCount must not exceed MaxSubIndexCount");
+	static_assert(IsAligned(TCONFIG::MinBaseBlockSize / TCONFIG::SubIndexCount, MALLOC_SCALED_DEFAULT_ALIGNMENT), "the smallest block size must be aligned by MALLOC_SCALED_DEFAULT_ALIGNMENT");
+	static_assert(IsAligned(TCONFIG::PoolBlockSize, MALLOC_SCALED_SYSTEM_DEFAULT_ALIGNMENT), "commited pool size must be aligned by MALLOC_SCALED_SYSTEM_DEFAULT_ALIGNMENT");
+	static_assert(IsAligned(TCONFIG::DirectLookupMaxSize, MALLOC_SCALED_DEFAULT_ALIGNMENT), "DirectLookupMaxSize must be aligned by MALLOC_SCALED_DEFAULT_ALIGNMENT");
+	static_assert(TCONFIG::DirectLookupMaxSize <= TCONFIG::MaxBaseBlockSize, "DirectLookupMaxSize must not exceed MaxBaseBlockSize");
+	static_assert(TCONFIG::PoolCacheLowWater <= TCONFIG::PoolCacheHighWater, "PoolCacheLowWater must not exceed PoolCacheHighWater");
+
+	static constexpr TSize MinBaseIndex       = FloorLog2(TCONFIG::MinBaseBlockSize);
+	static constexpr TSize MaxBaseIndex       = FloorLog2(TCONFIG::MaxBaseBlockSize);
+	static constexpr TSize SubIndexCountShift = FloorLog2(TCONFIG::SubIndexCount);
+	static constexpr TSize LookupCount        = (TCONFIG::DirectLookupMaxSize >> MALLOC_SCALED_DIRECT_LOOKUP_SHIFT) + 1;
+
+	static_assert(MaxBaseIndex - MinBaseIndex < 256 && TCONFIG::MaxSubIndexCount <= 256, "size class does not fit into the lookup class entry");
+
+	static constexpr TSize GetBaseIndex(TSize BlockSize)
+	{
+		TSize BlockIndex = CeilLog2(BlockSize);
+		return BlockIndex < MinBaseIndex ? 0 : BlockIndex - MinBaseIndex;
+	}
+
+	static constexpr TSize GetPoolIndex(TSize BlockSize, TSize BaseIndex)
+	{
+		TSize BlockIndex = MinBaseIndex + BaseIndex;
+		TSize LowerPoolBlockSize = BlockIndex == MinBaseIndex ? 0 : ((TSize)1 << (BlockIndex - 1));
+		TSize SpacingShift = BlockIndex == MinBaseIndex ? MinBaseIndex - SubIndexCountShift : (BlockIndex - 1) - SubIndexCountShift;
+
+		return (BlockSize - LowerPoolBlockSize - 1) >> SpacingShift;
+	}
+
+	//	Size class of every direct lookup slot: (BaseIndex << 8) | PoolIndex;
+	static constexpr std::array<uint16, LookupCount> MakeLookupClasses()
+	{
+		std::array<uint16, LookupCount> Classes{};
+
+		for (TSize i = 0; i < LookupCount; ++i)
+		{
+			TSize BlockSize = i ? (i << MALLOC_SCALED_DIRECT_LOOKUP_SHIFT) : MALLOC_SCALED_DEFAULT_ALIGNMENT;
+			TSize BaseIndex = GetBaseIndex(BlockSize);
+			Classes[i] = (uint16)((BaseIndex << 8) | GetPoolIndex(BlockSize, BaseIndex));
+		}
+
+		return Classes;
+	}
 
-class TMemPool;
+	static constexpr std::array<uint16, LookupCount> LookupClasses = MakeLookupClasses();
+};
 struct TMemPoolHdr;
 struct TMemBlockHdr;
 
@@ -81,6 +192,19 @@ struct alignas(MALLOC_SCALED_SYSTEM_DEFAULT_ALIGNMENT)
 //	|   FREE   |    |
 //	|__________| <--*
 
+//	Memory pools of one size class are kept in fullness bins.
+//	The next head pool is taken from the fullest non full bin, so nearly empty
+//	pools are drained and can be released back to the page allocator;
+enum EMemPoolBin : TSize
+{
+	POOL_BIN_FULL,   // no free blocks;
+	POOL_BIN_HIGH,   // more than 75% of blocks are used;
+	POOL_BIN_MEDIUM, // 25% - 75% of blocks are used;
+	POOL_BIN_LOW,    // less than 25% of blocks are used;
+	POOL_BIN_EMPTY,  // all blocks are free;
+	POOL_BIN_COUNT
+};
+
 using TMemPoolHdrBase = TListNode<TMemPoolHdr*>;
 
 struct alignas(MALLOC_SCALED_SYSTEM_DEFAULT_ALIGNMENT)
@@ -98,6 +222,14 @@ struct alignas(MALLOC_SCALED_SYSTEM_DEFAULT_ALIGNMENT)
 		ActiveBlocks    = 0;
 		TotalBlockCount = 0;
 		FreeBlockCount  = 0;
+		Bin             = POOL_BIN_EMPTY;
+		Untouched       = false;
+		RestoredBlocks  = 0;
+		RestoredEnd     = 0;
+		memset(PurgedGroups, 0, sizeof(PurgedGroups));
+		memset(GroupFreeCounts, 0, sizeof(GroupFreeCounts));
+		Head            = 0;
+		LastHead        = 0;
 
 		MemPool = nullptr;
 	}
@@ -109,8 +241,20 @@ struct alignas(MALLOC_SCALED_SYSTEM_DEFAULT_ALIGNMENT)
 	TSize ActiveBlocks;
 	TSize FreeBlockCount;
 	TSize TotalBlockCount;
+	TSize Bin;
+	bool  Untouched; // blocks from ActiveBlocks on were never written since the OS committed them;
+
+	//	Blocks of purged groups left the free list, a group is carved again from RestoredBlocks to RestoredEnd
+	//	once the pool has no other free blocks, so its pages fault in only as blocks are reused;
+	TSize  RestoredBlocks;
+	TSize  RestoredEnd;
+	uint64 PurgedGroups[MALLOC_SCALED_POOL_GROUP_COUNT / 64];
+	uint16 GroupFreeCounts[MALLOC_SCALED_POOL_GROUP_COUNT]; // Blocks of each group in FreeBlockList;
 
-	TMemPool* MemPool;
+	TSize Head;     // Head slot + 1 of the threads carving the pool, 0 when it is no head;
+	TSize LastHead; // Head slot + 1 of the threads which carved the pool last, 0 when it never was a head;
+
+	void* MemPool; // TMemPool<TCONFIG> the pool belongs to;
 	TMemBlockList FreeBlockList;
 
 #ifdef MALLOC_STATS
@@ -122,6 +266,16 @@ struct alignas(MALLOC_SCALED_SYSTEM_DEFAULT_ALIGNMENT)
 
 using TMemPoolList = TListBase<TMemPoolHdrBase>;
 
+//	Group of free blocks detached from its pool while its pages are purged out of the allocator lock;
+struct TMemPoolPageRange
+{
+	TMemPoolHdr* Pool;
+	TSize Group;
+	TSize BlockCount;
+	void* Begin;
+	TSize Size;
+};
+
 static const TSize MemBlockHdrOffsetSize = sizeof(TMemBlockHdrOffset);
 static const TSize MemBlockHdrSize       = sizeof(TMemBlockHdr);
 static const TSize MemPoolHdrSize        = sizeof(TMemPoolHdr);
@@ -129,6 +283,38 @@ static const TSize MemPoolHdrSize        = sizeof(TMemPoolHdr);
 static_assert(IsAligned(MemPoolHdrSize, MALLOC_SCALED_SYSTEM_DEFAULT_ALIGNMENT), "Memory pool header size must be aligned by MALLOC_SCALED_SYSTEM_DEFAULT_ALIGNMENT");
 static_assert(IsAligned(MemBlockHdrSize, MALLOC_SCALED_SYSTEM_DEFAULT_ALIGNMENT), "Memory block header size must be aligned by MALLOC_SCALED_SYSTEM_DEFAULT_ALIGNMENT");
 
+//	Empty pools are retained by their size class instead of being unmapped.
+//	A size class keeps up to HighWater empty pools, above it the cache is trimmed to LowWater.
+//	MaxCachedSize is the budget shared by all size classes;
+struct TMemPoolCache
+{
+	TMemPoolCache()
+	{
+		HighWater     = 0;
+		LowWater      = 0;
+		MaxCachedSize = 0;
+		ColorCount    = 1;
+		ThreadPoolCount = 1;
+		HeldHeadSlots = 0;
+		ReclaimPoolCount = 0;
+	}
+
+	TSize HighWater;
+	TSize LowWater;
+	TSize MaxCachedSize;
+	TSize ColorCount;
+	TSize ThreadPoolCount;
+	uint64 HeldHeadSlots; // Head slots held by live threads, a bit per slot;
+
+	//	Pools leaving the allocator are queued here and returned to the page allocator
+	//	in batches out of the allocator lock, see TMallocScaled::ReclaimPools;
+	TMemPoolList ReclaimPools;
+	TSize ReclaimPoolCount;
+
+	TMemPoolCacheStats Stats;
+};
+
+template<typename TCONFIG>
 class alignas(MALLOC_SCALED_SYSTEM_DEFAULT_ALIGNMENT) 
 	TMemPool
 {
@@ -170,52 +356,131 @@ public:
 		BaseIndex = 0;
 		PoolCount = 0;
 		TotalFreeBlockCount = 0;
-
-		HeadPool = nullptr;
+		DetachedBlockCount = 0;
+		CachedPoolCount = 0;
+		SparePoolCount = 0;
+		SpareLowWater = 0;
+		SpareRequested = false;
+		GroupBlockCount = 0;
+		GroupStride = 0;
+		NextColor = 0;
+
+		memset(HeadPools, 0, sizeof(HeadPools));
+		PoolCache = nullptr;
 
 		BlockSize = 0;
 
 		PoolBlockSize = 0;
 		PoolVMBlockSize = 0;
+		ArenaSize = 0;
+		ArenaOwner = nullptr;
 	}
 
-	void Init(TSize BaseIndex, TSize PoolIndex, TSize BlockSize, TSize PoolBlockSize);
+	void Init(TSize BaseIndex, TSize PoolIndex, TSize BlockSize, TSize PoolBlockSize, TSize ArenaSize, void* ArenaOwner, TMemPoolCache* PoolCache);
 	void Release();
 
-	TMemBlockHdr* GetFreeBlock(TSize UsedSize);
+	//	Threads of different head slots carve from different pools, so their blocks never share cache lines;
+	TMemBlockHdr* GetFreeBlock(TSize UsedSize, bool& OutUntouched, TSize HeadSlot = 0);
+
+	//	Adds pools with faulted in pages until BlockCount blocks are free;
+	bool Prewarm(TSize BlockCount);
+
+	//	Spare pools are built and faulted in by the background thread, AddPool takes them first.
+	//	RequestSparePool marks the pool as waiting for a spare when its free blocks run low,
+	//	AllocateSparePool runs without the allocator lock, AddSparePool and CancelSparePool under it;
+	bool RequestSparePool();
+	bool AllocateSparePool(TVMBlock& OutPoolVMBlock);
+	void AddSparePool(TVMBlock&& PoolVMBlock);
+	void CancelSparePool();
+
+	//	Detaches the fully free groups of sparsely used pools, AttachPurgedGroup gives them back
+	//	once their pages are purged. Groups whose pages fit into InOutKeepSize stay. Returns the number of ranges written;
+	TSize DetachFreeGroups(TMemPoolPageRange* OutRanges, TSize MaxRangeCount, TSize& InOutKeepSize);
+	void AttachPurgedGroup(const TMemPoolPageRange& Range);
+
+	//	Queues empty, cached and spare pools for reclaim while their size exceeds InOutKeepSize,
+	//	which is lowered by the size of the kept ones. Returns the queued size;
+	TSize Trim(TSize& InOutKeepSize);
 	
 	void FreeUsrBlock(TMemBlockHdr* UsrBlock);
 
 	TSize GetBlockSize();
 	TSize GetPoolCount();
+	TSize GetCachedPoolCount();
 	TMemPoolHdr* GetTop();
 
 	TMemPoolStats* GetPoolStats();
+
+	//	Counted under the allocator lock, without MALLOC_STATS;
+	TMallocCounters* GetCounters();
+
+	//	Walks the pools of the class, not their blocks;
+	void GetStats(TSizeClassStats& OutStats);
+	inline void CountResize(TSize OldSize, TSize NewSize);
+
+	//	The pool carved by HeadSlot stops being its head, for slots given back at thread exit;
+	void DropHeadSlot(TSize HeadSlot);
 private:
-	TMemPoolHdr* FindNewHeadPool();
+	//	Only empty pools and pools last carved by HeadSlot or by a slot no live thread holds are taken,
+	//	so the blocks of a pool are not handed out to several threads;
+	TMemPoolHdr* FindNewHeadPool(TSize HeadSlot);
+	inline void SetHeadPool(TSize HeadSlot, TMemPoolHdr* Pool);
+	inline void DropHeadPool(TMemPoolHdr* Pool);
+
+	static inline TSize GetPoolBin(TMemPoolHdr* Pool);
+	inline void UpdatePoolBin(TMemPoolHdr* Pool);
+
+	//	Offset of the next pool header from the base of its block, the pools of a size class rotate
+	//	it by cache lines within the tail slack, so their headers and first blocks spread over the cache sets;
+	inline TSize GetPoolColor(TSize PoolVMBlockSize);
 
 	TMemPoolHdr* AddPool();
-	void DeletePool(TMemPoolHdr*);
+	void DeletePool(TMemPoolHdr* Pool, bool Cache = true);
+
+	bool CachePool(TMemPoolHdr* Pool);
+	void TrimCachedPools(TSize KeepCount);
+	void ReclaimPool(TMemPoolHdr* Pool);
+
+	inline TMemBlockHdr* CarveBlock(TMemPoolHdr* Pool, TSize BlockIndex);
+	inline TSize GetBlockGroup(TMemPoolHdr* Pool, TMemBlockHdr* Block);
+	bool RestorePurgedGroup(TMemPoolHdr* Pool);
+	TSize DetachFreeGroups(TMemPoolHdr* Pool, TMemPoolPageRange* OutRanges, TSize MaxRangeCount, TSize& InOutKeepSize);
 
 	TSize PoolIndex;
 	TSize BaseIndex;
 	TSize PoolCount;
 	TSize TotalFreeBlockCount;
-
-	TMemPoolHdr* HeadPool;
+	TSize DetachedBlockCount; // Free blocks of the groups detached for purging, not in TotalFreeBlockCount;
+	TSize CachedPoolCount;
+	TSize SparePoolCount;
+	TSize SpareLowWater;
+	bool  SpareRequested;
+	TSize GroupBlockCount;
+	TSize GroupStride; // Bytes of the blocks of a group, zero when the pool is not purged by groups;
+	TSize NextColor;
+
+	TMemPoolHdr* HeadPools[MALLOC_SCALED_MAX_THREAD_POOL_COUNT];
+	TMemPoolCache* PoolCache;
 
 	TSize BlockSize;
 
 	TSize PoolBlockSize;
 	TSize PoolVMBlockSize;
+	TSize ArenaSize;
+	void* ArenaOwner;
+
+	TMemPoolList PoolBins[POOL_BIN_COUNT];
+	TMemPoolList CachedPools;
+	TMemPoolList SparePools;
 
-	TMemPoolList PoolList;
+	TMallocCounters Counters;
 
 #ifdef MALLOC_STATS
 	TMemPoolStats Stats;
 #endif
 };
 
+template<typename TCONFIG>
 class alignas(MALLOC_SCALED_SYSTEM_DEFAULT_ALIGNMENT) 
 	TMemPoolTableEntry
 {
@@ -224,14 +489,14 @@ public:
 	{
 		Initialized      = false;
 		SubIndexCountShift    = 0;
-		MaxSubIndexCountShift = Log2_64(MALLOC_SCALED_MAX_SUBINDEX_COUNT);
+		MaxSubIndexCountShift = FloorLog2(TCONFIG::MaxSubIndexCount);
 	}
 
-	bool Init(TSize BaseIndex, TSize MinBaseBlockSize, TSize MaxBaseBlockSize, TSize CommitedSize, TSize SubIndexCount);
+	bool Init(TSize BaseIndex, TSize MinBaseBlockSize, TSize MaxBaseBlockSize, TSize CommitedSize, TSize SubIndexCount, TSize ArenaSize, void* ArenaOwner, TMemPoolCache* PoolCache);
 	void Release();
 
 	TSize GetPoolCount();
-	TMemPool* GetPool(TSize Index);
+	TMemPool<TCONFIG>* GetPool(TSize Index);
 
 private:
 	bool Initialized;
@@ -239,11 +504,14 @@ private:
 	TSize SubIndexCountShift;
 	TSize MaxSubIndexCountShift;
 
-	TMemPool Pools[MALLOC_SCALED_MAX_SUBINDEX_COUNT];
+	TMemPool<TCONFIG> Pools[TCONFIG::MaxSubIndexCount];
 };
 
+template<typename TCONFIG>
 class TMemPoolTable
 {
+	using TSizeClasses = TMallocScaledSizeClasses<TCONFIG>;
+
 	class TMemPoolTableStorage
 	{
 	public:
@@ -254,30 +522,31 @@ class TMemPoolTable
 			LastEntry  = nullptr;
 		}
 
-		bool Init(TSize EntryCount);
+		bool Init(TSize EntryCount, void* ArenaOwner);
 
-		TMemPoolTableEntry* GetFirst();
-		TMemPoolTableEntry* GetLast();
+		TMemPoolTableEntry<TCONFIG>* GetFirst();
+		TMemPoolTableEntry<TCONFIG>* GetLast();
 
-		TMemPoolTableEntry* GetEntry(TSize Index);
-		TSize GetEntryIndex(TMemPoolTableEntry* Entry);
+		TMemPoolTableEntry<TCONFIG>* GetEntry(TSize Index);
+		TSize GetEntryIndex(TMemPoolTableEntry<TCONFIG>* Entry);
 		TSize GetEntryCount();
 
-		TMemPoolTableEntry& operator[](TSize Index)
+		TMemPoolTableEntry<TCONFIG>& operator[](TSize Index)
 		{
 			return FirstEntry[Index];
 		}
 
 		void Free();
 		void Release();
+		void Drop();
 	private:
 
 		TSize EntryCount;
-		TMemPoolTableEntry* FirstEntry;
-		TMemPoolTableEntry* LastEntry;
+		TMemPoolTableEntry<TCONFIG>* FirstEntry;
+		TMemPoolTableEntry<TCONFIG>* LastEntry;
 
 		TVMBlock DataBlock;
-		static const TSize EntrySize = sizeof(TMemPoolTableEntry);
+		static const TSize EntrySize = sizeof(TMemPoolTableEntry<TCONFIG>);
 	};
 
 public:
@@ -314,6 +583,9 @@ public:
 		MinBaseBlockSize = 0;
 		MaxBaseIndex = 0;
 		MaxBaseBlockSize = 0;
+		StaticSizeClasses = false;
+
+		memset(PoolLookup, 0, sizeof(PoolLookup));
 	}
 
 	TSize GetPoolBlockSize();
@@ -325,7 +597,20 @@ public:
 	TSize GetMinBaseIndex();
 	TSize GetMaxBaseIndex();
 
-	TMemPoolTableEntry* GetEntry(TSize EntryNum);
+	TMemPoolTableEntry<TCONFIG>* GetEntry(TSize EntryNum);
+	TMemPoolCacheStats* GetPoolCacheStats();
+	void GetCounters(TMallocCounters& OutCounters);
+	TSize GetSizeClassCounters(TSizeClassCounters* OutCounters, TSize MaxCount);
+	TSize GetSizeClassStats(TSizeClassStats* OutStats, TSize MaxCount);
+
+	//	Cached pools fitting into InOutKeepSize stay, the part of it left unused is returned in InOutKeepSize;
+	TSize Trim(TSize& InOutKeepSize);
+	TSize DetachFreeGroups(TMemPoolPageRange* OutRanges, TSize MaxRangeCount, TSize& InOutKeepSize);
+	TSize GetReclaimPoolCount();
+	void TakeReclaimPools(TMemPoolList& OutPools);
+	static TSize FreePools(TMemPoolList& Pools);
+
+	inline TMemPool<TCONFIG>* GetPool(TSize BlockSize);
 
 	static TSize CalculateNumOfBaseEntries(TSize MinBaseBlockSize, TSize MaxBaseBlockSize);
 	static TSize CalculatePoolBlockSize(TSize BaseIndex, TSize PoolIndex, TSize MinBaseBlockSize, TSize MaxBaseBlockSize, TSize PoolIndexCount);
@@ -333,9 +618,20 @@ public:
 	static inline bool GetBaseIndex(TSize BlockSize, TSize MinBaseIndex, TSize MaxBaseIndex, TSize& OutBaseIdx);
 	static inline TSize GetPoolIndex(TSize BlockSize, TSize BaseIndex, TSize MinBaseIndex, TSize PoolIndexCount);
 
-	bool Init(TSize MinBaseBlockSize, TSize MaxBaseBlockSize, TSize PoolBlockSize, TSize SubIndexCount);
+	//	ArenaOwner: pools and table storage come from arenas reserved for the owner only;
+	bool Init(TSize MinBaseBlockSize, TSize MaxBaseBlockSize, TSize PoolBlockSize, TSize SubIndexCount, TSize ArenaSize = TCONFIG::ArenaSize, void* ArenaOwner = nullptr);
+	void SetPoolCacheLimits(TSize HighWater, TSize LowWater, TSize MaxCachedSize);
+	void SetPoolColorCount(TSize ColorCount);
+	void SetThreadPoolCount(TSize ThreadPoolCount);
+
+	//	Takes a head slot no live thread holds, returns false when all of them are held;
+	bool TakeHeadSlot(TSize& OutSlot);
+	void GiveBackHeadSlot(TSize Slot);
 	void Release();
 
+	//	Forgets all pools without touching them, for tables whose owned arenas are released as a whole;
+	void Drop();
+
 private:
 
 	TSize PoolBlockSize;
@@ -347,8 +643,16 @@ private:
 	TSize MaxBaseIndex;
 	TSize MaxBaseBlockSize;
 
+	//	Size classes are the configured ones, GetPool indexes by the TSizeClasses constants;
+	bool StaticSizeClasses;
+
 	TMemPoolTableStorage BaseEntries;
+	TMemPoolCache PoolCache;
 
+	//	Pools of block sizes up to TCONFIG::DirectLookupMaxSize indexed by BlockSize >> MALLOC_SCALED_DIRECT_LOOKUP_SHIFT;
+	TMemPool<TCONFIG>* PoolLookup[TSizeClasses::LookupCount];
+
+	void InitPoolLookup();
 	void UpdateStats();
 
 #ifdef MALLOC_STATS
@@ -356,6 +660,39 @@ private:
 #endif
 };
 
+//	Requests of the calling thread to the allocator and to all heaps, updated without atomics;
+extern thread_local TMallocCounters GThreadMallocCounters;
+
+//	Set when the process exits and the other threads have been ended already,
+//	e.g. DLL_PROCESS_DETACH with lpvReserved != NULL, the background threads must not be waited for then;
+extern bool GMallocProcessExiting;
+
+//	Head slots the calling thread holds in the heaps it allocated from, each of them is given back at thread exit;
+struct TThreadHeadSlots
+{
+	struct TEntry
+	{
+		void* Heap;
+		uint64 Epoch;
+		TSize Slot;
+		void (*Release)(void* Heap, uint64 Epoch, TSize Slot);
+	};
+
+	~TThreadHeadSlots()
+	{
+		for (TSize i = 0; i < EntryCount; ++i)
+		{
+			Entries[i].Release(Entries[i].Heap, Entries[i].Epoch, Entries[i].Slot);
+		}
+	}
+
+	TEntry Entries[MALLOC_SCALED_THREAD_HEAD_SLOT_COUNT];
+	TSize EntryCount;
+};
+
+extern thread_local TThreadHeadSlots GThreadHeadSlots;
+
+template<typename TCONFIG = TMallocScaledDefaultConfig>
 class TMallocScaled :
 	public TMallocBase
 {
@@ -363,6 +700,24 @@ public:
 	TMallocScaled()
 	{
 		Initialized = false;
+		ArenaOwner = nullptr;
+		BackgroundStop = false;
+		BackgroundRunning = false;
+		ReclaimQueued = false;
+		ReclaimRequested = false;
+		SpareRequestCount = 0;
+		PressureCallback = nullptr;
+		PressureContext = nullptr;
+		PressureBackoff = 0;
+		PressureSkips = 0;
+		PressureResidentSize = 0;
+		HeadSlotEpoch = 0;
+	}
+
+	//	The background thread uses the object, so it is joined before the object goes away;
+	~TMallocScaled()
+	{
+		StopBackgroundThread();
 	}
 
 	TMallocScaled(TMallocScaled&) = delete;
@@ -372,6 +727,7 @@ public:
 	TMallocScaled& operator=(TMallocScaled&&) = delete;
 
 	virtual void* Malloc(TSize Size, TSize Alignment = MALLOC_SCALED_SYSTEM_DEFAULT_ALIGNMENT) final;
+	virtual void* Calloc(TSize Count, TSize Size, TSize Alignment = MALLOC_SCALED_SYSTEM_DEFAULT_ALIGNMENT) final;
 	virtual void* Realloc(void* Addr, TSize NewSize, TSize NewAlignment = MALLOC_SCALED_SYSTEM_DEFAULT_ALIGNMENT) final;
 	virtual void  Free(void* Addr) final;
 	virtual TSize GetSize(void* Addr) final;
@@ -380,6 +736,36 @@ public:
 	virtual bool IsInitialized() final;
 	virtual void Shutdown() final;
 
+	//	Initializes a private heap: its pools live in arenas of its own, which Shutdown releases at once
+	//	instead of freeing the pools one by one. Zero fields of HeapConf take the defaults of TCONFIG;
+	bool InitHeap(const TMallocConf& HeapConf);
+
+	//	Creates the pools of the size class serving Size ahead of time, so the first Count allocations
+	//	of the class neither add pools nor page fault;
+	bool Prewarm(TSize Size, TSize Count, TSize Alignment = MALLOC_SCALED_SYSTEM_DEFAULT_ALIGNMENT);
+
+	//	Returns empty pools and the free pages of the own arenas and pools to the OS, like malloc_trim;
+	//	up to KeepBytes of them stay, spent on the cached pools first. Only free memory is walked.
+	//	Returns the size of the pools given back to the arenas plus the size purged from the arenas and the pools;
+	TSize Trim(TSize KeepBytes = 0);
+
+	//	Callback run by the background thread before it trims on memory pressure or above Conf.SoftLimit;
+	void SetMemoryPressureCallback(TMemoryPressureCallback Callback, void* Context);
+
+	//	Writes the heap profile sampled every Conf.ProfSampleInterval bytes, see THeapProfiler::Dump.
+	//	Returns false when the profiler is off;
+	bool DumpHeapProfile(TMallocWriter Writer, void* Context);
+
+	//	Writes every size class and every page allocator arena as JSON or Prometheus text.
+	//	The values are copied under the lock into a block of the page allocator and written out of it,
+	//	so Writer may allocate. Returns false when the snapshot block cannot be allocated;
+	bool DumpStats(EMallocStatsFormat Format, TMallocWriter Writer, void* Context);
+
+	//	Records every Malloc, Calloc, Realloc and Free into a binary trace at Path until StopTrace or Shutdown,
+	//	see TAllocTracer. Init starts it when MALLOC_SCALED_TRACE is set;
+	bool StartTrace(const char* Path);
+	void StopTrace();
+
 	virtual TSize GetMallocMaxAlignment() final;
 	virtual void GetSpecificStats(void* OutStatData) final;
 
@@ -387,18 +773,83 @@ public:
 	TSize GetBlockSize(TSize BaseIndex, TSize PoolIndex);
 	TSize GetBlockCount(TSize BaseIndex, TSize PoolIndex);
 	TSize GetMaxPoolBlockSize();
+	TSize GetGoodSize(TSize Size, TSize Alignment);
+	void GetPoolCacheStats(TMemPoolCacheStats& OutStats);
+
+	//	Sums of the size class counters, GetSizeClassCounters returns the number of classes written;
+	void GetCounters(TMallocCounters& OutCounters);
+	TSize GetSizeClassCounters(TSizeClassCounters* OutCounters, TSize MaxCount);
+
+	//	Pools, blocks and bytes of every size class, returns the number of classes written;
+	TSize GetSizeClassStats(TSizeClassStats* OutStats, TSize MaxCount);
+
+	void GetConf(TMallocConf& OutConf);
 
 	void DebugInit(TSize MinBaseBlockSize, TSize MaxBaseBlockSize, TSize PoolBlockSize, uint32 SubIndexCount);
 
 private:
-	inline void* MallocInternal(TSize Size, TSize Alignment);
+	inline void* MallocInternal(TSize Size, TSize Alignment, bool& OutUntouched);
+
+	//	Index of the calling thread, given out in the order threads first allocate;
+	static inline TSize GetThreadIndex();
+
+	//	Head slot of the calling thread, a free one is taken on its first allocation and given back at thread exit.
+	//	Threads beyond ThreadPoolCount share the slots. Called under Guard;
+	inline TSize GetHeadSlot();
+	static void ReleaseHeadSlot(void* Heap, uint64 Epoch, TSize Slot);
 	inline void* ReallocInternal(void* Addr, TSize Size, TSize Alignment);
 	inline void  FreeInternal(void* Addr);
 	TSize GetSizeInternal(void* Addr);
+	bool PrewarmInternal(TSize Size, TSize Count, TSize Alignment);
+
+	bool InitInternal();
+	void InitConf(const TMallocConf& UserConf);
+
+	//	The background thread builds spare pools for the size classes running low on free blocks,
+	//	so the allocating thread swaps in a faulted in pool instead of mapping one;
+	void StartBackgroundThread();
+	void StopBackgroundThread();
+	void BackgroundThreadLoop();
+	inline void RequestSparePool(TMemPool<TCONFIG>* Pool);
+
+	//	Empty pools are unmapped by the background thread, or stay queued until Trim or Shutdown
+	//	when it is not running; never on the free path. ReclaimPending is called under Guard;
+	inline void ReclaimPending();
+	TSize ReclaimPools();
+
+	//	Purges the pages of free block groups in sparsely used pools beyond KeepSize bytes, returns the purged size;
+	TSize ReclaimPoolPages(TSize KeepSize = 0);
+
+	//	Runs the pressure callback and Trim when Conf.SoftLimit is exceeded or the platform reports memory pressure.
+	//	While the pressure lasts the trims back off, longer each time the resident size has not dropped;
+	bool CheckMemoryPressure();
 
 	bool Initialized;
-	TMemPoolTable PoolTable;
+	void* ArenaOwner; // this for heaps created by InitHeap, nullptr for the allocator sharing the arenas;
+	TMallocConf Conf;
+	TMemPoolTable<TCONFIG> PoolTable;
 	TCriticalSection Guard;
+
+	std::thread BackgroundThread;
+	std::mutex BackgroundGuard; // Guards the request queue only, never held while taking Guard;
+	std::condition_variable BackgroundWakeup;
+	bool BackgroundStop;
+	bool BackgroundRunning; // Changed under Guard;
+	bool ReclaimQueued;     // Changed under Guard, the background thread was asked to reclaim;
+	bool ReclaimRequested;  // Changed under BackgroundGuard;
+	TMemPool<TCONFIG>* SpareRequests[MALLOC_SCALED_SPARE_REQUEST_COUNT];
+	TSize SpareRequestCount;
+
+	TMemoryPressureCallback PressureCallback;
+	void* PressureContext;
+	TSize PressureBackoff;      // Used by the background thread only;
+	TSize PressureSkips;        // Used by the background thread only;
+	TSize PressureResidentSize; // Used by the background thread only, resident size at the last pressure trim;
+
+	uint64 HeadSlotEpoch; // Changed under Guard at Init and Shutdown, slots taken in an earlier epoch are not given back;
+
+	THeapProfiler Profiler;
+	TAllocTracer Tracer;
 };
 
 
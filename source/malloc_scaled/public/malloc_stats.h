@@ -134,6 +134,99 @@ struct TMallocStats
 
 
 
+/*
+-------------------------------------
+	Empty memory pool cache stats
+-------------------------------------
+*/
+
+struct TMemPoolCacheStats
+{
+	TMemPoolCacheStats() :
+		Hits(0),
+		Misses(0),
+		Evictions(0),
+		Provisioned(0),
+		PurgedGroups(0),
+		PressureTrims(0),
+		CachedPoolCount(0),
+		CachedSize(0),
+		PeakCachedSize(0)
+	{
+	}
+
+	uint64 Hits;          // New pool was taken from the cache;
+	uint64 Misses;        // New pool was allocated from the page allocator;
+	uint64 Evictions;     // Empty pool was returned to the page allocator;
+	uint64 Provisioned;   // New pool was a spare made ready by the background thread;
+	uint64 PurgedGroups;  // Free blocks of a pool in use had their pages given back to the OS;
+	uint64 PressureTrims; // Trim was run on memory pressure or above the soft limit;
+
+	TSize CachedPoolCount;
+	TSize CachedSize;
+	TSize PeakCachedSize;
+};
+
+/*
+---------------------------------------------------------
+	Always on counters of requests and requested bytes,
+	kept per size class and per thread
+---------------------------------------------------------
+*/
+
+struct TMallocCounters
+{
+	TMallocCounters() :
+		MallocCount(0),
+		FreeCount(0),
+		Allocated(0),
+		Deallocated(0)
+	{
+	}
+
+	uint64 MallocCount;
+	uint64 FreeCount;
+	uint64 Allocated;   // Requested bytes, a realloc in place counts its new size;
+	uint64 Deallocated; // Requested bytes of the freed blocks, a realloc in place counts its old size;
+};
+
+struct TSizeClassCounters
+{
+	TSize BlockSize;
+	TMallocCounters Counters;
+};
+
+/*
+---------------------------------------------------------
+	Size class layout written out by DumpStats
+---------------------------------------------------------
+*/
+
+enum EMallocStatsFormat : uint32
+{
+	MALLOC_STATS_FORMAT_JSON,
+	MALLOC_STATS_FORMAT_PROMETHEUS
+};
+
+struct TSizeClassStats
+{
+	TSize BlockSize;
+	TSize PoolCount;
+	TSize CachedPoolCount;
+	TSize SparePoolCount;
+
+	TSize TotalBlockCount;
+	TSize UsedBlockCount;
+	TSize FreeBlockCount;
+
+	TSize RequestedSize; // Requested bytes of the used blocks;
+	TSize ConsumedSize;  // Block bytes of the used blocks;
+	TSize MappedSize;    // Bytes of the pools in use, without the cached and spare ones;
+
+	TSize MallocCount;
+	TSize FreeCount;
+};
+
 struct TMallocTimeStats
 {
 	TTimeStats BlockAllocTime;
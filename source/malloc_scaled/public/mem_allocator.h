@@ -3,6 +3,9 @@
 #include "malloc_scaled.h"
 #include "defs.h"
 
+static const TSize MALLOC_SCALED_MAX_HEAP_COUNT = 32;
+static const TSize MALLOC_SCALED_MAX_LARGE_BUFFER_HEAP_COUNT = 8;
+
 enum EMAllocToUse
 {
 	None,
@@ -16,13 +19,19 @@ public:
 	static IMalloc* GetMalloc();
 
 
-	static TMallocScaled* GetMallocObject();
+	static TMallocScaled<>* GetMallocObject();
 
 
 	static bool Init(EMAllocToUse MallocToUse);
 	static void Shutdown();
 	static TMemoryAllocator* GetMemoryAllocator();
 
+	//	Heaps have their own pool table and arenas and do not share a lock with the default allocator;
+	//	Conf.LargeBuffers picks a heap with the TMallocScaledLargeBufferConfig size classes;
+	static IMalloc* CreateHeap(const TMallocConf& Conf);
+	static bool DestroyHeap(IMalloc* Heap);
+	static bool DumpHeapProfile(IMalloc* Heap, TMallocWriter Writer, void* Context);
+
 private:
 	TMemoryAllocator()
 	{
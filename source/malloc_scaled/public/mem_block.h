@@ -7,15 +7,17 @@ class TMemoryBlock
 public:
 	TMemoryBlock() :
 		Size(0),
-		Base(nullptr)
+		Base(nullptr),
+		Untouched(false)
 	{
 
 	}
 
 
-	TMemoryBlock(void* Ptr, TSize Size):
+	TMemoryBlock(void* Ptr, TSize Size, bool Untouched = false):
 		Size(Size),
-		Base(Ptr)
+		Base(Ptr),
+		Untouched(Untouched)
 	{
 
 	}
@@ -35,8 +37,15 @@ public:
 		return (uint8_t*)Base + Size;
 	}
 
+	//	Pages of the block were never handed out since the OS committed them, so they read as zero;
+	bool IsUntouched() const
+	{
+		return Untouched;
+	}
+
 private:
 	TSize Size;
 	void* Base;
+	bool Untouched;
 };
 
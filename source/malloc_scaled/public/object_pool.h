@@ -0,0 +1,411 @@
+#pragma once
+
+#include "std.h"
+#include "align.h"
+#include "element_build.h"
+#include "lib_malloc.h"
+#include "critical_section.h"
+
+#include <atomic>
+
+static const TSize OBJECT_POOL_SLAB_SIZE       = 65536; // Bytes;
+static const TSize OBJECT_POOL_MIN_SLAB_SLOTS  = 16;
+static const TSize OBJECT_POOL_CACHE_BATCH     = 32;
+static const TSize OBJECT_POOL_SLAB_ALIGNMENT  = 16;    // Bytes;
+
+//	Pool of objects of a single type.
+//	Slots have the exact size and alignment of T and no header: a free slot keeps the link
+//	to the next free one, so an object must be destroyed by the pool it was created by.
+//	Slabs are taken from the allocator and are given back by Release or the destructor,
+//	neither may run while another thread uses the pool or one of its caches;
+template<typename T>
+class TObjectPool
+{
+	union TSlot
+	{
+		TSlot* Next;
+		alignas(T) uint8 Data[sizeof(T)];
+	};
+
+	struct TSlabHdr
+	{
+		TSlabHdr* Next;
+	};
+
+public:
+	static constexpr TSize SlotSize      = sizeof(TSlot);
+	static constexpr TSize SlotAlignment = alignof(TSlot);
+
+	//	Per thread cache of free slots, e.g. thread_local TObjectPool<T>::TCache Cache(Pool);
+	//	the pool lock is taken once per batch of slots. The pool keeps track of its caches:
+	//	Release drops the slots they hold and the pool destructor detaches them;
+	class TCache
+	{
+		friend class TObjectPool;
+
+	public:
+		explicit TCache(TObjectPool& Pool, TSize BatchSize = OBJECT_POOL_CACHE_BATCH) :
+			Pool(&Pool),
+			PrevCache(nullptr),
+			NextCache(nullptr),
+			FreeSlots(nullptr),
+			FreeSlotCount(0),
+			BatchSize(BatchSize ? BatchSize : 1),
+			ObjectCount(0)
+		{
+			Pool.AttachCache(this);
+		}
+
+		TCache(TCache&) = delete;
+		TCache& operator=(TCache&) = delete;
+
+		~TCache()
+		{
+			if (Pool)
+			{
+				Flush();
+				Pool->DetachCache(this);
+			}
+		}
+
+		template<typename... TARGS>
+		T* Create(TARGS&&... Args)
+		{
+			if (!FreeSlots)
+			{
+				if (!Pool)
+				{
+					return nullptr;
+				}
+
+				FreeSlotCount = Pool->AllocateSlots(FreeSlots, BatchSize);
+
+				if (!FreeSlots)
+				{
+					return nullptr;
+				}
+			}
+
+			TSlot* Slot = FreeSlots;
+			FreeSlots = Slot->Next;
+			--FreeSlotCount;
+
+			T* Object = (T*)Slot;
+			CreateElementsFromArgs(Object, 1, forward<TARGS>(Args)...);
+			ObjectCount.store(ObjectCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+			return Object;
+		}
+
+		void Destroy(T* Object)
+		{
+			if (!Object || !Pool)
+			{
+				return;
+			}
+
+			DestroyElements(Object, 1);
+			ObjectCount.store(ObjectCount.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+
+			TSlot* Slot = (TSlot*)Object;
+			Slot->Next = FreeSlots;
+			FreeSlots = Slot;
+			++FreeSlotCount;
+
+			if (FreeSlotCount >= BatchSize * 2)
+			{
+				FlushSlots(BatchSize);
+			}
+		}
+
+		void Flush()
+		{
+			FlushSlots(FreeSlotCount);
+		}
+
+	private:
+		void FlushSlots(TSize Count)
+		{
+			if (!Count)
+			{
+				return;
+			}
+
+			TSlot* First = FreeSlots;
+			TSlot* Last = First;
+
+			for (TSize i = 1; i < Count; ++i)
+			{
+				Last = Last->Next;
+			}
+
+			FreeSlots = Last->Next;
+			FreeSlotCount -= Count;
+
+			Pool->ReleaseSlots(First, Last);
+		}
+
+		TObjectPool* Pool;
+		TCache* PrevCache;
+		TCache* NextCache;
+		TSlot* FreeSlots;
+		TSize FreeSlotCount;
+		TSize BatchSize;
+
+		//	Objects created minus objects destroyed through this cache, written by the owner thread only,
+		//	an object may be destroyed by another cache or the pool so the value may be negative;
+		std::atomic<int64> ObjectCount;
+	};
+
+	explicit TObjectPool(TSize SlabSize = OBJECT_POOL_SLAB_SIZE) :
+		FreeSlotList(nullptr),
+		BumpPtr(nullptr),
+		BumpEnd(nullptr),
+		Slabs(nullptr),
+		Caches(nullptr),
+		SlabCount(0),
+		ObjectCount(0)
+	{
+		TSize MinSlabSize = SlabHdrSize + SlotSize * OBJECT_POOL_MIN_SLAB_SLOTS;
+		this->SlabSize = SlabSize > MinSlabSize ? SlabSize : MinSlabSize;
+	}
+
+	TObjectPool(TObjectPool&) = delete;
+	TObjectPool& operator=(TObjectPool&) = delete;
+
+	~TObjectPool()
+	{
+		Release();
+
+		Guard.Lock();
+
+		while (Caches)
+		{
+			TCache* Cache = Caches;
+			Caches = Cache->NextCache;
+			Cache->Pool = nullptr;
+			Cache->PrevCache = nullptr;
+			Cache->NextCache = nullptr;
+		}
+
+		Guard.Unlock();
+	}
+
+	template<typename... TARGS>
+	T* Create(TARGS&&... Args)
+	{
+		TSlot* Slot = nullptr;
+
+		if (!AllocateSlots(Slot, 1))
+		{
+			return nullptr;
+		}
+
+		T* Object = (T*)Slot;
+		CreateElementsFromArgs(Object, 1, forward<TARGS>(Args)...);
+		ObjectCount.fetch_add(1, std::memory_order_relaxed);
+
+		return Object;
+	}
+
+	void Destroy(T* Object)
+	{
+		if (!Object)
+		{
+			return;
+		}
+
+		DestroyElements(Object, 1);
+		ObjectCount.fetch_sub(1, std::memory_order_relaxed);
+
+		TSlot* Slot = (TSlot*)Object;
+		ReleaseSlots(Slot, Slot);
+	}
+
+	//	Gives all slabs back, objects still alive are lost without their destructors being called.
+	//	Slots held by the caches are in these slabs, so the caches are emptied as well;
+	void Release()
+	{
+		Guard.Lock();
+
+		for (TCache* Cache = Caches; Cache; Cache = Cache->NextCache)
+		{
+			Cache->FreeSlots = nullptr;
+			Cache->FreeSlotCount = 0;
+			Cache->ObjectCount.store(0, std::memory_order_relaxed);
+		}
+
+		while (Slabs)
+		{
+			TSlabHdr* Slab = Slabs;
+			Slabs = Slab->Next;
+			::Free(Slab);
+		}
+
+		FreeSlotList = nullptr;
+		BumpPtr = nullptr;
+		BumpEnd = nullptr;
+		SlabCount = 0;
+		ObjectCount.store(0, std::memory_order_relaxed);
+
+		Guard.Unlock();
+	}
+
+	//	Objects alive, created and not destroyed yet by the pool or any of its caches.
+	//	The caches are counted without stopping their threads, so the value is a snapshot;
+	TSize GetObjectCount()
+	{
+		Guard.Lock();
+
+		int64 Count = ObjectCount.load(std::memory_order_relaxed);
+
+		for (TCache* Cache = Caches; Cache; Cache = Cache->NextCache)
+		{
+			Count += Cache->ObjectCount.load(std::memory_order_relaxed);
+		}
+
+		Guard.Unlock();
+
+		return Count > 0 ? (TSize)Count : 0;
+	}
+
+	TSize GetSlabCount()
+	{
+		return SlabCount;
+	}
+
+	TSize GetAllocatedSize()
+	{
+		return SlabCount * SlabSize;
+	}
+
+private:
+	static constexpr TSize SlabHdrSize = AlignToUpper(sizeof(TSlabHdr), SlotAlignment);
+
+	//	Links up to Count free slots into OutFirst, returns the number of linked slots;
+	TSize AllocateSlots(TSlot*& OutFirst, TSize Count)
+	{
+		TSlot* First = nullptr;
+		TSize Allocated = 0;
+
+		Guard.Lock();
+
+		while (Allocated < Count)
+		{
+			TSlot* Slot = FreeSlotList;
+
+			if (Slot)
+			{
+				FreeSlotList = Slot->Next;
+			}
+			else
+			{
+				if (BumpPtr == BumpEnd && !AddSlab())
+				{
+					break;
+				}
+
+				Slot = (TSlot*)BumpPtr;
+				BumpPtr += SlotSize;
+			}
+
+			Slot->Next = First;
+			First = Slot;
+			++Allocated;
+		}
+
+		Guard.Unlock();
+
+		OutFirst = First;
+		return Allocated;
+	}
+
+	void ReleaseSlots(TSlot* First, TSlot* Last)
+	{
+		Guard.Lock();
+
+		Last->Next = FreeSlotList;
+		FreeSlotList = First;
+
+		Guard.Unlock();
+	}
+
+	void AttachCache(TCache* Cache)
+	{
+		Guard.Lock();
+
+		Cache->NextCache = Caches;
+
+		if (Caches)
+		{
+			Caches->PrevCache = Cache;
+		}
+
+		Caches = Cache;
+
+		Guard.Unlock();
+	}
+
+	void DetachCache(TCache* Cache)
+	{
+		Guard.Lock();
+
+		//	Objects created through the cache outlive it;
+		ObjectCount.fetch_add(Cache->ObjectCount.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		Cache->ObjectCount.store(0, std::memory_order_relaxed);
+
+		if (Cache->PrevCache)
+		{
+			Cache->PrevCache->NextCache = Cache->NextCache;
+		}
+		else
+		{
+			Caches = Cache->NextCache;
+		}
+
+		if (Cache->NextCache)
+		{
+			Cache->NextCache->PrevCache = Cache->PrevCache;
+		}
+
+		Cache->PrevCache = nullptr;
+		Cache->NextCache = nullptr;
+
+		Guard.Unlock();
+	}
+
+	bool AddSlab()
+	{
+		TSize Alignment = SlotAlignment > OBJECT_POOL_SLAB_ALIGNMENT ? SlotAlignment : OBJECT_POOL_SLAB_ALIGNMENT;
+		TSlabHdr* Slab = (TSlabHdr*)::Malloc(SlabSize, Alignment);
+
+		if (!Slab)
+		{
+			return false;
+		}
+
+		Slab->Next = Slabs;
+		Slabs = Slab;
+		++SlabCount;
+
+		TSize SlotCount = (SlabSize - SlabHdrSize) / SlotSize;
+		BumpPtr = (uint8*)Slab + SlabHdrSize;
+		BumpEnd = BumpPtr + SlotCount * SlotSize;
+
+		return true;
+	}
+
+	TCriticalSection Guard;
+
+	TSlot* FreeSlotList;
+	uint8* BumpPtr;
+	uint8* BumpEnd;
+	TSlabHdr* Slabs;
+	TCache* Caches;
+
+	TSize SlabSize;
+	TSize SlabCount;
+
+	//	Objects created minus objects destroyed by the pool itself and by the detached caches;
+	std::atomic<int64> ObjectCount;
+};
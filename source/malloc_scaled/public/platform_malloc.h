@@ -74,6 +74,18 @@ public:
 	virtual bool CommitMemoryBlock(TPlatformMemoryBlock InBlock) = 0;
 	virtual bool DecommitMemoryBlock(TPlatformMemoryBlock InBlock) = 0;
 
+	//	Faults the pages of a committed block in ahead of use, their contents are kept;
+	virtual bool PopulateMemoryBlock(TPlatformMemoryBlock InBlock) = 0;
+
+	//	Gives the frames of a committed block back to the OS, the pages stay usable and their contents are lost;
+	virtual bool PurgeMemoryBlock(TPlatformMemoryBlock InBlock) = 0;
+
+	//	Resident size of the process, zero when it cannot be read;
+	virtual TSize GetResidentSize() = 0;
+
+	//	The system or the container the process runs in is short of memory;
+	virtual bool IsMemoryPressure() = 0;
+
 	virtual bool SetMemBlockProtection(TPlatformMemoryBlock Block, TMemoryBlockAccess AccessFlag) = 0;
 
 	virtual bool IsPagingSupported() = 0;
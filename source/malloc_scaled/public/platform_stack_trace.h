@@ -0,0 +1,9 @@
+#pragma once
+
+#include "build.h"
+
+#if PLATFORM_WIN
+#include "win\win_platform_stack_trace.h"
+#elif PLATFORM_UNIX
+#include "unix\unix_platform_stack_trace.h"
+#endif
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "imalloc.h"
+#include "vm_block.h"
+
+static const TSize REGION_DEFAULT_RESERVE_SIZE = 67108864; // Bytes;
+static const TSize REGION_DEFAULT_COMMIT_SIZE  = 65536;    // Bytes;
+static const TSize REGION_DEFAULT_ALIGNMENT    = 16;       // Bytes;
+
+struct TRegionMark
+{
+	uint8* Top;
+};
+
+//	Bump pointer allocator over a single reserved block, for short lived groups of allocations
+//	like a request or a frame that die together. Pages are committed by chunks as the top grows.
+//	Free only takes back the last allocation, everything else is returned by Rollback or Reset.
+//	Not thread safe, a region is meant to be owned by a single thread;
+class TRegionAllocator :
+	public IMalloc
+{
+	struct TRegionBlockHdr
+	{
+		TSize Size;
+	};
+
+public:
+	TRegionAllocator();
+	~TRegionAllocator();
+
+	TRegionAllocator(TRegionAllocator&) = delete;
+	TRegionAllocator& operator=(TRegionAllocator&) = delete;
+
+	//	ReserveSize is the capacity of the region, CommitSize is the step the committed part grows by;
+	bool Init(TSize ReserveSize = REGION_DEFAULT_RESERVE_SIZE, TSize CommitSize = REGION_DEFAULT_COMMIT_SIZE);
+	void Release();
+
+	virtual void* Malloc(TSize Size, TSize Alignment = REGION_DEFAULT_ALIGNMENT) final;
+	virtual void* Calloc(TSize Count, TSize Size, TSize Alignment = REGION_DEFAULT_ALIGNMENT) final;
+	virtual void* Realloc(void* Addr, TSize NewSize, TSize NewAlignment = REGION_DEFAULT_ALIGNMENT) final;
+	virtual void  Free(void* Addr) final;
+	virtual TSize GetSize(void* Addr) final;
+
+	TRegionMark Mark();
+	void Rollback(TRegionMark Mark);
+
+	//	Drops all allocations at once, Decommit also gives back the pages above the first commit chunk;
+	void Reset(bool Decommit = false);
+
+	bool IsInitialized();
+
+	TSize GetUsedSize();
+	TSize GetCommittedSize();
+	TSize GetReservedSize();
+
+private:
+	inline bool CommitTo(uint8* NewTop);
+
+	static constexpr TSize BlockHdrSize = sizeof(TRegionBlockHdr);
+
+	TVMBlock VMBlock;
+
+	uint8* Base;
+	uint8* Top;
+	uint8* CommitEnd;
+	uint8* End;
+
+	uint8* LastBlock;
+	uint8* LastTop;
+
+	TSize CommitSize;
+};
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "std.h"
+#include "malloc_stats.h"
+#include "vm_block.h"
+
+//	Writes the size classes and the page allocator arenas as one JSON object or as Prometheus text metrics.
+//	Lines are formatted on the stack, nothing is allocated. Returns false for an unknown format;
+bool WriteMallocStats(EMallocStatsFormat Format, const TSizeClassStats* Classes, TSize ClassCount,
+	const TPageMallocArenaStats* Arenas, TSize ArenaCount, TMallocWriter Writer, void* Context);
@@ -13,6 +13,10 @@
 #include "defs.h"
 #include <cstring>
 
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 using std::move;
 using std::swap;
 using std::find_if;
@@ -44,6 +48,9 @@ typedef double float64;
 
 typedef std::chrono::duration<std::chrono::high_resolution_clock::rep, std::nano> TDuration;
 
+//	Receives text written by the allocator reports, called with chunks which are not null terminated;
+typedef void (*TMallocWriter)(const char* Data, TSize Size, void* Context);
+
 #define KiB 1024
 #define MiB 1024*1024
 #define GiB 1024*1024*1024
@@ -59,6 +66,28 @@ inline constexpr uint64 CeilLog2(uint64 x)
 	return x == 1 ? 0 : FloorLog2(x - 1) + 1;
 }
 
+//	Runtime variants of log2 based on lzcnt/bsr, x must not be 0;
+inline uint64 CountLeadingZeros64(uint64 x)
+{
+#if defined(_MSC_VER)
+	unsigned long Index = 0;
+	_BitScanReverse64(&Index, x);
+	return 63 - Index;
+#else
+	return __builtin_clzll(x);
+#endif
+}
+
+inline uint64 FloorLog2Fast(uint64 x)
+{
+	return 63 - CountLeadingZeros64(x);
+}
+
+inline uint64 CeilLog2Fast(uint64 x)
+{
+	return x == 1 ? 0 : 64 - CountLeadingZeros64(x - 1);
+}
+
 template<class T>
 inline constexpr bool IsPow2(T Size)
 {
@@ -3,6 +3,14 @@
 
 #include "std.h"
 
+//	Log-linear (HDR) latency histogram: every power of two of nanoseconds is split into
+//	TIME_STATS_SUB_BUCKET_COUNT linear buckets, so a percentile is within 1/32 of the measured value.
+//	Intervals from 2^TIME_STATS_MAX_LOG2 ns (about 18 minutes) on fall into the last bucket;
+static const uint64 TIME_STATS_SUB_BUCKET_BITS  = 5;
+static const uint64 TIME_STATS_SUB_BUCKET_COUNT = 1ull << TIME_STATS_SUB_BUCKET_BITS;
+static const uint64 TIME_STATS_MAX_LOG2         = 40;
+static const uint64 TIME_STATS_BUCKET_COUNT     = (TIME_STATS_MAX_LOG2 - TIME_STATS_SUB_BUCKET_BITS + 1) * TIME_STATS_SUB_BUCKET_COUNT;
+
 class TTimeStats
 {
 public:
@@ -26,6 +34,7 @@ public:
 		TotalTime = {};
 
 		MeasureCount = 0;
+		memset(Buckets, 0, sizeof(Buckets));
 	}
 
 	void AddInterval(TDuration TimeInterval)
@@ -41,6 +50,85 @@ public:
 
 		TotalTime += TimeInterval;
 		AvgTime = TotalTime / MeasureCount;
+
+		++Buckets[GetBucketIndex(TimeInterval.count() > 0 ? (uint64)TimeInterval.count() : 0)];
+	}
+
+	//	Adds Count measures of BatchTime / Count, for operations too short to be timed one by one;
+	void AddBatch(TDuration BatchTime, uint64 Count)
+	{
+		if (!Count)
+		{
+			return;
+		}
+
+		TDuration Time = BatchTime / Count;
+
+		LastTime = Time;
+		MeasureCount += Count;
+
+		if (Time > MaxTime)
+			MaxTime = Time;
+
+		if (Time < MinTime)
+			MinTime = Time;
+
+		TotalTime += BatchTime;
+		AvgTime = TotalTime / MeasureCount;
+
+		Buckets[GetBucketIndex(Time.count() > 0 ? (uint64)Time.count() : 0)] += Count;
+	}
+
+	//	Adds the measures of another instance, e.g. of another thread;
+	void Merge(const TTimeStats& Other)
+	{
+		if (!Other.MeasureCount)
+		{
+			return;
+		}
+
+		if (Other.MaxTime > MaxTime)
+			MaxTime = Other.MaxTime;
+
+		if (Other.MinTime < MinTime)
+			MinTime = Other.MinTime;
+
+		LastTime = Other.LastTime;
+		TotalTime += Other.TotalTime;
+		MeasureCount += Other.MeasureCount;
+		AvgTime = TotalTime / MeasureCount;
+
+		for (uint64 i = 0; i < TIME_STATS_BUCKET_COUNT; ++i)
+		{
+			Buckets[i] += Other.Buckets[i];
+		}
+	}
+
+	//	Upper bound of the bucket holding the Percentile (0..100) measure, clamped to the max time;
+	TDuration GetPercentileTime(float64 Percentile)
+	{
+		if (!MeasureCount)
+		{
+			return TDuration{};
+		}
+
+		uint64 Rank = (uint64)std::ceil(Percentile / 100.0 * MeasureCount);
+		Rank = Rank ? (Rank < MeasureCount ? Rank : MeasureCount) : 1;
+
+		uint64 Count = 0;
+
+		for (uint64 i = 0; i < TIME_STATS_BUCKET_COUNT; ++i)
+		{
+			Count += Buckets[i];
+
+			if (Count >= Rank && i < TIME_STATS_BUCKET_COUNT - 1)
+			{
+				TDuration Time{ (TDuration::rep)GetBucketUpperBound(i) };
+				return Time < MaxTime ? Time : MaxTime;
+			}
+		}
+
+		return MaxTime;
 	}
 
 	TTimeStats& operator+(TDuration TimeInterval)
@@ -85,6 +173,37 @@ public:
 	}
 
 private:
+	static inline uint64 GetBucketIndex(uint64 Nanoseconds)
+	{
+		if (Nanoseconds < TIME_STATS_SUB_BUCKET_COUNT)
+		{
+			return Nanoseconds;
+		}
+
+		uint64 Shift = FloorLog2Fast(Nanoseconds) - TIME_STATS_SUB_BUCKET_BITS;
+
+		if (Shift >= TIME_STATS_MAX_LOG2 - TIME_STATS_SUB_BUCKET_BITS)
+		{
+			return TIME_STATS_BUCKET_COUNT - 1;
+		}
+
+		//	(Nanoseconds >> Shift) is in [SUB_BUCKET_COUNT, 2 * SUB_BUCKET_COUNT);
+		return Shift * TIME_STATS_SUB_BUCKET_COUNT + (Nanoseconds >> Shift);
+	}
+
+	static inline uint64 GetBucketUpperBound(uint64 Index)
+	{
+		if (Index < 2 * TIME_STATS_SUB_BUCKET_COUNT)
+		{
+			return Index;
+		}
+
+		uint64 Shift = Index / TIME_STATS_SUB_BUCKET_COUNT - 1;
+		uint64 Sub = Index % TIME_STATS_SUB_BUCKET_COUNT + TIME_STATS_SUB_BUCKET_COUNT;
+
+		return ((Sub + 1) << Shift) - 1;
+	}
+
 
 	TDuration MaxTime;
 	TDuration MinTime;
@@ -93,4 +212,5 @@ private:
 	TDuration TotalTime;
 
 	uint64 MeasureCount;
+	uint64 Buckets[TIME_STATS_BUCKET_COUNT] = {};
 };
\ No newline at end of file
@@ -19,6 +19,11 @@ public:
 
 	virtual bool CommitMemoryBlock(TPlatformMemoryBlock InBlock);
 	virtual bool DecommitMemoryBlock(TPlatformMemoryBlock InBlock);
+	virtual bool PopulateMemoryBlock(TPlatformMemoryBlock InBlock);
+	virtual bool PurgeMemoryBlock(TPlatformMemoryBlock InBlock);
+
+	virtual TSize GetResidentSize();
+	virtual bool IsMemoryPressure();
 
 	virtual bool SetMemBlockProtection(TPlatformMemoryBlock InBlock, TMemoryBlockAccess ProtFlag);
 
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "build.h"
+#include "std.h"
+
+#if PLATFORM_UNIX
+class TUnixPlatformStackTrace
+{
+public:
+	//	Loads the unwinder ahead of time, its first use may allocate;
+	static void Init();
+
+	//	Return addresses of the calling thread, SkipCount frames above the caller are dropped.
+	//	Returns the number of frames written;
+	static TSize Capture(void** OutFrames, TSize MaxCount, TSize SkipCount);
+
+	//	Writes the mapped modules of the process in the /proc/self/maps format, returns false when they cannot be read;
+	static bool WriteModuleMap(TMallocWriter Writer, void* Context);
+};
+
+using TPlatformStackTrace = TUnixPlatformStackTrace;
+#endif
@@ -7,6 +7,7 @@
 #include "mem_block.h"
 
 class IPageMalloc;
+struct TPageMallocArenaStats;
 
 static constexpr int32 PAGE_MALLOC_MAX_ARENA_COUNT = 256;
 
@@ -24,25 +25,53 @@ public:
 	TVMBlock(TVMBlock&) = delete;
 	TVMBlock& operator=(TVMBlock&) = delete;
 
-	static bool Init();
+	static bool Init(TSize ArenaPageSize = 0, TSize ArenaSize = 0);
 	static void Release();
 
-	bool Allocate(TSize Size);
+	//	Arenas reserved for an owner only serve blocks allocated for that owner and are released together;
+	static bool ReleaseArenas(void* ArenaOwner);
+	//	Releases the arenas shared by all allocations, owned arenas are left to their owners;
+	static bool ReleaseSharedArenas();
+
+	bool Allocate(TSize Size, TSize ArenaSize = 0, void* ArenaOwner = nullptr); // ArenaSize: size of a new arena to reserve when no arena has room;
 	bool Allocate(void* Address, TSize Size); // !!! Reserve pages at specific address;
 	void Free();
 
 	bool SetProtection(void* Offset, TSize Size, TMemoryBlockAccess AccessFlag);
 
+	//	Pages of a decommitted range must be committed again before they are used or the block is freed;
+	bool Commit(void* Offset, TSize Size);
+	bool Decommit(void* Offset, TSize Size);
+
+	//	Faults all pages of the block in, so the first writes do not page fault;
+	bool Populate();
+
+	//	Gives the frames of a range back to the OS, the pages stay usable and read as garbage or zero;
+	bool Purge(void* Offset, TSize Size);
+
+	//	Gives the pages of free arena runs back to the OS and releases empty arenas, returns the purged size.
+	//	Only the arenas of ArenaOwner are purged, nullptr means the shared ones. Up to InOutKeepSize
+	//	bytes of free pages stay, the part of it left unused is returned in InOutKeepSize;
+	static TSize PurgeArenas(void* ArenaOwner, TSize& InOutKeepSize);
+
+	static TSize GetResidentSize();
+	static bool IsMemoryPressure();
+
+	//	Fills up to MaxCount arenas in use, returns the number written;
+	static TSize GetArenaStats(TPageMallocArenaStats* OutStats, TSize MaxCount);
+
 	bool IsAllocated();
 	static bool IsPagingSupported();
 	static bool IsProtectionSupported();
 
 	static TSize GetPageSize();
+	static TSize GetGranularity();
 
 	void* GetBase();
 	void* GetEnd();
 
 	TSize GetAllocatedSize();
+	bool IsUntouched();
 
 private:
 	bool Allocated;
@@ -113,6 +142,19 @@ struct TPageMallocStats
 	TSize TotalReservedSize;
 };
 
+//	Layout of one arena, taken by walking its free runs only;
+struct TPageMallocArenaStats
+{
+	void* Base;
+	TSize ReservedSize;
+	TSize UsedSize;
+	TSize FreeSize;
+	TSize FreeRunCount;
+	TSize LargestFreeRun;
+	TSize BlockCount;
+	bool  Owned; // reserved for the blocks of one heap;
+};
+
 class IPageMalloc
 {
 public:
@@ -120,13 +162,23 @@ public:
 
 	virtual bool AllocateBlock(TSize Size, TMemoryBlock& OutBlock, void* ArenaBaseAddr = nullptr) = 0;
 	virtual bool AllocateBlock(void* Address, TSize Size, TMemoryBlock& OutBlock) = 0;
+	virtual bool AllocateOwnedBlock(TSize Size, void* Owner, TMemoryBlock& OutBlock) = 0;
 
 	virtual bool FreeBlock(TMemoryBlock Block) = 0;
 	virtual bool Reserve(TMemoryBlock& OutBlock) = 0;
-	virtual bool Reserve(TSize Size, TMemoryBlock& OutBlock) = 0;
+	virtual bool Reserve(TSize Size, TMemoryBlock& OutBlock, void* Owner = nullptr) = 0;
 
 	virtual bool SetProtection(TMemoryBlock Block, TMemoryBlockAccess Protect) = 0;
 
+	virtual bool CommitBlock(TMemoryBlock Block) = 0;
+	virtual bool DecommitBlock(TMemoryBlock Block) = 0;
+	virtual bool PopulateBlock(TMemoryBlock Block) = 0;
+	virtual bool PurgeBlock(TMemoryBlock Block) = 0;
+	virtual TSize Purge(void* Owner, TSize& InOutKeepSize) = 0;
+
+	virtual TSize GetResidentSize() = 0;
+	virtual bool IsMemoryPressure() = 0;
+
 	virtual bool IsProtectionSupported() = 0;
 
 	virtual TSize GetGranularity() = 0;
@@ -135,9 +187,12 @@ public:
 	virtual bool Free() = 0;
 	virtual bool Release() = 0;
 	virtual bool Release(void* ArenaBaseAddr) = 0;
+	virtual bool ReleaseOwned(void* Owner) = 0;
+	virtual bool ReleaseShared() = 0;
 
 	virtual void GetStats(TPageMallocStats&) = 0;
 	virtual void GetLastTimeStats(TPageMallocTimeStats&) = 0;
+	virtual TSize GetArenaStats(TPageMallocArenaStats* OutStats, TSize MaxCount) = 0;
 
 	virtual ~IPageMalloc() = default;
 };
@@ -168,7 +223,8 @@ class TPageMalloc :
 				Lower(nullptr),
 				State(RELEASED),
 				Size(0),
-				Ptr(nullptr)
+				Ptr(nullptr),
+				Purged(false)
 			{
 			}
 
@@ -177,6 +233,7 @@ class TPageMalloc :
 			TBlockState State;
 			TSize Size;
 			void* Ptr;
+			bool Purged; // released block whose pages were all given back to the OS;
 		};
 
 		using TBlockList = TListBase<TBlockBase>;
@@ -214,7 +271,7 @@ class TPageMalloc :
 		bool Init(TSize ArenaSize, TSize ArenaPageSize, TSize PageSize,
 			IPlatformMalloc* PMalloc, TPageMallocTimeStats* OutTimeStats = nullptr);
 
-		inline void* TryMallocBlock(TSize Size, TSize& OutSize, void* Address);
+		inline void* TryMallocBlock(TSize Size, TSize& OutSize, bool& OutUntouched, void* Address);
 		inline bool  TryFreeBlock(void* Address);
 
 		inline TSize GetArenaSize();
@@ -222,6 +279,10 @@ class TPageMalloc :
 		inline TSize GetArenaPageSize();
 		inline bool IsEmpty();
 
+		void GetStats(TPageMallocArenaStats& OutStats);
+
+		TSize Purge(TSize& InOutKeepSize);
+		TSize GetUnpurgedSize();
 		void Free();
 		bool Release();
 
@@ -241,6 +302,7 @@ class TPageMalloc :
 		inline bool IsPartOf(void* Addr, TSize Size, void* LowerBorder, void* UpperBorder);
 
 		TSize RestFreeSize;
+		uint8* TouchedEnd; // arena pages from here on were never handed out;
 		TSize FreeBlockCount;
 		TSize UserBlockCount;
 		TBlockList FreeBlockList;
@@ -260,12 +322,24 @@ public:
 
 	virtual bool AllocateBlock(TSize Size, TMemoryBlock& OutBlock, void* ArenaBaseAddr = nullptr);
 	virtual bool AllocateBlock(void* Address, TSize Size, TMemoryBlock& OutBlock);
+	virtual bool AllocateOwnedBlock(TSize Size, void* Owner, TMemoryBlock& OutBlock);
 	virtual bool FreeBlock(TMemoryBlock Block);
 	virtual bool Reserve(TMemoryBlock& OutBlock);
-	virtual bool Reserve(TSize Size, TMemoryBlock& OutBlock);
+	virtual bool Reserve(TSize Size, TMemoryBlock& OutBlock, void* Owner = nullptr);
 
 	virtual bool SetProtection(TMemoryBlock Block, TMemoryBlockAccess Access);
 
+	virtual bool CommitBlock(TMemoryBlock Block);
+	virtual bool DecommitBlock(TMemoryBlock Block);
+	virtual bool PopulateBlock(TMemoryBlock Block);
+	virtual bool PurgeBlock(TMemoryBlock Block);
+
+	//	Purges the free runs of the arenas of Owner which were handed out before, releases arenas with no blocks;
+	virtual TSize Purge(void* Owner, TSize& InOutKeepSize);
+
+	virtual TSize GetResidentSize();
+	virtual bool IsMemoryPressure();
+
 	virtual bool IsProtectionSupported();
 
 	virtual TSize GetGranularity();
@@ -274,18 +348,22 @@ public:
 	virtual bool Free();
 	virtual bool Release();
 	virtual bool Release(void* ArenaBaseAddr);
+	virtual bool ReleaseOwned(void* Owner);
+	virtual bool ReleaseShared();
 
 	static TSize GetMaxArenaCount();
 
 	void GetStats(TPageMallocStats&);
 	void GetLastTimeStats(TPageMallocTimeStats&);
+	virtual TSize GetArenaStats(TPageMallocArenaStats* OutStats, TSize MaxCount);
 
 #if	PAGE_MALLOC_DEBUG
 	static size_t GetArenaDefaultSize();
 	void DumpMemMap(void* ArenaBaseAddr);
 #endif
 
-	static TPageMalloc* GetPageMalloc();
+	//	Parameters are used by the first call only, zero means the default;
+	static TPageMalloc* GetPageMalloc(TSize ArenaPageSize = 0, TSize ArenaMinSize = 0);
 
 private:
 	TPageMalloc();
@@ -295,8 +373,8 @@ private:
 		INVALID_SLOT = -1
 	};
 
-	void* TryAllocateBlock(TSize Size, TSize& OutSize, void* ArenaBaseAddr);
-	void* TryAllocateBlock(void* Address, TSize Size, TSize& OutSize);
+	void* TryAllocateBlock(TSize Size, TSize& OutSize, bool& OutUntouched, void* ArenaBaseAddr, void* Owner = nullptr);
+	void* TryAllocateBlock(void* Address, TSize Size, TSize& OutSize, bool& OutUntouched);
 
 	struct alignas(PAGE_MALLOC_SYSTEM_DEFAULT_ALIGNMENT)
 		TArenaSlot
@@ -304,12 +382,16 @@ private:
 		TArenaSlot()
 		{
 			Free = true;
+			Owner = nullptr;
 		}
 
 		bool Free;
+		void* Owner; // nullptr for arenas shared by all allocations;
 		TArena Arena;
 	};
 
+	bool ReleaseArenaSlot(TArenaSlot* Slot);
+
 	TSize ArenaPageSize;
 	TSize PageSize;
 	TSize ArenaMinSize;
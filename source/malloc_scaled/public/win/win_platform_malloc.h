@@ -10,7 +10,12 @@ class TWinPlatformMalloc :
 	public IPlatformMalloc
 {
 public:
-	TWinPlatformMalloc() = default;
+	TWinPlatformMalloc() :
+		LowMemoryNotification(nullptr)
+	{
+	}
+
+	virtual ~TWinPlatformMalloc();
 
 	virtual bool Init();
 
@@ -24,6 +29,11 @@ public:
 
 	virtual bool CommitMemoryBlock(TPlatformMemoryBlock InBlock);
 	virtual bool DecommitMemoryBlock(TPlatformMemoryBlock InBlock);
+	virtual bool PopulateMemoryBlock(TPlatformMemoryBlock InBlock);
+	virtual bool PurgeMemoryBlock(TPlatformMemoryBlock InBlock);
+
+	virtual TSize GetResidentSize();
+	virtual bool IsMemoryPressure();
 
 	virtual bool SetMemBlockProtection(TPlatformMemoryBlock InBlock, TMemoryBlockAccess ProtFlag);
 
@@ -33,6 +43,8 @@ public:
 	virtual TSize GetPageSize();
 private:
 	static DWORD TranslatePageProtection(TMemoryBlockAccess Access);
+
+	HANDLE LowMemoryNotification;
 };
 using TPlatformMalloc = TWinPlatformMalloc;
 #endif
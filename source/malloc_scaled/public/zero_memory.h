@@ -0,0 +1,9 @@
+#pragma once
+
+#include "std.h"
+
+//	Blocks from this size on are zeroed with non-temporal stores, so clearing them does not
+//	evict the working set from the caches;
+static const TSize ZERO_MEMORY_STREAM_MIN_SIZE = 4194304; // Bytes;
+
+void ZeroMemoryBlock(void* Ptr, TSize Size);
@@ -0,0 +1,184 @@
+#include "perf_counters.h"
+#include "platform.h"
+
+#ifdef PLATFORM_LINUX
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#endif
+
+static const char* PerfCounterNames[PERF_COUNTER_COUNT] =
+{
+	"cycles",
+	"instructions",
+	"L1D misses",
+	"LLC misses",
+	"dTLB misses",
+	"page faults"
+};
+
+const char* GetPerfCounterName(EPerfCounter Counter)
+{
+	return Counter < PERF_COUNTER_COUNT ? PerfCounterNames[Counter] : "unknown";
+}
+
+#ifdef PLATFORM_LINUX
+struct TPerfEventConfig
+{
+	uint32 Type;
+	uint64 Config;
+};
+
+static const uint64 PERF_CACHE_READ_MISS = (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+
+static const TPerfEventConfig PerfEventConfigs[PERF_COUNTER_COUNT] =
+{
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES                    },
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS                  },
+	{ PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D  | PERF_CACHE_READ_MISS },
+	{ PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL   | PERF_CACHE_READ_MISS },
+	{ PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | PERF_CACHE_READ_MISS },
+	{ PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS                   }
+};
+
+struct TPerfEventReading
+{
+	uint64 Value;
+	uint64 TimeEnabled;
+	uint64 TimeRunning;
+};
+#endif
+
+TPerfCounters::TPerfCounters()
+{
+	LeaderFd = -1;
+
+	for (uint32 i = 0; i < PERF_COUNTER_COUNT; ++i)
+	{
+		Fds[i] = -1;
+		BaseValues[i] = 0;
+		BaseTimesEnabled[i] = 0;
+		BaseTimesRunning[i] = 0;
+	}
+}
+
+TPerfCounters::~TPerfCounters()
+{
+	Close();
+}
+
+bool TPerfCounters::Open()
+{
+	bool Ok = false;
+
+#ifdef PLATFORM_LINUX
+	for (uint32 i = 0; i < PERF_COUNTER_COUNT; ++i)
+	{
+		perf_event_attr Attr{};
+		Attr.size = sizeof(Attr);
+		Attr.type = PerfEventConfigs[i].Type;
+		Attr.config = PerfEventConfigs[i].Config;
+		Attr.disabled = LeaderFd < 0; // Members count while the leader is enabled;
+		Attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+		//	User space only for the hardware counters, which perf_event_paranoid 2 still allows;
+		Attr.exclude_kernel = Attr.type != PERF_TYPE_SOFTWARE;
+		Attr.exclude_hv = 1;
+
+		//	A counter the CPU lacks fails alone, the first one opened leads the group;
+		Fds[i] = (int32)syscall(__NR_perf_event_open, &Attr, 0, -1, LeaderFd, 0);
+
+		if (Fds[i] >= 0 && LeaderFd < 0)
+		{
+			LeaderFd = Fds[i];
+		}
+
+		Ok |= Fds[i] >= 0;
+	}
+#endif
+
+	return Ok;
+}
+
+void TPerfCounters::Close()
+{
+#ifdef PLATFORM_LINUX
+	for (uint32 i = 0; i < PERF_COUNTER_COUNT; ++i)
+	{
+		if (Fds[i] >= 0)
+		{
+			close(Fds[i]);
+			Fds[i] = -1;
+		}
+	}
+
+	LeaderFd = -1;
+#endif
+}
+
+void TPerfCounters::Reset()
+{
+#ifdef PLATFORM_LINUX
+	for (uint32 i = 0; i < PERF_COUNTER_COUNT; ++i)
+	{
+		TPerfEventReading Reading{};
+
+		//	The enabled and running times are not reset by PERF_EVENT_IOC_RESET, so the readings are kept instead;
+		if (Fds[i] >= 0 && read(Fds[i], &Reading, sizeof(Reading)) == sizeof(Reading))
+		{
+			BaseValues[i] = Reading.Value;
+			BaseTimesEnabled[i] = Reading.TimeEnabled;
+			BaseTimesRunning[i] = Reading.TimeRunning;
+		}
+	}
+#endif
+}
+
+void TPerfCounters::Start()
+{
+#ifdef PLATFORM_LINUX
+	if (LeaderFd >= 0)
+	{
+		ioctl(LeaderFd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	}
+#endif
+}
+
+void TPerfCounters::Stop()
+{
+#ifdef PLATFORM_LINUX
+	if (LeaderFd >= 0)
+	{
+		ioctl(LeaderFd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+	}
+#endif
+}
+
+void TPerfCounters::Read(TPerfCounterValues& OutValues)
+{
+	OutValues.Reset();
+
+#ifdef PLATFORM_LINUX
+	for (uint32 i = 0; i < PERF_COUNTER_COUNT; ++i)
+	{
+		TPerfEventReading Reading{};
+
+		if (Fds[i] < 0 || read(Fds[i], &Reading, sizeof(Reading)) != sizeof(Reading))
+		{
+			continue;
+		}
+
+		uint64 Value = Reading.Value - BaseValues[i];
+		uint64 TimeEnabled = Reading.TimeEnabled - BaseTimesEnabled[i];
+		uint64 TimeRunning = Reading.TimeRunning - BaseTimesRunning[i];
+
+		if (!TimeRunning)
+		{
+			continue;
+		}
+
+		OutValues.Values[i] = TimeRunning < TimeEnabled ? (uint64)((float64)Value * TimeEnabled / TimeRunning) : Value;
+		OutValues.Valid[i] = true;
+	}
+#endif
+}
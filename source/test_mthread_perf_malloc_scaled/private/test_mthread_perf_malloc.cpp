@@ -6,11 +6,20 @@
 //#include "intrin.h"
 #include <mutex>
 #include "platform.h"
+#include "object_pool.h"
+#include "vm_block.h"
 #include <string>
+#include <algorithm>
+
+#ifdef PLATFORM_WIN
+#include <psapi.h>
+#endif
 
 static std::mutex InitGuard{};
 static bool InitFlag = false;
 
+static void ReleaseObjectPools();
+
 bool SafeInitMalloc()
 {
 	InitGuard.lock();
@@ -42,6 +51,8 @@ bool SafeInitMalloc()
 void SafeShutdownMalloc()
 {
 	InitGuard.lock();
+	//	Slabs of the object pools do not outlive the allocator;
+	ReleaseObjectPools();
 	ShutdownMalloc();
 	InitFlag = false;
 	InitGuard.unlock();
@@ -74,12 +85,26 @@ TWorker::TTest TWorker::Tests[] =
 	//{ TEST_MALLOC,  Test_Perf_Malloc_Progressive_Blocks }, <== It's dangerous. Aggressive filling all memory : RAM and page file on disk!!
 	{ TEST_FREE,    Test_Perf_Free },
 	{ TEST_REALLOC, Test_Perf_Small_Reallocs },
-	{ TEST_REALLOC, Test_Perf_Big_Reallocs }
+	{ TEST_REALLOC, Test_Perf_Big_Reallocs },
+	{ TEST_MALLOC,  Test_Perf_Pool_Cache_Oscillation },
+	{ TEST_NONE,    Test_Perf_Size_Class_Lookup },
+	{ TEST_MALLOC,  Test_Perf_Malloc_Fast_Path },
+	{ TEST_MALLOC,  Test_Perf_Calloc },
+	{ TEST_MALLOC,  Test_Perf_Object_Pool },
+	{ TEST_MALLOC,  Test_Perf_Heap_Destroy },
+	{ TEST_MALLOC,  Test_Perf_Prewarm },
+	{ TEST_FREE,    Test_Perf_Trim },
+	{ TEST_NONE,    Test_Perf_Pool_Coloring },
+	{ TEST_NONE,    Test_Perf_False_Sharing },
+	{ TEST_MALLOC,  Test_Perf_Heap_Profiler },
+	{ TEST_MALLOC,  Test_Perf_Fragmentation_Aging }
 };
 
 std::atomic<uint32> TWorker::RunningTasks      = 0;
 std::atomic<uint32> TWorker::AllTasksCompleted = true;
 std::atomic<int32>  TWorker::ExitCode          = 0;
+uint32              TWorker::TimingBatchSize   = 1;
+uint32              TWorker::AgingSeconds      = 60;
 
 void ShowProgress(float64 Value, float64 MaxValue)
 {
@@ -89,6 +114,26 @@ void ShowProgress(float64 Value, float64 MaxValue)
 
 void AggregateAndDumpStats(ETestType TestType, uint32 TestNumber);
 
+//	Times Op(First) .. Op(First + Count - 1) as one batch, the timer overhead is taken off once per batch.
+//	Returns false when any Op failed;
+template<typename TOP>
+inline bool TimeBatch(TWorker* Worker, TTimeStats& Stats, TSize First, TSize Count, TOP&& Op)
+{
+	bool Ok = true;
+
+	Worker->StartTiming(Count);
+
+	for (TSize i = First; i < First + Count; ++i)
+	{
+		Ok &= Op(i);
+	}
+
+	Worker->StopTiming();
+	Stats.AddBatch(Worker->GetTimer()->GetDuration(), Count);
+
+	return Ok;
+}
+
 void TWorker::Run()
 {
 #ifdef PLATFORM_WIN
@@ -103,6 +148,11 @@ void TWorker::Run()
 
 	printf("MALLOC PERF TEST: Starting thread: %i; Executing tests...\n", ThreadId);
 
+	if (!PerfCounters.Open())
+	{
+		printf("MALLOC PERF TEST: Thread %i: Performance counters are not available, only times are reported\n", ThreadId);
+	}
+
 	for (uint32 i = 0; i < TestCount; ++i)
 	{
 		if (!SafeInitMalloc())
@@ -122,7 +172,10 @@ void TWorker::Run()
 
 		++RunningTasks;
 
+		PerfCounters.Reset();
+		PerfOpCount = 0;
 		Tests[i].TestFunction(this);
+		PerfCounters.Read(PerfValues);
 		
 		std::this_thread::sleep_for(std::chrono::milliseconds(200));
 		--RunningTasks;
@@ -176,56 +229,128 @@ void TWorker::Run()
 	}
 }
 
+static const float64 ReportedPercentiles[] = { 50.0, 90.0, 99.0, 99.9, 99.99 };
+
 void TLogger::DumpStatsToFile(
 	const char* Header1,
 	ETestType TestType, uint32 TestNumber,
-	uint64 MesCount, float64 MinTime, float64 MaxTime, float64 AvgTime)
+	TTimeStats& Stats)
 {
-	Guard.lock();
+	const char* CountName = nullptr;
+	const char* TimeName = nullptr;
 
 	switch (TestType)
 	{
 	case TEST_MALLOC:
-	{
-		fprintf(Log, Header1);
+		CountName = "Number of allocated memory blocks";
+		TimeName  = "Memory block allocation";
+		break;
+	case TEST_REALLOC:
+		CountName = "Number of reallocated memory blocks";
+		TimeName  = "Memory block reallocation";
+		break;
+	case TEST_FREE:
+		CountName = "Number of released memory blocks";
+		TimeName  = "Memory block releasing";
+		break;
+	default:
+		return;
+	}
+
+	float64 MaxTime = std::chrono::duration<float64, std::nano>(Stats.GetMaxTime()).count();
+	float64 MinTime = std::chrono::duration<float64, std::nano>(Stats.GetMinTime()).count();
+	float64 AvgTime = std::chrono::duration<float64, std::nano>(Stats.GetAvgTime()).count();
+
+	Guard.lock();
 
-		fprintf(Log, "Performance test results: Test number: %i\n", TestNumber);
-		fprintf(Log, "Number of allocated memory blocks: %llu\n\n", MesCount);
+	fprintf(Log, Header1);
+	fprintf(Log, "Performance test results: Test number: %i\n", TestNumber);
+	fprintf(Log, "%s: %llu\n\n", CountName, Stats.GetMeasureCount());
 
-		fprintf(Log, "Memory block allocation: max time : %f  ns;  %f  us\n", MaxTime, MaxTime / 1000.0f);
-		fprintf(Log, "Memory block allocation: min time : %f  ns;  %f  us\n", MinTime, MinTime / 1000.0f);
-		fprintf(Log, "Memory block allocation: avg time : %f  ns;  %f  us\n", AvgTime, AvgTime / 1000.0f);
+	fprintf(Log, "%s: max time : %f  ns;  %f  us\n", TimeName, MaxTime, MaxTime / 1000.0f);
+	fprintf(Log, "%s: min time : %f  ns;  %f  us\n", TimeName, MinTime, MinTime / 1000.0f);
+	fprintf(Log, "%s: avg time : %f  ns;  %f  us\n", TimeName, AvgTime, AvgTime / 1000.0f);
 
-		fprintf(Log, "==================================================================\n\n\n");
+	for (float64 Percentile : ReportedPercentiles)
+	{
+		float64 Time = std::chrono::duration<float64, std::nano>(Stats.GetPercentileTime(Percentile)).count();
+		fprintf(Log, "%s: p%g time : %f  ns;  %f  us\n", TimeName, Percentile, Time, Time / 1000.0f);
 	}
-		break;
-	case TEST_REALLOC:
+
+	fprintf(Log, "==================================================================\n\n\n");
+
+	Guard.unlock();
+}
+
+void TLogger::DumpPerfCountersToFile(uint32 TestNumber)
+{
+	TPerfCounterValues Total{};
+	uint64 TotalOpCount = 0;
+	bool AnyValid = false;
+
+	Guard.lock();
+
+	fprintf(Log, "---------- PERFORMANCE COUNTERS per counted operation ------------\n");
+	fprintf(Log, "Performance test results: Test number: %i\n", TestNumber);
+
+	for (TSize w = 0; w < Workers->size(); ++w)
 	{
-		fprintf(Log, Header1);
-		fprintf(Log, "Performance test results: Test number: %i\n", TestNumber);
-		fprintf(Log, "Number of reallocated memory blocks : %llu\n", MesCount);
-		fprintf(Log, "Memory block reallocation max time : %f  ns;  %f  us\n", MaxTime, MaxTime / 1000.0f);
-		fprintf(Log, "Memory block reallocation min time : %f  ns;  %f  us\n", MinTime, MinTime / 1000.0f);
-		fprintf(Log, "Memory block reallocation avg time : %f  ns;  %f  us\n", AvgTime, AvgTime / 1000.0f);
+		TWorker* Worker = (*Workers)[w].get();
+		uint64 OpCount = Worker->PerfOpCount;
+
+		Total.Add(Worker->PerfValues, w == 0);
+		TotalOpCount += OpCount;
+
+		fprintf(Log, "Thread %u:", Worker->GetThreadId());
+
+		for (uint32 i = 0; i < PERF_COUNTER_COUNT; ++i)
+		{
+			if (Worker->PerfValues.Valid[i] && OpCount)
+			{
+				fprintf(Log, "  %s: %.2f;", GetPerfCounterName((EPerfCounter)i), (float64)Worker->PerfValues.Values[i] / OpCount);
+				AnyValid = true;
+			}
+			else
+			{
+				fprintf(Log, "  %s: n/a;", GetPerfCounterName((EPerfCounter)i));
+			}
+		}
 
-		fprintf(Log, "==================================================================\n\n\n");
+		fprintf(Log, "\n");
 	}
-		break;
-	case TEST_FREE:
+
+	fprintf(Log, "All threads, %llu operations:", TotalOpCount);
+
+	for (uint32 i = 0; i < PERF_COUNTER_COUNT; ++i)
 	{
-		fprintf(Log, Header1);
-		fprintf(Log, "Performance test results: Test number: %i\n", TestNumber);
-		fprintf(Log, "Number of released memory blocks : %llu\n", MesCount);
-		fprintf(Log, "Memory block releasing max time : %f  ns;  %f  us\n", MaxTime, MaxTime / 1000.0f);
-		fprintf(Log, "Memory block releasing min time : %f  ns;  %f  us\n", MinTime, MinTime / 1000.0f);
-		fprintf(Log, "Memory block releasing avg time : %f  ns;  %f  us\n", AvgTime, AvgTime / 1000.0f);
+		if (Total.Valid[i] && TotalOpCount)
+		{
+			fprintf(Log, "  %s: %.2f;", GetPerfCounterName((EPerfCounter)i), (float64)Total.Values[i] / TotalOpCount);
+		}
+		else
+		{
+			fprintf(Log, "  %s: n/a;", GetPerfCounterName((EPerfCounter)i));
+		}
+	}
 
-		fprintf(Log, "==================================================================\n\n\n");
+	if (Total.Valid[PERF_COUNTER_CYCLES] && Total.Valid[PERF_COUNTER_INSTRUCTIONS] && Total.Values[PERF_COUNTER_CYCLES])
+	{
+		fprintf(Log, "  IPC: %.2f;", (float64)Total.Values[PERF_COUNTER_INSTRUCTIONS] / Total.Values[PERF_COUNTER_CYCLES]);
 	}
-		break;
-	default:
-		break;
+
+	fprintf(Log, "\n");
+
+	if (!TotalOpCount)
+	{
+		fprintf(Log, "No timed region of %llu operations or more, use --timing-batch=%llu\n", PERF_COUNTER_MIN_BATCH, PERF_COUNTER_MIN_BATCH);
+	}
+	else if (!AnyValid)
+	{
+		fprintf(Log, "No performance counter is available\n");
 	}
+
+	fprintf(Log, "==================================================================\n\n\n");
+
 	Guard.unlock();
 }
 
@@ -236,116 +361,84 @@ void TLogger::DumpStrToFile(const char* Str)
 
 void AggregateAndDumpStats(ETestType TestType, uint32 TestNumber)
 {
-	TSize WCount = Workers->size();
-
-	uint64 MallocMesCount  = 0;
-	uint64 ReallocMesCount = 0;
-	uint64 FreeMesCount    = 0;
-
-	float64 MallocAvgTime = 0.0f;
-	float64 MallocMaxTime = 0.0f;
-	float64 MallocMinTime = 0.0f;
-
-	float64 ReallocAvgTime = 0.0f;
-	float64 ReallocMaxTime = 0.0f;
-	float64 ReallocMinTime = 0.0f;
+	//	The histograms of the workers are merged, so the percentiles are of all measures of the test;
+	unique_ptr<TMallocTimeStats> Total{ new TMallocTimeStats{} };
 
-	float64 FreeAvgTime = 0.0f;
-	float64 FreeMaxTime = 0.0f;
-	float64 FreeMinTime = 0.0f;
-
-	for (uint32 i = 0; i < WCount; ++i)
+	for (TSize i = 0; i < Workers->size(); ++i)
 	{
-		auto DurMallocAvg  = (*Workers)[i]->MallocTimeStats.BlockAllocTime.GetAvgTime();
-		auto DurMallocMin  = (*Workers)[i]->MallocTimeStats.BlockAllocTime.GetMinTime();
-		auto DurMallocMax  = (*Workers)[i]->MallocTimeStats.BlockAllocTime.GetMaxTime();
+		Total->BlockAllocTime.Merge((*Workers)[i]->MallocTimeStats.BlockAllocTime);
+		Total->BlockReallocTime.Merge((*Workers)[i]->MallocTimeStats.BlockReallocTime);
+		Total->BlockFreeTime.Merge((*Workers)[i]->MallocTimeStats.BlockFreeTime);
+	}
 
-		auto DurReallocAvg = (*Workers)[i]->MallocTimeStats.BlockReallocTime.GetAvgTime();
-		auto DurReallocMin = (*Workers)[i]->MallocTimeStats.BlockReallocTime.GetMinTime();
-		auto DurReallocMax = (*Workers)[i]->MallocTimeStats.BlockReallocTime.GetMaxTime();
+	//	Every operation measured by the test is reported, the test type one first;
+	struct TOperation
+	{
+		ETestType TestType;
+		const char* Header;
+		TTimeStats* Stats;
+	};
 
-		auto DurFreeAvg    = (*Workers)[i]->MallocTimeStats.BlockFreeTime.GetAvgTime();
-		auto DurFreeMin    = (*Workers)[i]->MallocTimeStats.BlockFreeTime.GetMinTime();
-		auto DurFreeMax    = (*Workers)[i]->MallocTimeStats.BlockFreeTime.GetMaxTime();
+	TOperation Operations[] =
+	{
+		{ TEST_MALLOC,  "---------- MALLOC: ALLOCATIONS: SUMMARISED time stats ------------\n", &Total->BlockAllocTime   },
+		{ TEST_REALLOC, "---------- MALLOC: REALLOCATIONS: SUMMARISED time stats ----------\n", &Total->BlockReallocTime },
+		{ TEST_FREE,    "---------- MALLOC: RELEASES: SUMMARISED time stats ---------------\n", &Total->BlockFreeTime    }
+	};
 
-		MallocAvgTime  += std::chrono::duration<float64, std::nano>(DurMallocAvg).count();
-		MallocMinTime  += std::chrono::duration<float64, std::nano>(DurMallocMin).count();
-		MallocMaxTime  += std::chrono::duration<float64, std::nano>(DurMallocMax).count();
+	std::stable_partition(std::begin(Operations), std::end(Operations),
+		[TestType](const TOperation& Op) { return Op.TestType == TestType; });
 
-		ReallocAvgTime += std::chrono::duration<float64, std::nano>(DurReallocAvg).count();
-		ReallocMinTime += std::chrono::duration<float64, std::nano>(DurReallocMin).count();
-		ReallocMaxTime += std::chrono::duration<float64, std::nano>(DurReallocMax).count();
+	bool AnyMeasured = false;
 
-		FreeAvgTime    += std::chrono::duration<float64, std::nano>(DurFreeAvg).count();
-		FreeMinTime    += std::chrono::duration<float64, std::nano>(DurFreeMin).count();
-		FreeMaxTime    += std::chrono::duration<float64, std::nano>(DurFreeMax).count();
+	for (TOperation& Op : Operations)
+	{
+		if (Op.Stats->GetMeasureCount())
+		{
+			GLogger->DumpStatsToFile(Op.Header, Op.TestType, TestNumber, *Op.Stats);
+			AnyMeasured = true;
+		}
+	}
 
-		MallocMesCount  += (*Workers)[i]->MallocTimeStats.BlockAllocTime.GetMeasureCount();
-		ReallocMesCount += (*Workers)[i]->MallocTimeStats.BlockReallocTime.GetMeasureCount();
-		FreeMesCount    += (*Workers)[i]->MallocTimeStats.BlockFreeTime.GetMeasureCount();
+	//	Counters cover the timed regions of PERF_COUNTER_MIN_BATCH operations or more, averaged over their operations;
+	if (AnyMeasured)
+	{
+		GLogger->DumpPerfCountersToFile(TestNumber);
 	}
 
-	MallocAvgTime /= WCount;
-	MallocMaxTime /= WCount;
-	MallocMinTime /= WCount;
+	//	Requests of all workers and the size classes left by the test, before the allocator is shut down;
+	TMallocCounters Counters{};
+	GetMallocCounters(Counters);
 
-	ReallocAvgTime /= WCount;
-	ReallocMaxTime /= WCount;
-	ReallocMinTime /= WCount;
+	std::string Str = "---------- MALLOC: COUNTERS AND STATS ----------------------------\n";
+	Str += "Mallocs: " + std::to_string(Counters.MallocCount) + "\tFrees: " + std::to_string(Counters.FreeCount) +
+		"\tAllocated: " + std::to_string(Counters.Allocated) + " Bytes\tDeallocated: " + std::to_string(Counters.Deallocated) + " Bytes\n";
 
-	FreeAvgTime /= WCount;
-	FreeMaxTime /= WCount;
-	FreeMinTime /= WCount;
-	
-	switch (TestType)
-	{
-	case TEST_MALLOC:
-	{
-		GLogger->DumpStatsToFile(
-			"---------- MALLOC: ALLOCATIONS: SUMMARISED time stats ------------\n",
-			TEST_MALLOC, TestNumber,
-			MallocMesCount, MallocMinTime, MallocMaxTime, MallocAvgTime);
-	}
-		break;
-	case TEST_REALLOC:
-	{
-		GLogger->DumpStatsToFile(
-			"---------- MALLOC: REALLOCATIONS: SUMMARISED time stats ----------\n",
-			TEST_REALLOC, TestNumber,
-			ReallocMesCount, ReallocMinTime, ReallocMaxTime, ReallocAvgTime);
-	}
-		break;
-	case TEST_FREE:
+	if (!DumpStats(MALLOC_STATS_FORMAT_JSON, [](const char* Data, TSize Size, void* Context) { ((std::string*)Context)->append(Data, Size); }, &Str))
 	{
-		GLogger->DumpStatsToFile(
-			"---------- MALLOC: RELEASES: SUMMARISED time stats ---------------\n",
-			TEST_FREE, TestNumber,
-			FreeMesCount, FreeMinTime, FreeMaxTime, FreeAvgTime);
-	}
-		break;
-	default:
-		break;
+		printf("MALLOC PERF TEST: Cannot dump malloc stats\n");
+		TWorker::ExitCode.store(EXIT_FAILURE);
 	}
+
+	GLogger->DumpStrToFile(Str.c_str());
 }
 
 void Test_Perf_Malloc_Const_Blocks_1(TWorker* Worker)
 {
-	void* Ptr = nullptr;
 	TSize Size0 = 32;
 	uint64 BlkCountLimit = 10000000;
 	uint32 Id = Worker->GetThreadId();
 	printf("MALLOC PERF TEST: Thread %i: Allocating %llu memory blocks of constant size %llu Bytes\n", Id, BlkCountLimit, Size0);
 
-	for (TSize i = 0; i < BlkCountLimit; ++i)
+	for (TSize i = 0; i < BlkCountLimit; i += TWorker::TimingBatchSize)
 	{
-		Worker->GetTimer()->Start();
+		TSize Count = std::min<TSize>(TWorker::TimingBatchSize, BlkCountLimit - i);
 		//Ptr = LocalAlloc(LPTR, Size0);
 		//Ptr = malloc(Size0);
-		Ptr = Malloc(Size0);
-		Worker->GetTimer()->Stop();
-		Worker->MallocTimeStats.BlockAllocTime += Worker->GetTimer()->GetDuration();
+		bool Ok = TimeBatch(Worker, Worker->MallocTimeStats.BlockAllocTime, i, Count,
+			[Size0](TSize) { return Malloc(Size0) != nullptr; });
 		ShowProgress((float64)i / (float64)BlkCountLimit, 1.0f);
-		if (!Ptr)
+		if (!Ok)
 		{
 			printf("\nMALLOC PERF TEST: PANIC!!! OUT OF MEMORY Line: %i\n", __LINE__);
 			//SafeShutdownMalloc();
@@ -367,21 +460,19 @@ void Test_Perf_Malloc_Const_Blocks_1(TWorker* Worker)
 
 void Test_Perf_Malloc_Const_Blocks_2(TWorker* Worker)
 {
-	void* Ptr = nullptr;
 	TSize Size0 = 65536;
 	uint64 BlkCountLimit = 100000;
 	uint32 Id = Worker->GetThreadId();
 	printf("MALLOC PERF TEST: Thread %i: Allocating %llu memory blocks of constant size %llu Bytes\n", Id, BlkCountLimit, Size0);
 
-	for (TSize i = 0; i < BlkCountLimit; ++i)
+	for (TSize i = 0; i < BlkCountLimit; i += TWorker::TimingBatchSize)
 	{
-		Worker->GetTimer()->Start();
+		TSize Count = std::min<TSize>(TWorker::TimingBatchSize, BlkCountLimit - i);
 		//Ptr = malloc(Size0);
-		Ptr = Malloc(Size0);
-		Worker->GetTimer()->Stop();
-		Worker->MallocTimeStats.BlockAllocTime += Worker->GetTimer()->GetDuration();
+		bool Ok = TimeBatch(Worker, Worker->MallocTimeStats.BlockAllocTime, i, Count,
+			[Size0](TSize) { return Malloc(Size0) != nullptr; });
 		ShowProgress((float64)i / (float64)BlkCountLimit, 1.0f);
-		if (!Ptr)
+		if (!Ok)
 		{
 			printf("\nMALLOC PERF TEST: PANIC!!! OUT OF MEMORY\n");
 			//SafeShutdownMalloc();
@@ -433,9 +524,9 @@ void Test_Perf_Malloc_Progressive_Blocks(TWorker* Worker)
 
 		for (TSize i = 0; i < 4; ++i)
 		{
-			Worker->GetTimer()->Start();
+			Worker->StartTiming();
 			Ptr = Malloc(Sz);
-			Worker->GetTimer()->Stop();
+			Worker->StopTiming();
 			Worker->MallocTimeStats.BlockAllocTime += Worker->GetTimer()->GetDuration();
 /*
 !!! It's very dengerous loop !!!! ;)
@@ -503,13 +594,11 @@ void Test_Perf_Free(TWorker* Worker)
 			++k;
 		}
 
-		for (TSize i = 0; i < 4; ++i)
+		for (TSize i = 0; i < 4; i += TWorker::TimingBatchSize)
 		{
-			Worker->GetTimer()->Start();
 			//free(Ptr[i]);
-			Free(Ptr[i]);
-			Worker->GetTimer()->Stop();
-			Worker->MallocTimeStats.BlockFreeTime += Worker->GetTimer()->GetDuration();
+			TimeBatch(Worker, Worker->MallocTimeStats.BlockFreeTime, i, std::min<TSize>(TWorker::TimingBatchSize, 4 - i),
+				[&Ptr](TSize j) { Free(Ptr[j]); return true; });
 		}
 		ShowProgress((float64)Sz / (float64)MaxPoolBlockSize, 1.0f);
 		SzPrev = SzSum;
@@ -560,13 +649,11 @@ void Test_Perf_Small_Reallocs(TWorker* Worker)
 			++k;
 		}
 
-		for (TSize i = 0; i < 4; ++i)
+		for (TSize i = 0; i < 4; i += TWorker::TimingBatchSize)
 		{
-			Worker->GetTimer()->Start();
-			B[i].Ptr = Realloc(B[i].Ptr, B[i].Size + (B[i].Size >> 5));
 			//B[i].Ptr = realloc(B[i].Ptr, B[i].Size + (B[i].Size >> 5));
-			Worker->GetTimer()->Stop();
-			Worker->MallocTimeStats.BlockReallocTime += Worker->GetTimer()->GetDuration();
+			TimeBatch(Worker, Worker->MallocTimeStats.BlockReallocTime, i, std::min<TSize>(TWorker::TimingBatchSize, 4 - i),
+				[&B](TSize j) { B[j].Ptr = Realloc(B[j].Ptr, B[j].Size + (B[j].Size >> 5)); return true; });
 		}
 
 		for (TSize i = 0; i < 4; ++i)
@@ -623,13 +710,11 @@ void Test_Perf_Big_Reallocs(TWorker* Worker)
 			++k;
 		}
 
-		for (TSize i = 0; i < 4; ++i)
+		for (TSize i = 0; i < 4; i += TWorker::TimingBatchSize)
 		{
-			Worker->GetTimer()->Start();
-			B[i].Ptr = Realloc(B[i].Ptr, B[i].Size * 4);
 			//B[i].Ptr = realloc(B[i].Ptr, B[i].Size * 4);
-			Worker->GetTimer()->Stop();
-			Worker->MallocTimeStats.BlockReallocTime += Worker->GetTimer()->GetDuration();
+			TimeBatch(Worker, Worker->MallocTimeStats.BlockReallocTime, i, std::min<TSize>(TWorker::TimingBatchSize, 4 - i),
+				[&B](TSize j) { B[j].Ptr = Realloc(B[j].Ptr, B[j].Size * 4); return true; });
 		}
 
 		for (TSize i = 0; i < 4; ++i)
@@ -650,3 +735,1156 @@ void Test_Perf_Big_Reallocs(TWorker* Worker)
 
 	GLogger->DumpStrToFile(Str.c_str());
 }
+
+
+void Test_Perf_Pool_Cache_Oscillation(TWorker* Worker)
+{
+	//	Every round fills several memory pools and releases them again,
+	//	so the empty pools are either cached or returned to the page allocator;
+	TSize Size0 = 32;
+	uint64 BlkCount = 200000;
+	uint32 RoundCount = 20;
+	uint32 Id = Worker->GetThreadId();
+	vector<void*> Ptrs(BlkCount, nullptr);
+
+	printf("MALLOC PERF TEST: Thread %i: Pool cache oscillation: %u rounds of %llu blocks of constant size %llu Bytes\n", Id, RoundCount, BlkCount, Size0);
+
+	for (uint32 r = 0; r < RoundCount; ++r)
+	{
+		for (TSize i = 0; i < BlkCount; i += TWorker::TimingBatchSize)
+		{
+			bool Ok = TimeBatch(Worker, Worker->MallocTimeStats.BlockAllocTime, i, std::min<TSize>(TWorker::TimingBatchSize, BlkCount - i),
+				[&Ptrs, Size0](TSize j) { Ptrs[j] = Malloc(Size0); return Ptrs[j] != nullptr; });
+
+			if (!Ok)
+			{
+				printf("\nMALLOC PERF TEST: PANIC!!! OUT OF MEMORY Line: %i\n", __LINE__);
+				TWorker::ExitCode.store(EXIT_FAILURE);
+				return;
+			}
+		}
+
+		for (TSize i = 0; i < BlkCount; i += TWorker::TimingBatchSize)
+		{
+			TimeBatch(Worker, Worker->MallocTimeStats.BlockFreeTime, i, std::min<TSize>(TWorker::TimingBatchSize, BlkCount - i),
+				[&Ptrs](TSize j) { Free(Ptrs[j]); return true; });
+		}
+
+		ShowProgress((float64)(r + 1), (float64)RoundCount);
+	}
+
+	TMemPoolCacheStats CacheStats{};
+	GetMemPoolCacheStats(CacheStats);
+
+	printf("MALLOC PERF TEST: POOL CACHE OSCILLATION TEST is completed\n");
+
+	std::string Str{};
+	Str += "------------------ POOL CACHE OSCILLATION TEST -------------------\n";
+	Str += "MALLOC PERF TEST: " + std::string("Thread: ") + std::to_string(Id) + "\n";
+	Str += "Allocating and releasing of memory blocks of constant size:\n";
+	Str += "Block size: " + std::to_string(Size0) + " Bytes\tBlock count: " + std::to_string(BlkCount) + "\tRounds: " + std::to_string(RoundCount) + "\n";
+	Str += "Pool cache hits: " + std::to_string(CacheStats.Hits) + "\tMisses: " + std::to_string(CacheStats.Misses) + "\tEvictions: " + std::to_string(CacheStats.Evictions) + "\tProvisioned: " + std::to_string(CacheStats.Provisioned) + "\tPressure trims: " + std::to_string(CacheStats.PressureTrims) + "\n";
+	Str += "Pool cache peak size: " + std::to_string(CacheStats.PeakCachedSize) + " Bytes\n";
+
+	GLogger->DumpStrToFile(Str.c_str());
+}
+
+void Test_Perf_Size_Class_Lookup(TWorker* Worker)
+{
+	//	Lookup alone is too short for a single timer measurement, so every size is timed in batches;
+	TSize Sizes[] = { 8, 16, 24, 100, 256, 1000, 4096, 16384, 28000, 32768, 65536, 1048576, 16777216 };
+	TSize SizeCount = sizeof(Sizes) / sizeof(Sizes[0]);
+	uint64 BatchCount = 1000;
+	uint64 BatchSize = 1000;
+	uint32 Id = Worker->GetThreadId();
+	TSize Sum = 0;
+
+	printf("MALLOC PERF TEST: Thread %i: Size class lookup: %llu lookups per size\n", Id, BatchCount * BatchSize);
+
+	std::string Str{};
+	Str += "--------------------- SIZE CLASS LOOKUP TEST ---------------------\n";
+	Str += "MALLOC PERF TEST: " + std::string("Thread: ") + std::to_string(Id) + "\n";
+	Str += "Lookups per size: " + std::to_string(BatchCount * BatchSize) + "\n";
+
+	for (TSize s = 0; s < SizeCount; ++s)
+	{
+		float64 MinTime = std::numeric_limits<float64>::max();
+		float64 TotalTime = 0.0f;
+
+		for (uint64 b = 0; b < BatchCount; ++b)
+		{
+			Worker->GetTimer()->Start();
+			for (uint64 i = 0; i < BatchSize; ++i)
+			{
+				Sum += GetGoodSize(Sizes[s] + (i & 7));
+			}
+			Worker->GetTimer()->Stop();
+
+			float64 Time = std::chrono::duration<float64, std::nano>(Worker->GetTimer()->GetDuration()).count() / BatchSize;
+			TotalTime += Time;
+
+			if (Time < MinTime)
+			{
+				MinTime = Time;
+			}
+		}
+
+		Str += "Request size: " + std::to_string(Sizes[s]) + " Bytes\tBlock size: " + std::to_string(GetGoodSize(Sizes[s])) + " Bytes";
+		Str += "\tmin: " + std::to_string(MinTime) + " ns\tavg: " + std::to_string(TotalTime / BatchCount) + " ns\n";
+		ShowProgress((float64)(s + 1), (float64)SizeCount);
+	}
+
+	printf("MALLOC PERF TEST: SIZE CLASS LOOKUP TEST is completed (checksum %llu)\n", Sum);
+
+	GLogger->DumpStrToFile(Str.c_str());
+}
+
+void Test_Perf_Malloc_Fast_Path(TWorker* Worker)
+{
+	//	Blocks are taken from the free lists of already existing pools;
+	//	every batch is timed as a whole and recorded as time per allocation;
+	TSize Sizes[] = { 16, 64, 256, 1024, 4096, 32768 };
+	TSize SizeCount = sizeof(Sizes) / sizeof(Sizes[0]);
+	const uint64 BatchSize = 256;
+	uint64 BatchCount = 2000;
+	void* Ptrs[BatchSize] = { nullptr };
+	uint32 Id = Worker->GetThreadId();
+
+	printf("MALLOC PERF TEST: Thread %i: Malloc fast path: %llu batches of %llu blocks per size\n", Id, BatchCount, BatchSize);
+
+	std::string Str{};
+	Str += "--------------------- MALLOC FAST PATH TEST ----------------------\n";
+	Str += "MALLOC PERF TEST: " + std::string("Thread: ") + std::to_string(Id) + "\n";
+	Str += "Allocations per size: " + std::to_string(BatchCount * BatchSize) + "\n";
+
+	for (TSize s = 0; s < SizeCount; ++s)
+	{
+		float64 TotalTime = 0.0f;
+
+		for (uint64 b = 0; b <= BatchCount; ++b)
+		{
+			//	The first batch creates the pool and is not measured;
+			if (b)
+			{
+				Worker->StartTiming(BatchSize);
+			}
+			else
+			{
+				Worker->GetTimer()->Start();
+			}
+
+			for (uint64 i = 0; i < BatchSize; ++i)
+			{
+				Ptrs[i] = Malloc(Sizes[s]);
+			}
+
+			if (b)
+			{
+				Worker->StopTiming();
+			}
+			else
+			{
+				Worker->GetTimer()->Stop();
+			}
+
+			for (uint64 i = 0; i < BatchSize; ++i)
+			{
+				if (!Ptrs[i])
+				{
+					printf("\nMALLOC PERF TEST: PANIC!!! OUT OF MEMORY Line: %i\n", __LINE__);
+					TWorker::ExitCode.store(EXIT_FAILURE);
+					return;
+				}
+
+				Free(Ptrs[i]);
+			}
+
+			//	The first batch creates the pool and is not measured;
+			if (b)
+			{
+				Worker->MallocTimeStats.BlockAllocTime.AddBatch(Worker->GetTimer()->GetDuration(), BatchSize);
+				TotalTime += std::chrono::duration<float64, std::nano>(Worker->GetTimer()->GetDuration()).count() / BatchSize;
+			}
+		}
+
+		Str += "Block size: " + std::to_string(Sizes[s]) + " Bytes\tavg: " + std::to_string(TotalTime / BatchCount) + " ns\n";
+		ShowProgress((float64)(s + 1), (float64)SizeCount);
+	}
+
+	printf("MALLOC PERF TEST: MALLOC FAST PATH TEST is completed\n");
+
+	GLogger->DumpStrToFile(Str.c_str());
+}
+
+void Test_Perf_Calloc(TWorker* Worker)
+{
+	//	The first round is served from new pools and must not be zeroed by the allocator,
+	//	the next rounds reuse the same blocks and are compared with Malloc + memset;
+	TSize Sizes[] = { 256, 4096, 65536, 1048576, 16777216 };
+	TSize SizeCount = sizeof(Sizes) / sizeof(Sizes[0]);
+	const uint64 BlkCount = 16;
+	const uint64 RoundCount = 8;
+	void* Ptrs[BlkCount] = { nullptr };
+	uint32 Id = Worker->GetThreadId();
+
+	printf("MALLOC PERF TEST: Thread %i: Calloc: %llu blocks per size\n", Id, BlkCount);
+
+	std::string Str{};
+	Str += "-------------------------- CALLOC TEST ---------------------------\n";
+	Str += "MALLOC PERF TEST: " + std::string("Thread: ") + std::to_string(Id) + "\n";
+	Str += "Blocks per size: " + std::to_string(BlkCount) + "\tRounds: " + std::to_string(RoundCount) + "\n";
+
+	for (TSize s = 0; s < SizeCount; ++s)
+	{
+		float64 FirstTime = 0.0f;
+		float64 CallocTime = 0.0f;
+		float64 MemsetTime = 0.0f;
+
+		for (uint64 r = 0; r <= RoundCount; ++r)
+		{
+			Worker->StartTiming(BlkCount);
+			for (uint64 i = 0; i < BlkCount; ++i)
+			{
+				Ptrs[i] = Calloc(1, Sizes[s]);
+			}
+			Worker->StopTiming();
+			Worker->MallocTimeStats.BlockAllocTime.AddBatch(Worker->GetTimer()->GetDuration(), BlkCount);
+
+			float64 Time = std::chrono::duration<float64, std::nano>(Worker->GetTimer()->GetDuration()).count() / BlkCount;
+
+			if (r)
+			{
+				CallocTime += Time;
+			}
+			else
+			{
+				FirstTime = Time;
+			}
+
+			for (uint64 i = 0; i < BlkCount; ++i)
+			{
+				if (!Ptrs[i])
+				{
+					printf("\nMALLOC PERF TEST: PANIC!!! OUT OF MEMORY Line: %i\n", __LINE__);
+					TWorker::ExitCode.store(EXIT_FAILURE);
+					return;
+				}
+
+				uint8* Bytes = (uint8*)Ptrs[i];
+				if (Bytes[0] || Bytes[Sizes[s] / 2] || Bytes[Sizes[s] - 1])
+				{
+					printf("\nMALLOC PERF TEST: PANIC!!! CALLOC BLOCK IS NOT ZEROED Line: %i\n", __LINE__);
+					TWorker::ExitCode.store(EXIT_FAILURE);
+					return;
+				}
+
+				memset(Ptrs[i], 0xFF, Sizes[s]);
+				Free(Ptrs[i]);
+			}
+
+			if (r)
+			{
+				Worker->GetTimer()->Start();
+				for (uint64 i = 0; i < BlkCount; ++i)
+				{
+					Ptrs[i] = Malloc(Sizes[s]);
+					memset(Ptrs[i], 0, Sizes[s]);
+				}
+				Worker->GetTimer()->Stop();
+
+				MemsetTime += std::chrono::duration<float64, std::nano>(Worker->GetTimer()->GetDuration()).count() / BlkCount;
+
+				for (uint64 i = 0; i < BlkCount; ++i)
+				{
+					Free(Ptrs[i]);
+				}
+			}
+		}
+
+		Str += "Block size: " + std::to_string(Sizes[s]) + " Bytes\tnew pools: " + std::to_string(FirstTime) + " ns\trecycled: " + std::to_string(CallocTime / RoundCount) + " ns\tMalloc + memset: " + std::to_string(MemsetTime / RoundCount) + " ns\n";
+		ShowProgress((float64)(s + 1), (float64)SizeCount);
+	}
+
+	printf("MALLOC PERF TEST: CALLOC TEST is completed\n");
+
+	GLogger->DumpStrToFile(Str.c_str());
+}
+
+struct TPerfNode
+{
+	TPerfNode(uint64 Key) :
+		Key(Key),
+		Value(0),
+		Prev(nullptr),
+		Next(nullptr)
+	{
+	}
+
+	uint64 Key;
+	uint64 Value;
+	TPerfNode* Prev;
+	TPerfNode* Next;
+};
+
+static TObjectPool<TPerfNode> GNodePool;
+
+static void ReleaseObjectPools()
+{
+	GNodePool.Release();
+}
+
+void Test_Perf_Object_Pool(TWorker* Worker)
+{
+	//	The same node type is allocated by the general size classes, by the shared object pool
+	//	and by the object pool through a per thread cache;
+	const uint64 BlkCount = 4096;
+	const uint64 RoundCount = 256;
+	uint32 Id = Worker->GetThreadId();
+
+	std::vector<TPerfNode*> Nodes(BlkCount, nullptr);
+	TObjectPool<TPerfNode>::TCache NodeCache(GNodePool);
+
+	printf("MALLOC PERF TEST: Thread %i: Object pool: %llu nodes, %llu rounds\n", Id, BlkCount, RoundCount);
+
+	float64 MallocTime = 0.0f;
+	float64 PoolTime = 0.0f;
+	float64 CacheTime = 0.0f;
+
+	for (uint64 r = 0; r < RoundCount; ++r)
+	{
+		Worker->GetTimer()->Start();
+		for (uint64 i = 0; i < BlkCount; ++i)
+		{
+			Nodes[i] = new (Malloc(sizeof(TPerfNode), alignof(TPerfNode))) TPerfNode(i);
+		}
+		for (uint64 i = 0; i < BlkCount; ++i)
+		{
+			Free(Nodes[i]);
+		}
+		Worker->GetTimer()->Stop();
+		MallocTime += std::chrono::duration<float64, std::nano>(Worker->GetTimer()->GetDuration()).count();
+
+		Worker->GetTimer()->Start();
+		for (uint64 i = 0; i < BlkCount; ++i)
+		{
+			Nodes[i] = GNodePool.Create(i);
+		}
+		for (uint64 i = 0; i < BlkCount; ++i)
+		{
+			GNodePool.Destroy(Nodes[i]);
+		}
+		Worker->GetTimer()->Stop();
+		PoolTime += std::chrono::duration<float64, std::nano>(Worker->GetTimer()->GetDuration()).count();
+
+		Worker->GetTimer()->Start();
+		for (uint64 i = 0; i < BlkCount; ++i)
+		{
+			Nodes[i] = NodeCache.Create(i);
+		}
+		for (uint64 i = 0; i < BlkCount; ++i)
+		{
+			NodeCache.Destroy(Nodes[i]);
+		}
+		Worker->GetTimer()->Stop();
+		CacheTime += std::chrono::duration<float64, std::nano>(Worker->GetTimer()->GetDuration()).count();
+
+		ShowProgress((float64)(r + 1), (float64)RoundCount);
+	}
+
+	printf("MALLOC PERF TEST: OBJECT POOL TEST is completed\n");
+
+	float64 OpCount = (float64)(BlkCount * RoundCount);
+
+	std::string Str{};
+	Str += "----------------------- OBJECT POOL TEST -------------------------\n";
+	Str += "MALLOC PERF TEST: " + std::string("Thread: ") + std::to_string(Id) + "\n";
+	Str += "Node size: " + std::to_string(sizeof(TPerfNode)) + " Bytes\tNodes: " + std::to_string(BlkCount) + "\tRounds: " + std::to_string(RoundCount) + "\n";
+	Str += "Malloc + Free: " + std::to_string(MallocTime / OpCount) + " ns\n";
+	Str += "Object pool Create + Destroy: " + std::to_string(PoolTime / OpCount) + " ns\n";
+	Str += "Object pool cache Create + Destroy: " + std::to_string(CacheTime / OpCount) + " ns\n";
+	Str += "Object pool slabs: " + std::to_string(GNodePool.GetSlabCount()) + "\tAllocated: " + std::to_string(GNodePool.GetAllocatedSize()) + " Bytes\n";
+
+	GLogger->DumpStrToFile(Str.c_str());
+}
+
+void Test_Perf_Heap_Destroy(TWorker* Worker)
+{
+	//	A batch of blocks is freed one by one in the default allocator
+	//	and dropped at once by destroying a private heap;
+	const uint64 BlkCount = 65536;
+	const uint64 RoundCount = 16;
+	const TSize MinBlkSize = 16;
+	const TSize MaxBlkSize = 2048;
+	uint32 Id = Worker->GetThreadId();
+
+	std::vector<void*> Blocks(BlkCount, nullptr);
+
+	printf("MALLOC PERF TEST: Thread %i: Heap destroy: %llu blocks, %llu rounds\n", Id, BlkCount, RoundCount);
+
+	float64 MallocTime = 0.0f;
+	float64 FreeTime = 0.0f;
+	float64 HeapMallocTime = 0.0f;
+	float64 HeapDestroyTime = 0.0f;
+
+	TMallocConf HeapConf{};
+
+	for (uint64 r = 0; r < RoundCount; ++r)
+	{
+		Worker->GetTimer()->Start();
+		for (uint64 i = 0; i < BlkCount; ++i)
+		{
+			Blocks[i] = Malloc(MinBlkSize + (i * MinBlkSize) % MaxBlkSize);
+		}
+		Worker->GetTimer()->Stop();
+		MallocTime += std::chrono::duration<float64, std::nano>(Worker->GetTimer()->GetDuration()).count();
+
+		Worker->GetTimer()->Start();
+		for (uint64 i = 0; i < BlkCount; ++i)
+		{
+			Free(Blocks[i]);
+		}
+		Worker->GetTimer()->Stop();
+		FreeTime += std::chrono::duration<float64, std::nano>(Worker->GetTimer()->GetDuration()).count();
+
+		IMalloc* Heap = CreateHeap(HeapConf);
+
+		if (!Heap)
+		{
+			printf("MALLOC PERF TEST: Thread %i: Cannot create heap\n", Id);
+			TWorker::ExitCode.store(EXIT_FAILURE);
+			return;
+		}
+
+		Worker->GetTimer()->Start();
+		for (uint64 i = 0; i < BlkCount; ++i)
+		{
+			Blocks[i] = Heap->Malloc(MinBlkSize + (i * MinBlkSize) % MaxBlkSize, MALLOC_DEFAULT_ALIGNMENT);
+		}
+		Worker->GetTimer()->Stop();
+		HeapMallocTime += std::chrono::duration<float64, std::nano>(Worker->GetTimer()->GetDuration()).count();
+
+		Worker->GetTimer()->Start();
+		DestroyHeap(Heap);
+		Worker->GetTimer()->Stop();
+		HeapDestroyTime += std::chrono::duration<float64, std::nano>(Worker->GetTimer()->GetDuration()).count();
+
+		ShowProgress((float64)(r + 1), (float64)RoundCount);
+	}
+
+	printf("MALLOC PERF TEST: HEAP DESTROY TEST is completed\n");
+
+	float64 OpCount = (float64)(BlkCount * RoundCount);
+
+	std::string Str{};
+	Str += "----------------------- HEAP DESTROY TEST ------------------------\n";
+	Str += "MALLOC PERF TEST: " + std::string("Thread: ") + std::to_string(Id) + "\n";
+	Str += "Blocks: " + std::to_string(BlkCount) + "\tMax block size: " + std::to_string(MaxBlkSize) + " Bytes\tRounds: " + std::to_string(RoundCount) + "\n";
+	Str += "Malloc: " + std::to_string(MallocTime / OpCount) + " ns\n";
+	Str += "Free of all blocks: " + std::to_string(FreeTime / RoundCount / 1000.0) + " us\n";
+	Str += "Heap malloc: " + std::to_string(HeapMallocTime / OpCount) + " ns\n";
+	Str += "Heap destroy: " + std::to_string(HeapDestroyTime / RoundCount / 1000.0) + " us\n";
+
+	GLogger->DumpStrToFile(Str.c_str());
+}
+
+void Test_Perf_Prewarm(TWorker* Worker)
+{
+	//	Latency of the first allocations of a size class, cold and after Prewarm;
+	const uint64 BlkCount = 131072;
+	const TSize BlkSize = 40;
+	uint32 Id = Worker->GetThreadId();
+
+	std::vector<void*> Blocks(BlkCount, nullptr);
+
+	printf("MALLOC PERF TEST: Thread %i: Prewarm: %llu blocks\n", Id, BlkCount);
+
+	float64 ColdTime = 0.0f;
+	float64 ColdMaxTime = 0.0f;
+	float64 WarmTime = 0.0f;
+	float64 WarmMaxTime = 0.0f;
+	float64 PrewarmTime = 0.0f;
+
+	for (uint32 Warm = 0; Warm < 2; ++Warm)
+	{
+		if (Warm)
+		{
+			Worker->GetTimer()->Start();
+			Prewarm(BlkSize, BlkCount);
+			Worker->GetTimer()->Stop();
+			PrewarmTime = std::chrono::duration<float64, std::micro>(Worker->GetTimer()->GetDuration()).count();
+		}
+
+		float64& Time = Warm ? WarmTime : ColdTime;
+		float64& MaxTime = Warm ? WarmMaxTime : ColdMaxTime;
+
+		for (uint64 i = 0; i < BlkCount; ++i)
+		{
+			Worker->GetTimer()->Start();
+			Blocks[i] = Malloc(BlkSize);
+			*(uint8*)Blocks[i] = 0;
+			Worker->GetTimer()->Stop();
+
+			float64 Duration = std::chrono::duration<float64, std::nano>(Worker->GetTimer()->GetDuration()).count();
+			Time += Duration;
+			MaxTime = Duration > MaxTime ? Duration : MaxTime;
+		}
+
+		for (uint64 i = 0; i < BlkCount; ++i)
+		{
+			Free(Blocks[i]);
+		}
+
+		ShowProgress((float64)(Warm + 1), 2.0f);
+	}
+
+	printf("MALLOC PERF TEST: PREWARM TEST is completed\n");
+
+	std::string Str{};
+	Str += "------------------------- PREWARM TEST ---------------------------\n";
+	Str += "MALLOC PERF TEST: " + std::string("Thread: ") + std::to_string(Id) + "\n";
+	Str += "Block size: " + std::to_string(BlkSize) + " Bytes\tBlocks: " + std::to_string(BlkCount) + "\n";
+	Str += "Cold malloc: " + std::to_string(ColdTime / BlkCount) + " ns\tMax: " + std::to_string(ColdMaxTime / 1000.0) + " us\n";
+	Str += "Prewarm: " + std::to_string(PrewarmTime) + " us\n";
+	Str += "Prewarmed malloc: " + std::to_string(WarmTime / BlkCount) + " ns\tMax: " + std::to_string(WarmMaxTime / 1000.0) + " us\n";
+
+	GLogger->DumpStrToFile(Str.c_str());
+}
+
+void Test_Perf_Trim(TWorker* Worker)
+{
+	//	Trim after a burst of small blocks was freed, the second call finds nothing left to purge;
+	const uint64 BlkCount = 262144;
+	const TSize BlkSizes[] = { 32, 128, 512 };
+	uint32 Id = Worker->GetThreadId();
+
+	std::vector<void*> Blocks(BlkCount, nullptr);
+
+	printf("MALLOC PERF TEST: Thread %i: Trim: %llu blocks per size\n", Id, BlkCount);
+
+	for (TSize BlkSize : BlkSizes)
+	{
+		for (uint64 i = 0; i < BlkCount; ++i)
+		{
+			Blocks[i] = Malloc(BlkSize);
+
+			if (!Blocks[i])
+			{
+				printf("\nMALLOC PERF TEST: PANIC!!! OUT OF MEMORY Line: %i\n", __LINE__);
+				TWorker::ExitCode.store(EXIT_FAILURE);
+				return;
+			}
+
+			*(uint8*)Blocks[i] = 0;
+		}
+
+		for (uint64 i = 0; i < BlkCount; ++i)
+		{
+			Free(Blocks[i]);
+		}
+	}
+
+	Worker->GetTimer()->Start();
+	TSize TrimmedSize = Trim(0);
+	Worker->GetTimer()->Stop();
+	float64 TrimTime = std::chrono::duration<float64, std::micro>(Worker->GetTimer()->GetDuration()).count();
+
+	Worker->GetTimer()->Start();
+	TSize RetrimmedSize = Trim(0);
+	Worker->GetTimer()->Stop();
+	float64 RetrimTime = std::chrono::duration<float64, std::micro>(Worker->GetTimer()->GetDuration()).count();
+
+	ShowProgress(1.0f, 1.0f);
+
+	printf("MALLOC PERF TEST: TRIM TEST is completed\n");
+
+	std::string Str{};
+	Str += "--------------------------- TRIM TEST ----------------------------\n";
+	Str += "MALLOC PERF TEST: " + std::string("Thread: ") + std::to_string(Id) + "\n";
+	Str += "Blocks per size: " + std::to_string(BlkCount) + "\n";
+	Str += "Trim: " + std::to_string(TrimmedSize) + " Bytes\tTime: " + std::to_string(TrimTime) + " us\n";
+	Str += "Second trim: " + std::to_string(RetrimmedSize) + " Bytes\tTime: " + std::to_string(RetrimTime) + " us\n";
+
+	GLogger->DumpStrToFile(Str.c_str());
+}
+
+//	Builds a chain through the first blocks of PoolCount pools of Heap, returns false when out of memory;
+static bool BuildPoolChain(IMalloc* Heap, TSize BlkSize, TSize PoolSize, uint64 PoolCount, std::vector<void*>& OutFirstBlocks)
+{
+	void* PrevBlock = nullptr;
+
+	while (OutFirstBlocks.size() < PoolCount)
+	{
+		void* Block = Heap->Malloc(BlkSize, MALLOC_DEFAULT_ALIGNMENT);
+
+		if (!Block)
+		{
+			return false;
+		}
+
+		//	Blocks of a pool are handed out in address order, a jump means a new pool;
+		if (!PrevBlock || Block < PrevBlock || (TSize)((uint8*)Block - (uint8*)PrevBlock) > PoolSize / 2)
+		{
+			OutFirstBlocks.push_back(Block);
+		}
+
+		PrevBlock = Block;
+	}
+
+	for (uint64 i = 0; i < PoolCount; ++i)
+	{
+		*(void**)OutFirstBlocks[i] = OutFirstBlocks[(i + 1) % PoolCount];
+	}
+
+	return true;
+}
+
+void Test_Perf_Pool_Coloring(TWorker* Worker)
+{
+	//	Chases pointers through the first blocks of many small pools, with every pool starting
+	//	at the same offset of its arena page and with the pool starts rotated by cache lines;
+	const TSize PoolSize = 65536;
+	const TSize BlkSize = 1024;
+	const uint64 PoolCounts[] = { 16, 64, 256, 512 };
+	const uint64 StepCount = 10000000;
+	uint32 Id = Worker->GetThreadId();
+
+	printf("MALLOC PERF TEST: Thread %i: Pool coloring: %llu Bytes pools, %llu Bytes blocks\n", Id, PoolSize, BlkSize);
+
+	std::string Str{};
+	Str += "---------------------- POOL COLORING TEST ------------------------\n";
+	Str += "MALLOC PERF TEST: " + std::string("Thread: ") + std::to_string(Id) + "\n";
+	Str += "Pool size: " + std::to_string(PoolSize) + " Bytes\tBlock size: " + std::to_string(BlkSize) + " Bytes\tSteps: " + std::to_string(StepCount) + "\n";
+
+	for (uint64 p = 0; p < sizeof(PoolCounts) / sizeof(PoolCounts[0]); ++p)
+	{
+		float64 StepTimes[2] = {};
+
+		for (TSize Colored = 0; Colored < 2; ++Colored)
+		{
+			TMallocConf HeapConf{};
+			HeapConf.PoolBlockSize = PoolSize;
+			HeapConf.PoolColorCount = Colored ? 0 : 1;
+
+			IMalloc* Heap = CreateHeap(HeapConf);
+
+			if (!Heap)
+			{
+				printf("MALLOC PERF TEST: Thread %i: Cannot create heap\n", Id);
+				TWorker::ExitCode.store(EXIT_FAILURE);
+				return;
+			}
+
+			std::vector<void*> FirstBlocks{};
+
+			if (!BuildPoolChain(Heap, BlkSize, PoolSize, PoolCounts[p], FirstBlocks))
+			{
+				printf("\nMALLOC PERF TEST: PANIC!!! OUT OF MEMORY Line: %i\n", __LINE__);
+				TWorker::ExitCode.store(EXIT_FAILURE);
+				DestroyHeap(Heap);
+				return;
+			}
+
+			void* volatile Block = FirstBlocks[0];
+			void* Next = Block;
+
+			Worker->GetTimer()->Start();
+			for (uint64 i = 0; i < StepCount; ++i)
+			{
+				Next = *(void**)Next;
+			}
+			Worker->GetTimer()->Stop();
+			Block = Next;
+
+			StepTimes[Colored] = std::chrono::duration<float64, std::nano>(Worker->GetTimer()->GetDuration()).count() / StepCount;
+
+			DestroyHeap(Heap);
+		}
+
+		ShowProgress((float64)(p + 1), (float64)(sizeof(PoolCounts) / sizeof(PoolCounts[0])));
+
+		Str += "Pools: " + std::to_string(PoolCounts[p]) + "\tSame offset: " + std::to_string(StepTimes[0]) + " ns\tColored: " + std::to_string(StepTimes[1]) + " ns\n";
+	}
+
+	printf("MALLOC PERF TEST: POOL COLORING TEST is completed\n");
+
+	GLogger->DumpStrToFile(Str.c_str());
+}
+
+//	Counts the cache lines spanned by the blocks of more than one thread, headers included;
+static uint64 CountSharedLines(const std::vector<std::vector<void*>>& Blocks, TSize BlkSize)
+{
+	const TSize LineSize = 64;
+	std::vector<std::pair<uintptr_t, TSize>> Lines{};
+
+	for (TSize t = 0; t < Blocks.size(); ++t)
+	{
+		for (void* Block : Blocks[t])
+		{
+			uintptr_t First = ((uintptr_t)Block - LineSize) / LineSize;
+			uintptr_t Last = ((uintptr_t)Block + BlkSize - 1) / LineSize;
+
+			for (uintptr_t Line = First; Line <= Last; ++Line)
+			{
+				Lines.push_back({ Line, t });
+			}
+		}
+	}
+
+	std::sort(Lines.begin(), Lines.end());
+
+	uint64 SharedCount = 0;
+	TSize LineBegin = 0;
+
+	//	Sorted by line then thread, a line is shared when its first and last entries differ by thread;
+	for (TSize i = 1; i <= Lines.size(); ++i)
+	{
+		if (i == Lines.size() || Lines[i].first != Lines[LineBegin].first)
+		{
+			if (Lines[i - 1].second != Lines[LineBegin].second)
+			{
+				++SharedCount;
+			}
+
+			LineBegin = i;
+		}
+	}
+
+	return SharedCount;
+}
+
+void Test_Perf_False_Sharing(TWorker* Worker)
+{
+	//	Threads take turns allocating small blocks from one heap, then each one keeps writing its own blocks.
+	//	With a single pool per size class the neighbour blocks belong to other threads, with thread_pools
+	//	every thread carves from a pool of its own. Each worker has a heap of its own, so its threads
+	//	take distinct head slots of it;
+	const uint32 ThreadCount = 4;
+	const uint64 BlkCount = 1024;
+	const uint64 RoundCount = 4096;
+	const TSize BlkSizes[] = { 8, 32 };
+	uint32 Id = Worker->GetThreadId();
+
+	printf("MALLOC PERF TEST: Thread %i: False sharing: %u threads, %llu blocks per thread\n", Id, ThreadCount, BlkCount);
+
+	std::string Str{};
+	Str += "---------------------- FALSE SHARING TEST ------------------------\n";
+	Str += "MALLOC PERF TEST: " + std::string("Thread: ") + std::to_string(Id) + "\n";
+	Str += "Threads: " + std::to_string(ThreadCount) + "\tBlocks per thread: " + std::to_string(BlkCount) + "\tRounds: " + std::to_string(RoundCount) + "\n";
+
+	for (uint64 s = 0; s < sizeof(BlkSizes) / sizeof(BlkSizes[0]); ++s)
+	{
+		for (TSize ThreadPools : { (TSize)1, (TSize)ThreadCount })
+		{
+			TMallocConf HeapConf{};
+			HeapConf.ThreadPoolCount = ThreadPools;
+
+			IMalloc* Heap = CreateHeap(HeapConf);
+
+			if (!Heap)
+			{
+				printf("MALLOC PERF TEST: Thread %i: Cannot create heap\n", Id);
+				TWorker::ExitCode.store(EXIT_FAILURE);
+				return;
+			}
+
+			std::vector<std::vector<void*>> Blocks(ThreadCount);
+			std::vector<float64> WriteTimes(ThreadCount, 0.0f);
+			std::atomic<uint64> Turn{ 0 };
+			std::atomic<uint32> Ready{ 0 };
+			std::atomic<bool> Failed{ false };
+			std::vector<std::thread> Threads{};
+
+			for (uint32 t = 0; t < ThreadCount; ++t)
+			{
+				Threads.emplace_back([&, t]()
+				{
+					for (uint64 i = 0; i < BlkCount; ++i)
+					{
+						while (Turn.load() % ThreadCount != t)
+						{
+							std::this_thread::yield();
+						}
+
+						//	After a failure the turns still go round, so no thread waits for its turn forever;
+						void* Block = Failed.load() ? nullptr : Heap->Malloc(BlkSizes[s], MALLOC_DEFAULT_ALIGNMENT);
+
+						if (Block)
+						{
+							Blocks[t].push_back(Block);
+						}
+						else if (!Failed.exchange(true))
+						{
+							printf("\nMALLOC PERF TEST: PANIC!!! OUT OF MEMORY Line: %i\n", __LINE__);
+							TWorker::ExitCode.store(EXIT_FAILURE);
+						}
+
+						Turn.fetch_add(1);
+					}
+
+					++Ready;
+
+					while (Ready.load() != ThreadCount)
+					{
+						std::this_thread::yield();
+					}
+
+					if (Failed.load())
+					{
+						return;
+					}
+
+					TTimer Timer{};
+					Timer.Start();
+					for (uint64 r = 0; r < RoundCount; ++r)
+					{
+						for (void* Block : Blocks[t])
+						{
+							++*(volatile uint64*)Block;
+						}
+					}
+					Timer.Stop();
+
+					WriteTimes[t] = std::chrono::duration<float64, std::nano>(Timer.GetDuration()).count() / (RoundCount * BlkCount);
+				});
+			}
+
+			for (std::thread& Thread : Threads)
+			{
+				Thread.join();
+			}
+
+			//	The blocks allocated before the failure go with the heap;
+			if (Failed.load())
+			{
+				DestroyHeap(Heap);
+				return;
+			}
+
+			float64 WriteTime = 0.0f;
+
+			for (float64 Time : WriteTimes)
+			{
+				WriteTime += Time / ThreadCount;
+			}
+
+			uint64 SharedLines = CountSharedLines(Blocks, BlkSizes[s]);
+
+			DestroyHeap(Heap);
+
+			Str += "Block size: " + std::to_string(BlkSizes[s]) + " Bytes\tThread pools: " + std::to_string(ThreadPools) +
+				"\tShared lines: " + std::to_string(SharedLines) + "\tWrite: " + std::to_string(WriteTime) + " ns\n";
+		}
+
+		ShowProgress((float64)(s + 1), (float64)(sizeof(BlkSizes) / sizeof(BlkSizes[0])));
+	}
+
+	printf("MALLOC PERF TEST: FALSE SHARING TEST is completed\n");
+
+	GLogger->DumpStrToFile(Str.c_str());
+}
+
+void Test_Perf_Heap_Profiler(TWorker* Worker)
+{
+	//	Replaces the blocks of a ring of slots by blocks of pseudo random sizes, with the heap profiler off
+	//	and sampling every 512 KB and 64 KB allocated on average;
+	const uint64 SlotCount = 4096;
+	const uint64 StepCount = 4000000;
+	const TSize MaxBlkSize = 4096;
+	const TSize SampleIntervals[] = { 0, 524288, 65536 };
+	uint32 Id = Worker->GetThreadId();
+
+	printf("MALLOC PERF TEST: Thread %i: Heap profiler: %llu slots, blocks up to %llu Bytes\n", Id, SlotCount, MaxBlkSize);
+
+	std::string Str{};
+	Str += "---------------------- HEAP PROFILER TEST ------------------------\n";
+	Str += "MALLOC PERF TEST: " + std::string("Thread: ") + std::to_string(Id) + "\n";
+	Str += "Slots: " + std::to_string(SlotCount) + "\tMax block size: " + std::to_string(MaxBlkSize) + " Bytes\tSteps: " + std::to_string(StepCount) + "\n";
+
+	for (uint64 p = 0; p < sizeof(SampleIntervals) / sizeof(SampleIntervals[0]); ++p)
+	{
+		TMallocConf HeapConf{};
+		HeapConf.ProfSampleInterval = SampleIntervals[p];
+
+		IMalloc* Heap = CreateHeap(HeapConf);
+
+		if (!Heap)
+		{
+			printf("MALLOC PERF TEST: Thread %i: Cannot create heap\n", Id);
+			TWorker::ExitCode.store(EXIT_FAILURE);
+			return;
+		}
+
+		std::vector<void*> Slots(SlotCount, nullptr);
+		uint64 Random = 0x9E3779B97F4A7C15ull;
+
+		Worker->GetTimer()->Start();
+		for (uint64 i = 0; i < StepCount; ++i)
+		{
+			Random = Random * 6364136223846793005ull + 1442695040888963407ull;
+			void*& Slot = Slots[i & (SlotCount - 1)];
+
+			Heap->Free(Slot);
+			Slot = Heap->Malloc(16 + (Random >> 33) % MaxBlkSize, MALLOC_DEFAULT_ALIGNMENT);
+		}
+		Worker->GetTimer()->Stop();
+
+		float64 StepTime = std::chrono::duration<float64, std::nano>(Worker->GetTimer()->GetDuration()).count() / StepCount;
+
+		//	The profile of the live blocks goes to the log; the writer allocates from the default allocator, not from the heap;
+		std::string Profile{};
+
+		if (SampleIntervals[p] &&
+			!DumpHeapProfileOf(Heap, [](const char* Data, TSize Size, void* Context) { ((std::string*)Context)->append(Data, Size); }, &Profile))
+		{
+			printf("MALLOC PERF TEST: Thread %i: Cannot dump heap profile\n", Id);
+			TWorker::ExitCode.store(EXIT_FAILURE);
+		}
+
+		for (void* Slot : Slots)
+		{
+			Heap->Free(Slot);
+		}
+
+		DestroyHeap(Heap);
+
+		ShowProgress((float64)(p + 1), (float64)(sizeof(SampleIntervals) / sizeof(SampleIntervals[0])));
+
+		Str += "Sample interval: " + (SampleIntervals[p] ? std::to_string(SampleIntervals[p]) + " Bytes" : std::string("off")) +
+			"\tFree + malloc: " + std::to_string(StepTime) + " ns\n";
+		Str += Profile;
+	}
+
+	printf("MALLOC PERF TEST: HEAP PROFILER TEST is completed\n");
+
+	GLogger->DumpStrToFile(Str.c_str());
+}
+
+//	Resident set of the process: /proc/self/statm on Linux, the working set on Windows;
+static TSize GetResidentSetSize()
+{
+#ifdef PLATFORM_WIN
+	PROCESS_MEMORY_COUNTERS Counters = {};
+
+	if (!K32GetProcessMemoryInfo(GetCurrentProcess(), &Counters, sizeof(Counters)))
+	{
+		return 0;
+	}
+
+	return Counters.WorkingSetSize;
+#elif defined(PLATFORM_LINUX)
+	FILE* Statm = fopen("/proc/self/statm", "r");
+	unsigned long long TotalPages = 0;
+	unsigned long long ResidentPages = 0;
+
+	if (!Statm)
+	{
+		return 0;
+	}
+
+	if (fscanf(Statm, "%llu %llu", &TotalPages, &ResidentPages) != 2)
+	{
+		ResidentPages = 0;
+	}
+
+	fclose(Statm);
+
+	return (TSize)ResidentPages * sysconf(_SC_PAGESIZE);
+#else
+	return 0;
+#endif
+}
+
+struct TAgingBlock
+{
+	void* Ptr;
+	TSize Size;
+	uint64 ExpireStep;
+};
+
+struct TAgingSample
+{
+	float64 Seconds;
+	TSize LiveSize;        // Requested bytes of the blocks alive in all threads;
+	TSize ResidentSize;
+	TSize ConsumedSize;    // Block bytes of the used pool blocks;
+	TSize MappedSize;      // Bytes of the pools in use;
+	TSize ArenaUsedSize;
+	TSize ArenaReservedSize;
+	TSize FreeRunCount;    // Free fragments of the page allocator arenas;
+	TSize LargestFreeRun;
+};
+
+static std::atomic<TSize>  AgingLiveSize{ 0 };
+static std::atomic<uint32> AgingThreadCount{ 0 };
+
+static void TakeAgingSample(float64 Seconds, vector<TSizeClassStats>& Classes, vector<TPageMallocArenaStats>& Arenas, TAgingSample& OutSample)
+{
+	OutSample = {};
+	OutSample.Seconds = Seconds;
+	OutSample.LiveSize = AgingLiveSize.load(std::memory_order_relaxed);
+	OutSample.ResidentSize = GetResidentSetSize();
+
+	TSize ClassCount = GetSizeClassStats(Classes.data(), Classes.size());
+
+	for (TSize i = 0; i < ClassCount; ++i)
+	{
+		OutSample.ConsumedSize += Classes[i].ConsumedSize;
+		OutSample.MappedSize += Classes[i].MappedSize;
+	}
+
+	TSize ArenaCount = GetArenaStats(Arenas.data(), Arenas.size());
+
+	for (TSize i = 0; i < ArenaCount; ++i)
+	{
+		OutSample.ArenaUsedSize += Arenas[i].UsedSize;
+		OutSample.ArenaReservedSize += Arenas[i].ReservedSize;
+		OutSample.FreeRunCount += Arenas[i].FreeRunCount;
+		OutSample.LargestFreeRun = std::max(OutSample.LargestFreeRun, Arenas[i].LargestFreeRun);
+	}
+}
+
+void Test_Perf_Fragmentation_Aging(TWorker* Worker)
+{
+	//	Long running churn: blocks of a mixed size distribution with random lifetimes are put into random
+	//	slots of a working set. The favoured sizes move every phase, so the blocks outliving a phase pin
+	//	pools and pages of sizes no longer asked for. The first thread in samples the memory of the
+	//	process every second, the time series of live bytes / RSS shows how the efficiency ages;
+	const uint64 SlotCount = 65536;
+	const uint32 PhaseCount = 8;
+	const uint64 CheckStepCount = 1024;
+	const std::chrono::milliseconds SampleInterval{ 1000 };
+	const std::chrono::seconds Duration{ TWorker::AgingSeconds };
+	uint32 Id = Worker->GetThreadId();
+	bool Sampler = AgingThreadCount.fetch_add(1) == 0;
+
+	printf("MALLOC PERF TEST: Thread %i: Fragmentation aging: %u seconds, %llu slots, %u size phases\n", Id, TWorker::AgingSeconds, SlotCount, PhaseCount);
+
+	vector<TAgingBlock> Slots(SlotCount, TAgingBlock{ nullptr, 0, 0 });
+	vector<TAgingSample> Samples;
+	vector<TSizeClassStats> Classes(Sampler ? 4096 : 0);
+	vector<TPageMallocArenaStats> Arenas(Sampler ? PAGE_MALLOC_MAX_ARENA_COUNT : 0);
+
+	uint64 Random = 0x9E3779B97F4A7C15ull ^ ((uint64)Id << 32);
+	uint64 Step = 0;
+	bool Ok = true;
+
+	auto StartTime = std::chrono::steady_clock::now();
+	auto NextSampleTime = StartTime;
+	auto Elapsed = std::chrono::steady_clock::duration{};
+
+	while (Ok && Elapsed < Duration)
+	{
+		uint32 Phase = (uint32)(Elapsed * PhaseCount / Duration);
+
+		for (uint64 c = 0; c < CheckStepCount; ++c, ++Step)
+		{
+			Random = Random * 6364136223846793005ull + 1442695040888963407ull;
+			TAgingBlock& Slot = Slots[(Random >> 16) % SlotCount];
+
+			if (Slot.Ptr)
+			{
+				if (Slot.ExpireStep > Step)
+				{
+					continue;
+				}
+
+				Worker->StartTiming();
+				Free(Slot.Ptr);
+				Worker->StopTiming();
+				Worker->MallocTimeStats.BlockFreeTime += Worker->GetTimer()->GetDuration();
+
+				AgingLiveSize.fetch_sub(Slot.Size, std::memory_order_relaxed);
+				Slot.Ptr = nullptr;
+				continue;
+			}
+
+			//	60% small, 30% medium and 10% large blocks, log uniform in a window of each band moving with the phase;
+			uint64 Band = (Random >> 40) % 10;
+			uint64 MinLog2 = Band < 6 ? 4 : (Band < 9 ? 8 : 12);
+			uint64 WindowLog2 = MinLog2 + (Phase % 4);
+			TSize Size = ((TSize)1 << WindowLog2) + (TSize)((Random >> 20) % ((TSize)3 << WindowLog2));
+
+			//	80% of the blocks die young, 19.9% live up to some phases and 0.1% about to the end;
+			uint64 Lifetime = (Random >> 50) % 1000;
+			Lifetime = Lifetime < 800 ? (Random >> 8) % 4096 : (Lifetime < 999 ? (Random >> 8) % 4194304 : (Random >> 8) % 17179869184ull);
+
+			Worker->StartTiming();
+			Slot.Ptr = Malloc(Size);
+			Worker->StopTiming();
+			Worker->MallocTimeStats.BlockAllocTime += Worker->GetTimer()->GetDuration();
+
+			if (!Slot.Ptr)
+			{
+				Ok = false;
+				break;
+			}
+
+			//	Touched like real data, so RSS counts the pages the blocks occupy;
+			memset(Slot.Ptr, 0xA5, Size);
+
+			Slot.Size = Size;
+			Slot.ExpireStep = Step + Lifetime;
+			AgingLiveSize.fetch_add(Size, std::memory_order_relaxed);
+		}
+
+		auto Now = std::chrono::steady_clock::now();
+		Elapsed = Now - StartTime;
+
+		if (Sampler && Now >= NextSampleTime)
+		{
+			Samples.emplace_back();
+			TakeAgingSample(std::chrono::duration<float64>(Elapsed).count(), Classes, Arenas, Samples.back());
+			NextSampleTime += SampleInterval;
+
+			ShowProgress(std::chrono::duration<float64>(Elapsed).count(), (float64)TWorker::AgingSeconds);
+		}
+	}
+
+	if (Sampler)
+	{
+		Samples.emplace_back();
+		TakeAgingSample(std::chrono::duration<float64>(Elapsed).count(), Classes, Arenas, Samples.back());
+	}
+
+	for (TAgingBlock& Slot : Slots)
+	{
+		if (Slot.Ptr)
+		{
+			Free(Slot.Ptr);
+			AgingLiveSize.fetch_sub(Slot.Size, std::memory_order_relaxed);
+		}
+	}
+
+	AgingThreadCount.fetch_sub(1);
+
+	if (!Ok)
+	{
+		printf("\nMALLOC PERF TEST: PANIC!!! OUT OF MEMORY Line: %i\n", __LINE__);
+		TWorker::ExitCode.store(EXIT_FAILURE);
+		return;
+	}
+
+	printf("MALLOC PERF TEST: FRAGMENTATION AGING TEST is completed\n");
+
+	std::string Str{};
+	Str += "------------------- FRAGMENTATION AGING TEST ---------------------\n";
+	Str += "MALLOC PERF TEST: " + std::string("Thread: ") + std::to_string(Id) + "\n";
+	Str += "Duration: " + std::to_string(TWorker::AgingSeconds) + " seconds\tSlots: " + std::to_string(SlotCount) + "\tSteps: " + std::to_string(Step) + "\n";
+
+	if (Sampler)
+	{
+		Str += "seconds\tlive\trss\tconsumed\tmapped\tarena_used\tarena_reserved\tfree_runs\tlargest_free_run\tlive/rss\n";
+
+		for (const TAgingSample& Sample : Samples)
+		{
+			float64 Efficiency = Sample.ResidentSize ? (float64)Sample.LiveSize / Sample.ResidentSize : 0.0;
+
+			Str += std::to_string(Sample.Seconds) + "\t" + std::to_string(Sample.LiveSize) + "\t" + std::to_string(Sample.ResidentSize) + "\t" +
+				std::to_string(Sample.ConsumedSize) + "\t" + std::to_string(Sample.MappedSize) + "\t" +
+				std::to_string(Sample.ArenaUsedSize) + "\t" + std::to_string(Sample.ArenaReservedSize) + "\t" +
+				std::to_string(Sample.FreeRunCount) + "\t" + std::to_string(Sample.LargestFreeRun) + "\t" + std::to_string(Efficiency) + "\n";
+		}
+	}
+
+	GLogger->DumpStrToFile(Str.c_str());
+}
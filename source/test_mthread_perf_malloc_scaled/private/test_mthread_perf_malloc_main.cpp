@@ -1,5 +1,6 @@
 #include "test_mthread_perf_malloc.h"
 #include "timer.h"
+#include "trace_replay.h"
 #include <vector>
 #include <memory>
 #include <cstring>
@@ -9,27 +10,24 @@ using std::unique_ptr;
 using std::vector;
 vector<unique_ptr<TWorker>>* Workers = nullptr;
 
-int32 ParseCmdLine(const char* Line)
+//	Returns the value of a "--name=value" argument, nullptr when Line is another argument;
+const char* ParseCmdLineValue(const char* Line, const char* Token)
 {
-	const char* NumStr = nullptr;
-	const char* Token = "--thread-count=";
-	TSize TokenLen = strlen("--thread-count=");
+	TSize TokenLen = strlen(Token);
 
-	for (int32 i = 0; i < strlen(Line); ++i)
+	if (strncmp(Line, Token, TokenLen) != 0)
 	{
-		if (Line[i] != Token[i])
-		{
-			return 0;
-		}
-
-		if (Token[i] == '=' && i == (TokenLen - 1))
-		{
-			NumStr = &Line[TokenLen];
-			break;
-		}
+		return nullptr;
 	}
 
-	if (NumStr == 0)
+	return &Line[TokenLen];
+}
+
+int32 ParseCmdLine(const char* Line)
+{
+	const char* NumStr = ParseCmdLineValue(Line, "--thread-count=");
+
+	if (NumStr == 0 || !*NumStr)
 	{
 		return 0;
 	}
@@ -38,15 +36,76 @@ int32 ParseCmdLine(const char* Line)
 	return Num;
 }
 
+int32 RunTraceReplay(const char* TracePath, EReplayMalloc MallocToUse)
+{
+	const char* MallocName = MallocToUse == REPLAY_MALLOC_SYSTEM ? "system" : "scaled";
+
+	printf("MALLOC PERF TEST: Replaying allocation trace %s with %s malloc\n", TracePath, MallocName);
+
+	TReplayResult Result{};
+
+	if (!ReplayAllocTrace(TracePath, MallocToUse, Result))
+	{
+		printf("MALLOC PERF TEST: Trace replay failed\n");
+		return EXIT_FAILURE;
+	}
+
+	std::string Str{};
+	Str += "=============== Allocation trace replay ===============\n";
+	Str += "Trace: " + std::string(TracePath) + "\tMalloc: " + MallocName + "\n";
+	Str += "Threads: " + std::to_string(Result.ThreadCount) + "\tRequests: " + std::to_string(Result.OpCount) + "\tSkipped (blocks from before the trace): " + std::to_string(Result.SkippedCount) + "\n";
+	Str += "Total time: " + std::to_string(Result.TotalTime) + " seconds\tThroughput: " + std::to_string(Result.OpsPerSecond) + " requests/second\n";
+	Str += "Latency, ns: p50: " + std::to_string(Result.P50Time.count()) + "\tp90: " + std::to_string(Result.P90Time.count()) +
+		"\tp99: " + std::to_string(Result.P99Time.count()) + "\tp99.9: " + std::to_string(Result.P999Time.count()) + "\tmax: " + std::to_string(Result.MaxTime.count()) + "\n";
+	Str += "Peak RSS: " + std::to_string(Result.PeakResidentSize) + " bytes\n";
+	Str += "============================== END ===============================\n";
+
+	GLogger->DumpStrToFile(Str.c_str());
+	printf("%s", Str.c_str());
+
+	return EXIT_SUCCESS;
+}
+
 int main(int Argc, char* Argv[])
 {
 	std::string ExePath{ Argv[0] };
 	std::string Path = ExePath.substr(0, ExePath.find_last_of("\\/")) + "\\multi_thread_perf_tests.txt";
 
 	int32 NumOfThreads = DEFAULT_MAX_CONCURENT_THREADS;
-	if (Argc == 2)
+	const char* TracePath = nullptr;
+	EReplayMalloc ReplayMalloc = REPLAY_MALLOC_SCALED;
+
+	for (int32 i = 1; i < Argc; ++i)
 	{
-		int32 N = ParseCmdLine(Argv[1]);
+		const char* Value = nullptr;
+
+		if ((Value = ParseCmdLineValue(Argv[i], "--replay=")) != nullptr)
+		{
+			TracePath = Value;
+			continue;
+		}
+
+		if ((Value = ParseCmdLineValue(Argv[i], "--replay-malloc=")) != nullptr)
+		{
+			ReplayMalloc = strcmp(Value, "system") == 0 ? REPLAY_MALLOC_SYSTEM : REPLAY_MALLOC_SCALED;
+			continue;
+		}
+
+		if ((Value = ParseCmdLineValue(Argv[i], "--aging-seconds=")) != nullptr)
+		{
+			int32 Seconds = *Value ? std::stoi(Value) : 0;
+			TWorker::AgingSeconds = Seconds > 0 ? Seconds : TWorker::AgingSeconds;
+			continue;
+		}
+
+		if ((Value = ParseCmdLineValue(Argv[i], "--timing-batch=")) != nullptr)
+		{
+			int32 BatchSize = *Value ? std::stoi(Value) : 0;
+			TWorker::TimingBatchSize = BatchSize > 0 ? BatchSize : 1;
+			continue;
+		}
+
+		int32 N = ParseCmdLine(Argv[i]);
 		
 		if (N)
 		{
@@ -54,11 +113,19 @@ int main(int Argc, char* Argv[])
 		}
 		else
 		{
-			printf("MALLOC PERF TEST: Warning: Invalid first argument. Use: --thread-count='Count'\n");
+			printf("MALLOC PERF TEST: Warning: Invalid argument. Use: --thread-count='Count' [--timing-batch='Count'] [--aging-seconds='Count'] or --replay='Trace' [--replay-malloc=scaled|system]\n");
 			printf("MALLOC PERF TEST: Default thread count will be used\n");
 		}
 	}
 
+	if (TracePath)
+	{
+		TLogger Logger(Path.c_str());
+		GLogger = &Logger;
+
+		return RunTraceReplay(TracePath, ReplayMalloc);
+	}
+
 	printf("MALLOC PERF TEST: Memory allocator performance tests\n");
 	printf("MALLOC PERF TEST: Every task needs a while time to complete (several minutes), please wait!\n");
 	printf("MALLOC PERF TEST: Number of threads will be created is %i\n", NumOfThreads);
@@ -77,7 +144,24 @@ int main(int Argc, char* Argv[])
 
 	GLogger->DumpStrToFile("=============== Memory allocator performance tests ===============\n");
 
+	TMallocConf Conf{};
+	GetMallocConf(Conf);
+
+	std::string ConfStr{};
+	ConfStr += "Effective allocator configuration (" MALLOC_SCALED_CONF_ENV "):\n";
+	ConfStr += "min_block:" + std::to_string(Conf.MinBaseBlockSize) + "\tmax_block:" + std::to_string(Conf.MaxBaseBlockSize) + "\tsubindex_count:" + std::to_string(Conf.SubIndexCount) + "\n";
+	ConfStr += "pool_size:" + std::to_string(Conf.PoolBlockSize) + "\tarena_size:" + std::to_string(Conf.ArenaSize) + "\tarena_page_size:" + std::to_string(Conf.ArenaPageSize) + "\n";
+	ConfStr += "pool_cache_high:" + std::to_string(Conf.PoolCacheHighWater) + "\tpool_cache_low:" + std::to_string(Conf.PoolCacheLowWater) + "\tpool_cache_max:" + std::to_string(Conf.PoolCacheMaxSize) + "\n";
+
+	GLogger->DumpStrToFile(ConfStr.c_str());
+
 	TTimer Timer;
+
+	std::string TimerStr{};
+	TimerStr += "Timer: " + std::to_string(TTimer::GetTicksPerNanosecond()) + " ticks/ns\toverhead: " + std::to_string(TTimer::GetOverheadTicks()) + " ticks\ttiming batch: " + std::to_string(TWorker::TimingBatchSize) + "\n";
+	GLogger->DumpStrToFile(TimerStr.c_str());
+	printf("MALLOC PERF TEST: %s", TimerStr.c_str());
+
 	Timer.Start();
 
 	for (int32 i = 0; i < NumOfThreads; ++i)
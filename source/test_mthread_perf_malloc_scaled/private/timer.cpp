@@ -1,24 +1,66 @@
 #include "timer.h"
 
+static const uint32 TIMER_CALIBRATION_TIME_MS    = 20;
+static const uint32 TIMER_OVERHEAD_MEASURE_COUNT = 10000;
+
+float64 TTimer::TicksPerNanosecond = 1.0;
+uint64  TTimer::OverheadTicks      = 0;
 
 TTimer::TTimer()
 {
+	//	Calibrated once per process, by the first timer constructed;
+	static const bool Calibrated = (Calibrate(), true);
+	(void)Calibrated;
+
 	Start();
+	EndTick = StartTick;
 }
 
-void TTimer::Start()
+//	The tick rate is taken over a busy wait on steady_clock. The overhead is the least tick count
+//	between back to back reads, as it is the cost of the reads alone;
+void TTimer::Calibrate()
 {
-	StartTick = std::chrono::high_resolution_clock::now();
-}
+	auto StartTime = std::chrono::steady_clock::now();
+	uint64 FirstTick = ReadStartTick();
+	auto EndTime = StartTime;
 
-void TTimer::Stop()
-{
-	EndTick = std::chrono::high_resolution_clock::now();
+	while (EndTime - StartTime < std::chrono::milliseconds(TIMER_CALIBRATION_TIME_MS))
+	{
+		EndTime = std::chrono::steady_clock::now();
+	}
+
+	uint64 LastTick = ReadEndTick();
+	float64 Nanoseconds = std::chrono::duration<float64, std::nano>(EndTime - StartTime).count();
+
+	TicksPerNanosecond = (float64)(LastTick - FirstTick) / Nanoseconds;
+	OverheadTicks = std::numeric_limits<uint64>::max();
+
+	for (uint32 i = 0; i < TIMER_OVERHEAD_MEASURE_COUNT; ++i)
+	{
+		uint64 First = ReadStartTick();
+		uint64 Last = ReadEndTick();
+
+		if (Last - First < OverheadTicks)
+		{
+			OverheadTicks = Last - First;
+		}
+	}
 }
 
 TDuration TTimer::GetDuration()
 {
-	return TDuration(EndTick - StartTick);
+	uint64 Ticks = EndTick - StartTick;
+	Ticks = Ticks > OverheadTicks ? Ticks - OverheadTicks : 0;
+
+	return TDuration((TDuration::rep)(Ticks / TicksPerNanosecond));
 }
 
+float64 TTimer::GetTicksPerNanosecond()
+{
+	return TicksPerNanosecond;
+}
 
+uint64 TTimer::GetOverheadTicks()
+{
+	return OverheadTicks;
+}
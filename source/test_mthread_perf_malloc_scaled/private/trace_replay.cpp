@@ -0,0 +1,333 @@
+#include "trace_replay.h"
+#include "test_mthread_perf_malloc.h"
+#include "alloc_tracer.h"
+#include "platform.h"
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <unordered_map>
+#include <string>
+
+#ifdef PLATFORM_WIN
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+static const uint32 REPLAY_NO_OBJECT = 0xFFFFFFFF;
+
+struct TReplayOp
+{
+	uint8  Op;
+	uint32 Input;  // Object freed or reallocated;
+	uint32 Output; // Object allocated;
+	TSize  Size;
+	TSize  Alignment;
+};
+
+struct TReplayObject
+{
+	std::atomic<void*> Addr;
+	std::atomic<bool>  Ready;
+};
+
+struct TReplayMalloc
+{
+	void* (*Malloc)(TSize Size, TSize Alignment);
+	void* (*Calloc)(TSize Size, TSize Alignment);
+	void* (*Realloc)(void* Addr, TSize Size, TSize Alignment);
+	void  (*Free)(void* Addr);
+};
+
+//	The system allocator keeps its default alignment, traced alignments above it are not replayed;
+static const TReplayMalloc ReplayMallocs[] =
+{
+	{
+		[](TSize Size, TSize Alignment) -> void* { return Malloc(Size, Alignment); },
+		[](TSize Size, TSize Alignment) -> void* { return Calloc(1, Size, Alignment); },
+		[](void* Addr, TSize Size, TSize Alignment) -> void* { return Realloc(Addr, Size, Alignment); },
+		[](void* Addr) { Free(Addr); }
+	},
+	{
+		[](TSize Size, TSize Alignment) -> void* { return malloc(Size); },
+		[](TSize Size, TSize Alignment) -> void* { return calloc(1, Size); },
+		[](void* Addr, TSize Size, TSize Alignment) -> void* { return realloc(Addr, Size); },
+		[](void* Addr) { free(Addr); }
+	}
+};
+
+static TSize GetPeakResidentSize()
+{
+#ifdef PLATFORM_WIN
+	PROCESS_MEMORY_COUNTERS Counters = {};
+
+	if (!K32GetProcessMemoryInfo(GetCurrentProcess(), &Counters, sizeof(Counters)))
+	{
+		return 0;
+	}
+
+	return Counters.PeakWorkingSetSize;
+#else
+	struct rusage Usage = {};
+
+	if (getrusage(RUSAGE_SELF, &Usage))
+	{
+		return 0;
+	}
+
+	return (TSize)Usage.ru_maxrss * 1024;
+#endif
+}
+
+static bool LoadAllocTrace(const char* Path, vector<TAllocTraceRecord>& OutRecords)
+{
+	FILE* File = fopen(Path, "rb");
+
+	if (!File)
+	{
+		printf("MALLOC PERF TEST: Cannot open trace file: %s\n", Path);
+		return false;
+	}
+
+	TAllocTraceHeader Header{};
+	bool Ok = fread(&Header, sizeof(Header), 1, File) == 1 &&
+		Header.Magic == ALLOC_TRACE_MAGIC &&
+		Header.Version == ALLOC_TRACE_VERSION &&
+		Header.RecordSize == sizeof(TAllocTraceRecord);
+
+	if (!Ok)
+	{
+		printf("MALLOC PERF TEST: Not a trace file of this allocator version: %s\n", Path);
+		fclose(File);
+		return false;
+	}
+
+	TAllocTraceRecord Records[ALLOC_TRACE_BUFFER_RECORDS];
+	TSize Count = 0;
+
+	while ((Count = fread(Records, sizeof(TAllocTraceRecord), ALLOC_TRACE_BUFFER_RECORDS, File)) > 0)
+	{
+		OutRecords.insert(OutRecords.end(), Records, Records + Count);
+	}
+
+	fclose(File);
+
+	//	Chunks of different threads are in the file in the order they got full;
+	std::sort(OutRecords.begin(), OutRecords.end(),
+		[](const TAllocTraceRecord& A, const TAllocTraceRecord& B) { return A.Seq < B.Seq; });
+
+	return true;
+}
+
+//	Turns traced addresses into objects numbered in the order they were allocated;
+static uint32 BuildReplayOps(const vector<TAllocTraceRecord>& Records, vector<vector<TReplayOp>>& OutThreadOps, uint64& OutSkippedCount)
+{
+	std::unordered_map<uint64, uint32> LiveObjects;
+	uint32 ObjectCount = 0;
+	OutSkippedCount = 0;
+
+	for (const TAllocTraceRecord& Rec : Records)
+	{
+		TReplayOp Op{ Rec.Op, REPLAY_NO_OBJECT, REPLAY_NO_OBJECT, (TSize)Rec.Size, Rec.Alignment };
+
+		if (Rec.Op == ALLOC_TRACE_REALLOC || Rec.Op == ALLOC_TRACE_FREE)
+		{
+			auto It = LiveObjects.find(Rec.Addr);
+
+			if (It != LiveObjects.end())
+			{
+				Op.Input = It->second;
+
+				//	A failed realloc leaves the block where it was;
+				if (Rec.Op == ALLOC_TRACE_FREE || Rec.Result || !Rec.Size)
+				{
+					LiveObjects.erase(It);
+				}
+			}
+			else if (Rec.Addr)
+			{
+				++OutSkippedCount;
+				continue;
+			}
+		}
+
+		if (Rec.Op == ALLOC_TRACE_FREE && Op.Input == REPLAY_NO_OBJECT)
+		{
+			continue;
+		}
+
+		if (Rec.Op == ALLOC_TRACE_REALLOC && Op.Input != REPLAY_NO_OBJECT && !Rec.Result && !Rec.Size)
+		{
+			Op.Op = ALLOC_TRACE_FREE;
+		}
+
+		if (Rec.Result)
+		{
+			Op.Output = ObjectCount++;
+			LiveObjects[Rec.Result] = Op.Output;
+		}
+
+		if (Rec.Thread >= OutThreadOps.size())
+		{
+			OutThreadOps.resize(Rec.Thread + 1);
+		}
+
+		OutThreadOps[Rec.Thread].push_back(Op);
+	}
+
+	return ObjectCount;
+}
+
+static void ReplayThread(const TReplayMalloc& Alloc, const vector<TReplayOp>& Ops, TReplayObject* Objects,
+	std::atomic<bool>& StartFlag, vector<TDuration>& OutTimes)
+{
+	OutTimes.reserve(Ops.size());
+
+	while (!StartFlag.load(std::memory_order_acquire))
+	{
+		std::this_thread::yield();
+	}
+
+	TTimer Timer;
+
+	for (const TReplayOp& Op : Ops)
+	{
+		void* Addr = nullptr;
+
+		if (Op.Input != REPLAY_NO_OBJECT)
+		{
+			TReplayObject& Input = Objects[Op.Input];
+
+			while (!Input.Ready.load(std::memory_order_acquire))
+			{
+				std::this_thread::yield();
+			}
+
+			Addr = Input.Addr.exchange(nullptr, std::memory_order_relaxed);
+		}
+
+		void* Result = nullptr;
+
+		Timer.Start();
+
+		switch (Op.Op)
+		{
+		case ALLOC_TRACE_MALLOC:
+			Result = Alloc.Malloc(Op.Size, Op.Alignment);
+			break;
+		case ALLOC_TRACE_CALLOC:
+			Result = Alloc.Calloc(Op.Size, Op.Alignment);
+			break;
+		case ALLOC_TRACE_REALLOC:
+			Result = Alloc.Realloc(Addr, Op.Size, Op.Alignment);
+			break;
+		case ALLOC_TRACE_FREE:
+			Alloc.Free(Addr);
+			break;
+		}
+
+		Timer.Stop();
+		OutTimes.push_back(Timer.GetDuration());
+
+		//	Blocks failed here but traced as allocated are kept ready as null, so their users do not wait forever;
+		if (Op.Output != REPLAY_NO_OBJECT)
+		{
+			Objects[Op.Output].Addr.store(Result, std::memory_order_relaxed);
+			Objects[Op.Output].Ready.store(true, std::memory_order_release);
+		}
+		else if (Op.Op == ALLOC_TRACE_REALLOC && Op.Input != REPLAY_NO_OBJECT)
+		{
+			//	Traced as failed, the block stays the input of the later requests;
+			Objects[Op.Input].Addr.store(Result ? Result : Addr, std::memory_order_relaxed);
+		}
+		else if (Result)
+		{
+			Alloc.Free(Result);
+		}
+	}
+}
+
+bool ReplayAllocTrace(const char* Path, EReplayMalloc MallocToUse, TReplayResult& OutResult)
+{
+	OutResult = {};
+
+	vector<TAllocTraceRecord> Records;
+
+	if (!LoadAllocTrace(Path, Records))
+	{
+		return false;
+	}
+
+	vector<vector<TReplayOp>> ThreadOps;
+	uint32 ObjectCount = BuildReplayOps(Records, ThreadOps, OutResult.SkippedCount);
+
+	Records.clear();
+	Records.shrink_to_fit();
+
+	if (MallocToUse == REPLAY_MALLOC_SCALED && !SafeInitMalloc())
+	{
+		printf("MALLOC PERF TEST: Cannot init malloc for the trace replay\n");
+		return false;
+	}
+
+	unique_ptr<TReplayObject[]> Objects{ new TReplayObject[ObjectCount ? ObjectCount : 1]() };
+	vector<vector<TDuration>> ThreadTimes(ThreadOps.size());
+	vector<std::thread> Threads;
+	std::atomic<bool> StartFlag{ false };
+	const TReplayMalloc& Alloc = ReplayMallocs[MallocToUse];
+
+	for (TSize i = 0; i < ThreadOps.size(); ++i)
+	{
+		Threads.emplace_back(ReplayThread, std::cref(Alloc), std::cref(ThreadOps[i]), Objects.get(),
+			std::ref(StartFlag), std::ref(ThreadTimes[i]));
+	}
+
+	TTimer Timer;
+	Timer.Start();
+	StartFlag.store(true, std::memory_order_release);
+
+	for (std::thread& Thread : Threads)
+	{
+		Thread.join();
+	}
+
+	Timer.Stop();
+
+	OutResult.PeakResidentSize = GetPeakResidentSize();
+
+	for (uint32 i = 0; i < ObjectCount; ++i)
+	{
+		void* Addr = Objects[i].Addr.load(std::memory_order_relaxed);
+
+		if (Addr)
+		{
+			Alloc.Free(Addr);
+		}
+	}
+
+	vector<TDuration> Times;
+
+	for (vector<TDuration>& Thread : ThreadTimes)
+	{
+		Times.insert(Times.end(), Thread.begin(), Thread.end());
+	}
+
+	std::sort(Times.begin(), Times.end());
+
+	auto Percentile = [&Times](float64 P) -> TDuration
+	{
+		return Times.empty() ? TDuration{} : Times[std::min(Times.size() - 1, (TSize)(P * Times.size()))];
+	};
+
+	OutResult.OpCount      = Times.size();
+	OutResult.ThreadCount  = (uint32)ThreadOps.size();
+	OutResult.TotalTime    = std::chrono::duration<float64>(Timer.GetDuration()).count();
+	OutResult.OpsPerSecond = OutResult.TotalTime > 0.0 ? OutResult.OpCount / OutResult.TotalTime : 0.0;
+	OutResult.P50Time      = Percentile(0.5);
+	OutResult.P90Time      = Percentile(0.9);
+	OutResult.P99Time      = Percentile(0.99);
+	OutResult.P999Time     = Percentile(0.999);
+	OutResult.MaxTime      = Times.empty() ? TDuration{} : Times.back();
+
+	return true;
+}
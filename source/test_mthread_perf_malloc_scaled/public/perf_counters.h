@@ -0,0 +1,71 @@
+#pragma once
+
+#include "std.h"
+
+enum EPerfCounter
+{
+	PERF_COUNTER_CYCLES,
+	PERF_COUNTER_INSTRUCTIONS,
+	PERF_COUNTER_L1D_MISSES,
+	PERF_COUNTER_LLC_MISSES,
+	PERF_COUNTER_DTLB_MISSES,
+	PERF_COUNTER_PAGE_FAULTS,
+	PERF_COUNTER_COUNT
+};
+
+const char* GetPerfCounterName(EPerfCounter Counter);
+
+struct TPerfCounterValues
+{
+	uint64 Values[PERF_COUNTER_COUNT] = {};
+	bool   Valid[PERF_COUNTER_COUNT] = {};  // the counter could be opened and has run;
+
+	void Reset()
+	{
+		*this = TPerfCounterValues{};
+	}
+
+	//	A counter stays valid only while it is valid in every sum, so totals never mix in missing threads;
+	void Add(const TPerfCounterValues& Other, bool First)
+	{
+		for (uint32 i = 0; i < PERF_COUNTER_COUNT; ++i)
+		{
+			Values[i] += Other.Values[i];
+			Valid[i] = (First || Valid[i]) && Other.Valid[i];
+		}
+	}
+};
+
+//	Hardware and software counters of the calling thread, opened by perf_event_open on Linux.
+//	Counters the CPU, the kernel or perf_event_paranoid do not allow stay invalid and the tests run
+//	without them, as they do on the other platforms where no counter is opened.
+//	The counters are one group, scheduled together and toggled by a single call on the leader;
+//	a group multiplexed by the kernel is scaled by its enabled to running time.
+//	Reset starts a measurement, the counters then count only between Start and Stop, Read sums those spans;
+class TPerfCounters
+{
+public:
+	TPerfCounters();
+	~TPerfCounters();
+
+	TPerfCounters(TPerfCounters&) = delete;
+	TPerfCounters& operator=(TPerfCounters&) = delete;
+
+	//	Must be called by the thread to count, returns false when no counter is available;
+	bool Open();
+	void Close();
+
+	void Reset();
+	void Start();
+	void Stop();
+	void Read(TPerfCounterValues& OutValues);
+
+private:
+	int32 Fds[PERF_COUNTER_COUNT];
+	int32 LeaderFd; // The first counter opened, the others are its group members;
+
+	//	Readings taken by Reset, Read reports the change since;
+	uint64 BaseValues[PERF_COUNTER_COUNT];
+	uint64 BaseTimesEnabled[PERF_COUNTER_COUNT];
+	uint64 BaseTimesRunning[PERF_COUNTER_COUNT];
+};
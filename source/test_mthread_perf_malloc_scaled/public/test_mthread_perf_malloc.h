@@ -4,6 +4,7 @@
 //#define _CRT_SECURE_NO_WARNINGS
 #include <functional>
 #include "timer.h"
+#include "perf_counters.h"
 #include <atomic>
 #include <vector>
 #include <memory>
@@ -15,6 +16,8 @@ using std::vector;
 
 #define DEFAULT_MAX_CONCURENT_THREADS 5
 
+static const uint64 PERF_COUNTER_MIN_BATCH = 16; // Operations of a timed region the performance counters are toggled for;
+
 enum ETestType
 {
 	TEST_NONE,
@@ -49,6 +52,31 @@ public:
 		return &WorkerTimer;
 	}
 
+	//	Times a region of Count operations that goes to MallocTimeStats. The performance counters are toggled
+	//	once per region and only for regions of PERF_COUNTER_MIN_BATCH operations or more, shorter ones are timed only;
+	void StartTiming(uint64 Count = 1)
+	{
+		CountedBatch = Count >= PERF_COUNTER_MIN_BATCH ? Count : 0;
+
+		if (CountedBatch)
+		{
+			PerfCounters.Start();
+		}
+
+		WorkerTimer.Start();
+	}
+
+	void StopTiming()
+	{
+		WorkerTimer.Stop();
+
+		if (CountedBatch)
+		{
+			PerfCounters.Stop();
+			PerfOpCount += CountedBatch;
+		}
+	}
+
 	uint32 GetThreadId()
 	{
 		return ThreadId;
@@ -59,15 +87,28 @@ public:
 		MallocTimeStats.BlockAllocTime.Reset();
 		MallocTimeStats.BlockReallocTime.Reset();
 		MallocTimeStats.BlockFreeTime.Reset();
+		PerfValues.Reset();
+		PerfOpCount = 0;
 	}
 
 	static ETestType TestType;
 	TMallocTimeStats MallocTimeStats;
+	TPerfCounterValues PerfValues; // Counters of the counted regions of the test on this thread;
+	uint64 PerfOpCount = 0;        // Operations of the counted regions;
 	static std::atomic<int32> ExitCode;
 
+	//	Operations timed together by the per operation tests, each adds the mean of its batch, --timing-batch='Count';
+	//	batches of PERF_COUNTER_MIN_BATCH or more are counted by the performance counters as well;
+	static uint32 TimingBatchSize;
+
+	//	Duration of the fragmentation aging test, --aging-seconds='Count';
+	static uint32 AgingSeconds;
+
 private:
 	void Run();
 	TTimer WorkerTimer;
+	TPerfCounters PerfCounters;
+	uint64 CountedBatch = 0;
 	std::thread Worker;
 	uint32 ThreadId;
 
@@ -78,7 +119,7 @@ private:
 	};
 
 
-	static const uint32 TestCount = 5;
+	static const uint32 TestCount = 17;
 	static TTest Tests[TestCount];
 	static std::atomic<uint32> RunningTasks;
 	static std::atomic<uint32> AllTasksCompleted;
@@ -96,7 +137,10 @@ public:
 	void DumpStatsToFile(
 		const char* Header1,
 		ETestType TestType, uint32 TestNumber,
-		uint64 MesCount, float64 MinTime, float64 MaxTime, float64 AvgTime);
+		TTimeStats& Stats);
+
+	//	Counter averages per counted operation, of every thread and of all threads;
+	void DumpPerfCountersToFile(uint32 TestNumber);
 
 	//static TLogger* GetLogger();
 	//static bool Init();
@@ -114,9 +158,24 @@ private:
 extern vector<unique_ptr<TWorker>>* Workers;
 extern TLogger* GLogger;
 
+bool SafeInitMalloc();
+void SafeShutdownMalloc();
+
 void Test_Perf_Malloc_Const_Blocks_1(TWorker*);
 void Test_Perf_Malloc_Const_Blocks_2(TWorker*);
 void Test_Perf_Malloc_Progressive_Blocks(TWorker*);
 void Test_Perf_Free(TWorker*);
 void Test_Perf_Small_Reallocs(TWorker*);
-void Test_Perf_Big_Reallocs(TWorker*);
\ No newline at end of file
+void Test_Perf_Big_Reallocs(TWorker*);
+void Test_Perf_Pool_Cache_Oscillation(TWorker*);
+void Test_Perf_Size_Class_Lookup(TWorker*);
+void Test_Perf_Malloc_Fast_Path(TWorker*);
+void Test_Perf_Calloc(TWorker*);
+void Test_Perf_Object_Pool(TWorker*);
+void Test_Perf_Heap_Destroy(TWorker*);
+void Test_Perf_Prewarm(TWorker*);
+void Test_Perf_Trim(TWorker*);
+void Test_Perf_Pool_Coloring(TWorker*);
+void Test_Perf_False_Sharing(TWorker*);
+void Test_Perf_Heap_Profiler(TWorker*);
+void Test_Perf_Fragmentation_Aging(TWorker*);
\ No newline at end of file
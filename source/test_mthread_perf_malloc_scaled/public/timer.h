@@ -2,15 +2,80 @@
 
 #include "std.h"
 
+#if defined(_M_X64) || defined(__x86_64__)
+#define TIMER_TSC 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#else
+#define TIMER_TSC 0
+#endif
+
+//	Timer of the perf tests. On x64 it reads the time stamp counter, which ticks at a constant rate
+//	on every CPU the tests target (invariant TSC). The reads are fenced, so the timed code neither
+//	starts before Start nor finishes after Stop. The cost of a Start/Stop pair, measured at the first
+//	construction together with the tick rate, is subtracted from every duration.
+//	Other CPUs use std::chrono::steady_clock;
 class TTimer
 {
 public:
 	TTimer();
-	void Start();
-	void Stop();
+
+	inline void Start();
+	inline void Stop();
+
+	//	Time between Start and Stop without the timer overhead;
 	TDuration GetDuration();
 
+	static float64 GetTicksPerNanosecond();
+	static uint64 GetOverheadTicks();
+
 private:
-	std::chrono::high_resolution_clock::time_point StartTick;
-	std::chrono::high_resolution_clock::time_point EndTick;
+	static inline uint64 ReadStartTick();
+	static inline uint64 ReadEndTick();
+	static void Calibrate();
+
+	uint64 StartTick;
+	uint64 EndTick;
+
+	static float64 TicksPerNanosecond;
+	static uint64 OverheadTicks;
 };
+
+inline uint64 TTimer::ReadStartTick()
+{
+#if TIMER_TSC
+	//	The first fence waits for the preceding loads, the second keeps the timed code after the read;
+	_mm_lfence();
+	uint64 Tick = __rdtsc();
+	_mm_lfence();
+	return Tick;
+#else
+	return (uint64)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+inline uint64 TTimer::ReadEndTick()
+{
+#if TIMER_TSC
+	//	rdtscp waits for the timed code to finish, the fence keeps the following code after the read;
+	uint32 Aux = 0;
+	uint64 Tick = __rdtscp(&Aux);
+	_mm_lfence();
+	return Tick;
+#else
+	return ReadStartTick();
+#endif
+}
+
+inline void TTimer::Start()
+{
+	StartTick = ReadStartTick();
+}
+
+inline void TTimer::Stop()
+{
+	EndTick = ReadEndTick();
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "std.h"
+
+enum EReplayMalloc
+{
+	REPLAY_MALLOC_SCALED,
+	REPLAY_MALLOC_SYSTEM
+};
+
+struct TReplayResult
+{
+	uint64 OpCount;
+	uint64 SkippedCount;    // Frees and reallocs of blocks allocated before the trace started;
+	uint32 ThreadCount;
+	float64 TotalTime;      // Seconds from the start of all replay threads to the last one done;
+	float64 OpsPerSecond;
+	TDuration P50Time;
+	TDuration P90Time;
+	TDuration P99Time;
+	TDuration P999Time;
+	TDuration MaxTime;
+	TSize PeakResidentSize; // Peak of the process, including the loaded trace;
+};
+
+//	Replays a trace written by MALLOC_SCALED_TRACE or StartAllocTrace with a thread per traced thread.
+//	A thread that frees or reallocates a block allocated by another one waits until the block exists,
+//	so the requests keep the order they had across threads. Blocks left by the trace are freed untimed;
+bool ReplayAllocTrace(const char* Path, EReplayMalloc MallocToUse, TReplayResult& OutResult);
@@ -1,4 +1,5 @@
 #include "vm_block.h"
+#include "region_allocator.h"
 #include "test_vm_block.h"
 
 /*
@@ -128,3 +129,37 @@ void Test_Area_Overflow()
 	TVMBlock::Release();
 }
 
+void Test_Region_Allocator()
+{
+	bool Ok = false;
+
+	TRegionAllocator Region;
+	Ok = Region.Init(BLOCK_SIZE_16MB, BLOCK_SIZE_64KB);
+
+	void* Blocks[4];
+	Blocks[0] = Region.Malloc(BLOCK_SIZE_128B);
+	Blocks[1] = Region.Malloc(BLOCK_SIZE_1KB, BLOCK_SIZE_256B);
+
+	TRegionMark Mark = Region.Mark();
+
+	for (TSize i = 0; i < NUM_OF_BLOCKS_1K; ++i)
+	{
+		Blocks[2] = Region.Malloc(BLOCK_SIZE_4KB); // commits beyond the first chunk;
+	}
+
+	Region.Rollback(Mark);
+
+	Blocks[2] = Region.Malloc(BLOCK_SIZE_16B);
+	Blocks[2] = Region.Realloc(Blocks[2], BLOCK_SIZE_128KB); // last block grows in place;
+	Blocks[3] = Region.Calloc(NUM_OF_BLOCKS_10, BLOCK_SIZE_16B);
+	Region.Free(Blocks[3]);
+
+	Blocks[3] = Region.Malloc(BLOCK_SIZE_32MB); // over the reserved size;
+
+	Region.Reset(true);
+	Blocks[0] = Region.Malloc(BLOCK_SIZE_1MB);
+
+	Region.Release();
+	TVMBlock::Release();
+}
+
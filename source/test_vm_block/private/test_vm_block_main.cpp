@@ -6,6 +6,7 @@ int main()
 	Test_Malloc_And_Free_Block();
 	Test_Malloc_Merge_Blocks();
 	Test_Area_Overflow();
+	Test_Region_Allocator();
 
 	return 0;
 }
\ No newline at end of file
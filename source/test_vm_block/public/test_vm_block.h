@@ -51,6 +51,7 @@ void Test_Reserve_And_Release_Area();
 void Test_Malloc_And_Free_Block();
 void Test_Malloc_Merge_Blocks();
 void Test_Area_Overflow();
+void Test_Region_Allocator();
 
 
 